@@ -0,0 +1,64 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+#include "arena.h"
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGN 8 // AST・変数・文字列に必要な境界 (double・ポインタ)
+
+struct ArenaChunk {
+    ArenaChunk *next;
+    size_t size;
+    alignas(max_align_t) char data[];
+};
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (size > arena->left) {
+        // チャンクに収まらない大きな要求は専用のチャンクにする
+        size_t chunk_size = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+        ArenaChunk *chunk = malloc(sizeof(ArenaChunk) + chunk_size);
+        if (chunk == NULL) return NULL;
+        chunk->size = chunk_size;
+        arena->chunk_count++;
+        arena->reserved_bytes += chunk_size;
+        if (chunk_size > ARENA_CHUNK_SIZE && arena->chunks != NULL) {
+            // 専用チャンクは2番目に繋ぎ、現在のチャンクの空きを使い続ける
+            chunk->next = arena->chunks->next;
+            arena->chunks->next = chunk;
+            arena->alloc_count++;
+            arena->used_bytes += size;
+            memset(chunk->data, 0, size);
+            return chunk->data;
+        }
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena->cur = chunk->data;
+        arena->left = chunk_size;
+    }
+    void *p = arena->cur;
+    arena->cur += size;
+    arena->left -= size;
+    arena->alloc_count++;
+    arena->used_bytes += size;
+    memset(p, 0, size);
+    return p;
+}
+
+char *arena_strndup(Arena *arena, const char *s, size_t len) {
+    char *copy = arena_alloc(arena, len + 1);
+    if (copy == NULL) return NULL;
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+void arena_release(Arena *arena) {
+    ArenaChunk *chunk = arena->chunks;
+    while (chunk != NULL) {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    memset(arena, 0, sizeof(Arena));
+}
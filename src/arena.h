@@ -0,0 +1,29 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// --- アリーナ (バンプ) アロケータ ---
+// 大きなチャンクから先頭詰めで切り出し、個別には解放しない。
+// チャンクはまとめて arena_release で解放する。
+
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct {
+    ArenaChunk *chunks;    // 確保したチャンクのリスト (先頭が最新)
+    char *cur;             // 最新チャンクの空き領域の先頭
+    size_t left;           // 最新チャンクの空き領域の大きさ
+    size_t alloc_count;    // arena_alloc の呼び出し回数
+    size_t chunk_count;    // 確保したチャンク数
+    size_t used_bytes;     // 切り出した合計バイト数
+    size_t reserved_bytes; // チャンクとして確保した合計バイト数
+} Arena;
+
+// 0 で初期化した size バイトの領域を返す (確保できなければ NULL)
+void *arena_alloc(Arena *arena, size_t size);
+// len バイトをコピーし、NUL 終端した文字列を返す (確保できなければ NULL)
+char *arena_strndup(Arena *arena, const char *s, size_t len);
+// すべてのチャンクを解放し、空のアリーナに戻す
+void arena_release(Arena *arena);
+
+#endif
@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include "bench-util.h"
+#include "jit.h"
+#include "vm.h"
+#include "context.h"
+
+// 各最適化レベルで C を経由する方法とアセンブリを直接生成する方法 (--asm) で実行ファイルを作り、
+// 同じ入力を与えた実行結果が一致することを確かめる。あわせて実行ファイルを作る時間と実行時間を比べる。
+// その場で実行 (-r) した結果と、バイトコードで解釈実行 (-i) した結果も C と比べる。
+// 最適化そのものも確かめるため、各レベルの C の実行結果を -O0 と比べ、
+// 最適化を確かめるソースでは、最適化の回数 (--opt-stats と同じもの) と生成した C から最適化が働いたことを確かめる
+
+// 生成したプログラムに与える入力 (入力する の回数より多めに用意する)
+static const char program_input[] = "30\n40\n50\n2.5\n7\n5\n100\n-3\n0.125\n1e3\n";
+
+// path を最適化レベル level で読み込み、as_asm ならアセンブリ、そうでなければ C から実行ファイルを作る
+// (読み込みから gcc の終了まで)。かかった秒数を返し、コンパイルエラーになるソースなら負の値。
+// stats が NULL でなければ最適化の回数を、code_out が NULL でなければ生成したコードを返す (呼び出し側で free する)
+static double build(const char *path, int level, bool as_asm, const char *exe, OptStats *stats, char **code_out) {
+    // gcc を動かす時間を測るので、キャッシュは使わない
+    DriverOptions opts = { level, false, CODEGEN_DEFAULTS, BUILD_DEFAULTS, false };
+    opts.build.assembly = as_asm;
+    opts.build.use_cache = false;
+    double start = bench_now();
+    JpcContext *ctx = new_context();
+    const Ast *ast = driver_load(ctx, path, &opts, stats);
+    char *code = NULL;
+    size_t len = 0;
+    bool ok = ast != NULL && driver_generate(ctx, ast, &opts, &code, &len);
+    free_context(ctx);
+    if (!ok) return -1;
+    ok = bench_build(&opts.build, code, len, exe) >= 0;
+    double elapsed = bench_now() - start;
+    if (ok && code_out != NULL) *code_out = code;
+    else free(code);
+    return ok ? elapsed : -1;
+}
+
+// 最適化を確かめるソースなら、level での最適化の回数 st (prev は 1 つ下のレベルのもの) と生成した C の code が
+// 期待どおりかを確かめ、そうでなければ理由を返す。ほかのソースでは -O0 で何も変えていないことだけを確かめる
+static const char *check_optimizer(const char *path, int level, const OptStats *st, const OptStats *prev, const char *code) {
+    const char *slash = strrchr(path, '/');
+    const char *name = slash != NULL ? slash + 1 : path;
+    // int64_t で宣言した変数 (ランタイムも int64_t を使うので、変数の宣言で見分ける)
+    bool has_int = strstr(code, "int64_t jpc_var_") != NULL;
+    if (level == 0) {
+        bool changed = st->removed_nodes || st->hoisted_stmts || st->reduced_ops || has_int;
+        return changed ? "最適化なしなのにコードが変わりました" : NULL;
+    }
+    if (strcmp(name, "unit_test_dead_code.jpc") == 0) {
+        if (st->removed_branches == 0) return "到達しない分岐を削除していません";
+        if (st->removed_loops == 0) return "実行されないループを削除していません";
+        if (st->removed_stores == 0) return "読まれない代入を削除していません";
+    } else if (strcmp(name, "unit_test_loop_opt.jpc") == 0) {
+        if (st->hoisted_stmts == 0) return "ループで変わらない文を移していません";
+        if (st->reduced_ops == 0) return "2 のべき乗のわり算をかけ算にしていません";
+        if (level == 2 && st->reduced_ops <= prev->reduced_ops) return "帰納変数のかけ算をたし算にしていません";
+    } else if (strcmp(name, "unit_test_int_vars.jpc") == 0) {
+        if (level == 1 && has_int) return "-O1 なのに整数の変数を int64_t にしました";
+        if (level == 2 && !has_int) return "整数の変数を int64_t にしていません";
+    }
+    return NULL;
+}
+
+// 子プロセスで標準入出力をつなぎ替えて、use_vm なら -i、そうでなければ -r と同じく実行し、出力を out に書く。
+// 構文解析から実行が終わるまでの秒数を返し、失敗したら負の値
+static double run_in_process(const char *path, int level, bool use_vm, const char *input, const char *out) {
+    double start = bench_now();
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        int in_fd = open(input, O_RDONLY);
+        int out_fd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (in_fd < 0 || out_fd < 0 || dup2(in_fd, 0) < 0 || dup2(out_fd, 1) < 0) _exit(1);
+        JpcContext *ctx = new_context();
+        DriverOptions opts = { level, false, CODEGEN_DEFAULTS, BUILD_DEFAULTS, false };
+        const Ast *ast = driver_load(ctx, path, &opts, NULL);
+        bool ok = ast != NULL && (use_vm ? vm_run(ctx, ast) : jit_run(ctx, ast));
+        _exit(ok ? 0 : 1);
+    }
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) return -1;
+    return bench_now() - start;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: ./asm-test <filename.jpc>...\n");
+        return 1;
+    }
+
+    char dir[] = "/tmp/jpc-asm-test-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        fprintf(stderr, "Error: Cannot create temporary directory\n");
+        return 1;
+    }
+    // C の実行結果はレベルごとに残し、-O0 と比べる
+    char input[4096], exe[2][4096], c_out[OPT_LEVEL_MAX + 1][4096], asm_out[4096], jit_out[4096], vm_out[4096];
+    snprintf(input, sizeof(input), "%s/input.txt", dir);
+    for (int i = 0; i < 2; i++) snprintf(exe[i], sizeof(exe[i]), "%s/prog%d", dir, i);
+    for (int level = 0; level <= OPT_LEVEL_MAX; level++) snprintf(c_out[level], sizeof(c_out[level]), "%s/O%d.out", dir, level);
+    snprintf(asm_out, sizeof(asm_out), "%s/asm.out", dir);
+    snprintf(jit_out, sizeof(jit_out), "%s/jit.out", dir);
+    snprintf(vm_out, sizeof(vm_out), "%s/vm.out", dir);
+    FILE *fp = fopen(input, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Cannot create %s\n", input);
+        return 1;
+    }
+    fputs(program_input, fp);
+    fclose(fp);
+
+    printf("=== Asm Test: %d files x %d levels ===\n", argc - 1, OPT_LEVEL_MAX + 1);
+    int compared = 0, skipped = 0, failures = 0;
+    double build_time[2] = {0, 0}, run_time[2] = {0, 0}, jit_time = 0, vm_time = 0;
+    for (int f = 1; f < argc; f++) {
+        if (access(argv[f], R_OK) != 0) {
+            fprintf(stderr, "Error: Cannot open file %s\n", argv[f]);
+            return 1;
+        }
+        bool has_base = false;   // -O0 の C の実行結果があるか
+        OptStats stats[OPT_LEVEL_MAX + 1];
+        for (int level = 0; level <= OPT_LEVEL_MAX; level++) {
+            double bt[2], rt[2];
+            char *code = NULL;
+            bt[0] = build(argv[f], level, false, exe[0], &stats[level], &code);
+            if (bt[0] < 0) {
+                // エラーを確かめるためのソース (どちらの方法でも同じフロントエンドで止まる)
+                skipped++;
+                continue;
+            }
+            const char *reason = check_optimizer(argv[f], level, &stats[level], level > 0 ? &stats[level - 1] : NULL, code);
+            free(code);
+            if (reason != NULL) {
+                printf("NG: %s -O%d: %s\n", argv[f], level, reason);
+                failures++;
+                continue;
+            }
+            rt[0] = bench_run(exe[0], input, c_out[level], 1);
+            if (rt[0] < 0 || (has_base && !bench_same_file(c_out[0], c_out[level]))) {
+                printf("NG: %s -O%d: C の%s\n", argv[f], level, rt[0] < 0 ? "実行に失敗しました" : "実行結果が -O0 と違います");
+                failures++;
+                continue;
+            }
+            if (level == 0) has_base = true;
+            bt[1] = build(argv[f], level, true, exe[1], NULL, NULL);
+            rt[1] = bt[1] < 0 ? -1 : bench_run(exe[1], input, asm_out, 1);
+            bool ok = bt[1] >= 0 && rt[1] >= 0 && bench_same_file(c_out[level], asm_out);
+            if (!ok) {
+                printf("NG: %s -O%d: --asm の%s\n", argv[f], level,
+                       bt[1] < 0 ? "アセンブルに失敗しました" : "実行結果が C と違います");
+                failures++;
+                continue;
+            }
+            double jt = run_in_process(argv[f], level, false, input, jit_out);
+            if (jt < 0 || !bench_same_file(c_out[level], jit_out)) {
+                printf("NG: %s -O%d: -r の%s\n", argv[f], level, jt < 0 ? "実行に失敗しました" : "実行結果が C と違います");
+                failures++;
+                continue;
+            }
+            double vt = run_in_process(argv[f], level, true, input, vm_out);
+            if (vt < 0 || !bench_same_file(c_out[level], vm_out)) {
+                printf("NG: %s -O%d: -i の%s\n", argv[f], level, vt < 0 ? "実行に失敗しました" : "実行結果が C と違います");
+                failures++;
+                continue;
+            }
+            for (int i = 0; i < 2; i++) {
+                build_time[i] += bt[i];
+                run_time[i] += rt[i];
+            }
+            jit_time += jt;
+            vm_time += vt;
+            compared++;
+        }
+    }
+
+    printf("compared %d programs (%d skipped: compile errors)\n", compared, skipped);
+    if (compared > 0) {
+        printf("build: C %.1f ms, asm %.1f ms (%.2fx)\n", build_time[0] * 1e3, build_time[1] * 1e3, build_time[0] / build_time[1]);
+        printf("run:   C %.1f ms, asm %.1f ms\n", run_time[0] * 1e3, run_time[1] * 1e3);
+        printf("-r:    %.1f ms (構文解析から実行の終わりまで。C は作成と実行で %.1f ms)\n",
+               jit_time * 1e3, (build_time[0] + run_time[0]) * 1e3);
+        printf("-i:    %.1f ms (構文解析から実行の終わりまで)\n", vm_time * 1e3);
+    }
+
+    unlink(input);
+    unlink(jit_out);
+    unlink(vm_out);
+    for (int i = 0; i < 2; i++) unlink(exe[i]);
+    for (int level = 0; level <= OPT_LEVEL_MAX; level++) unlink(c_out[level]);
+    unlink(asm_out);
+    rmdir(dir);
+
+    if (failures > 0) {
+        printf("NG: %d programs differed\n", failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
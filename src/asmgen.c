@@ -0,0 +1,354 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "asmgen.h"
+#include "error.h"
+#include "context.h"
+
+// 生成中の状態
+typedef struct {
+    JpcContext *ctx;
+    const Ast *ast;
+    FILE *fp;
+    uint32_t labels; // 次に使うラベル番号
+} AsmGen;
+
+// --- プロトタイプ宣言 (内部関数) ---
+static void asm_stmt(AsmGen *g, uint32_t id);
+static void asm_block(AsmGen *g, uint32_t id);
+static void asm_branch(AsmGen *g, uint32_t id, bool jump_if, uint32_t label);
+
+// 第 1 引数から第 8 引数までの double を渡すレジスタ
+#define ARG_XMM_REGS 8
+
+// --- ヘルパー関数 ---
+
+// 変数のスタック上の位置 (%rbp からの距離)
+static long var_offset(uint32_t var) {
+    return -8 * ((long)var + 1);
+}
+
+// 値 (変数か定数) を命令のメモリオペランドとして書く
+static void asm_operand(AsmGen *g, uint32_t id) {
+    const ANode *node = &g->ast->nodes[id];
+    switch (node->kind) {
+    case ND_VAR:
+        fprintf(g->fp, "%ld(%%rbp)", var_offset(node->a));
+        return;
+    case ND_LITERAL:
+        fprintf(g->fp, ".LC%u(%%rip)", id);
+        return;
+    default:
+        error(g->ctx, ERR_CODEGEN, "Unknown Node Kind %d", node->kind);
+    }
+}
+
+// 値を xmm レジスタに読み込む
+static void asm_load(AsmGen *g, uint32_t id, int xmm) {
+    fprintf(g->fp, "\tmovsd\t");
+    asm_operand(g, id);
+    fprintf(g->fp, ", %%xmm%d\n", xmm);
+}
+
+// 文字列を .string の中身として書く (書式の \n などはそのまま、それ以外の制御文字と非 ASCII は 8 進で)
+static void asm_string(const char *s, FILE *fp) {
+    fputc('"', fp);
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+        if (p[0] == '\\' && p[1] != '\0') {
+            fputc(*p++, fp);
+            fputc(*p, fp);
+        } else if (*p < 0x20 || *p >= 0x7F) {
+            fprintf(fp, "\\%03o", *p);
+        } else {
+            fputc(*p, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+// --- 条件分岐 ---
+
+// 比較の結果が jump_if と等しければ label へ飛ぶ。
+// ucomisd は NaN との比較で ZF・PF・CF をすべて立てるので、C の比較と同じく NaN では偽になるように選ぶ
+static void asm_compare(AsmGen *g, const ANode *node, bool jump_if, uint32_t label) {
+    FILE *fp = g->fp;
+    uint32_t lhs = node->a, rhs = node->b;
+    // < と <= は左右を入れ替えて > と >= にする (ja・jae は NaN で飛ばない)
+    if (node->kind == ND_LT || node->kind == ND_LE) {
+        lhs = node->b;
+        rhs = node->a;
+    }
+    asm_load(g, lhs, 0);
+    fprintf(fp, "\tucomisd\t");
+    asm_operand(g, rhs);
+    fprintf(fp, ", %%xmm0\n");
+
+    switch (node->kind) {
+    case ND_GT:
+    case ND_LT:
+        fprintf(fp, "\t%s\t.L%u\n", jump_if ? "ja" : "jbe", label);
+        return;
+    case ND_GE:
+    case ND_LE:
+        fprintf(fp, "\t%s\t.L%u\n", jump_if ? "jae" : "jb", label);
+        return;
+    case ND_EQ:
+    case ND_NE: {
+        // 等しい: ZF=1 かつ PF=0
+        bool jump_if_equal = (node->kind == ND_EQ) == jump_if;
+        if (jump_if_equal) {
+            uint32_t skip = g->labels++;
+            fprintf(fp, "\tjp\t.L%u\n", skip);
+            fprintf(fp, "\tje\t.L%u\n", label);
+            fprintf(fp, ".L%u:\n", skip);
+        } else {
+            fprintf(fp, "\tjp\t.L%u\n", label);
+            fprintf(fp, "\tjne\t.L%u\n", label);
+        }
+        return;
+    }
+    default:
+        error(g->ctx, ERR_CODEGEN, "Unknown Node Kind %d", node->kind);
+    }
+}
+
+// 条件 id が jump_if と等しければ label へ飛び、そうでなければ次の命令へ進む
+static void asm_branch(AsmGen *g, uint32_t id, bool jump_if, uint32_t label) {
+    const ANode *node = &g->ast->nodes[id];
+    switch (node->kind) {
+    case ND_AND:
+    case ND_OR: {
+        // かつ で偽へ飛ぶとき・または で真へ飛ぶときは、どちらの項からも同じ先へ飛べばよい
+        bool short_circuit = node->kind == ND_AND ? !jump_if : jump_if;
+        if (short_circuit) {
+            asm_branch(g, node->a, jump_if, label);
+            asm_branch(g, node->b, jump_if, label);
+        } else {
+            uint32_t skip = g->labels++;
+            asm_branch(g, node->a, !jump_if, skip);
+            asm_branch(g, node->b, jump_if, label);
+            fprintf(g->fp, ".L%u:\n", skip);
+        }
+        return;
+    }
+
+    case ND_EQ:
+    case ND_NE:
+    case ND_LT:
+    case ND_LE:
+    case ND_GT:
+    case ND_GE:
+        asm_compare(g, node, jump_if, label);
+        return;
+
+    case ND_LITERAL: {
+        // 最適化で畳み込まれた条件。C と同じく 0 以外 (NaN を含む) は真
+        double val = ast_num(node);
+        if ((val != 0) == jump_if) fprintf(g->fp, "\tjmp\t.L%u\n", label);
+        return;
+    }
+
+    case ND_VAR: {
+        // 0 と比べる (C と同じく NaN は真)
+        asm_load(g, id, 0);
+        fprintf(g->fp, "\txorpd\t%%xmm1, %%xmm1\n");
+        fprintf(g->fp, "\tucomisd\t%%xmm1, %%xmm0\n");
+        if (jump_if) {
+            fprintf(g->fp, "\tjp\t.L%u\n", label);
+            fprintf(g->fp, "\tjne\t.L%u\n", label);
+        } else {
+            uint32_t skip = g->labels++;
+            fprintf(g->fp, "\tjp\t.L%u\n", skip);
+            fprintf(g->fp, "\tje\t.L%u\n", label);
+            fprintf(g->fp, ".L%u:\n", skip);
+        }
+        return;
+    }
+
+    default:
+        error(g->ctx, ERR_CODEGEN, "Unknown Node Kind %d", node->kind);
+    }
+}
+
+// --- 文 ---
+
+// 文字列の出力。埋め込み変数は第 2 引数以降の double として渡す
+// (8 個までは %xmm0-7、残りはスタック。%al にレジスタで渡した数を入れる)
+static void asm_printf(AsmGen *g, uint32_t str_id) {
+    FILE *fp = g->fp;
+    const ANode *str = &g->ast->nodes[str_id];
+    uint32_t nargs = str->c;
+    uint32_t nstack = nargs > ARG_XMM_REGS ? nargs - ARG_XMM_REGS : 0;
+    long stack_size = (nstack * 8 + 15) / 16 * 16;
+    if (stack_size > 0) fprintf(fp, "\tsubq\t$%ld, %%rsp\n", stack_size);
+    for (uint32_t i = ARG_XMM_REGS; i < nargs; i++) {
+        fprintf(fp, "\tmovsd\t%ld(%%rbp), %%xmm15\n", var_offset(g->ast->ids[str->b + i]));
+        fprintf(fp, "\tmovsd\t%%xmm15, %u(%%rsp)\n", (i - ARG_XMM_REGS) * 8);
+    }
+    for (uint32_t i = 0; i < nargs && i < ARG_XMM_REGS; i++) {
+        fprintf(fp, "\tmovsd\t%ld(%%rbp), %%xmm%u\n", var_offset(g->ast->ids[str->b + i]), i);
+    }
+    fprintf(fp, "\tleaq\t.LS%u(%%rip), %%rdi\n", str_id);
+    fprintf(fp, "\tmovl\t$%u, %%eax\n", nargs < ARG_XMM_REGS ? nargs : ARG_XMM_REGS);
+    fprintf(fp, "\tcall\tprintf@PLT\n");
+    if (stack_size > 0) fprintf(fp, "\taddq\t$%ld, %%rsp\n", stack_size);
+}
+
+// もし / ではなく の連なり。最後の実行ブロックの後は end へ飛ぶ
+static void asm_if(AsmGen *g, uint32_t id, uint32_t end) {
+    const ANode *node = &g->ast->nodes[id];
+    uint32_t next = g->labels++;
+    asm_branch(g, node->a, false, next);
+    asm_block(g, node->b);
+    if (node->c) fprintf(g->fp, "\tjmp\t.L%u\n", end);
+    fprintf(g->fp, ".L%u:\n", next);
+    if (node->c) {
+        if (g->ast->nodes[node->c].kind == ND_ELSEIF) {
+            asm_if(g, node->c, end);
+        } else {
+            asm_block(g, node->c);
+        }
+    }
+}
+
+static void asm_block(AsmGen *g, uint32_t id) {
+    for (; id; id = g->ast->nodes[id].next) {
+        asm_stmt(g, id);
+    }
+}
+
+static void asm_stmt(AsmGen *g, uint32_t id) {
+    FILE *fp = g->fp;
+    const ANode *node = &g->ast->nodes[id];
+
+    switch (node->kind) {
+    case ND_BLOCK:
+        asm_block(g, node->a);
+        return;
+
+    case ND_IF: {
+        uint32_t end = g->labels++;
+        asm_if(g, id, end);
+        fprintf(fp, ".L%u:\n", end);
+        return;
+    }
+
+    case ND_LOOP: {
+        // 条件を末尾に置き、繰り返しごとの分岐を 1 回にする
+        uint32_t body = g->labels++, cond = g->labels++;
+        fprintf(fp, "\tjmp\t.L%u\n", cond);
+        fprintf(fp, ".L%u:\n", body);
+        asm_block(g, node->b);
+        fprintf(fp, ".L%u:\n", cond);
+        asm_branch(g, node->a, true, body);
+        return;
+    }
+
+    case ND_DECLARE:
+    case ND_ASSIGN:
+        asm_load(g, node->b, 0);
+        fprintf(fp, "\tmovsd\t%%xmm0, %ld(%%rbp)\n", var_offset(g->ast->nodes[node->a].a));
+        return;
+
+    case ND_ADD:
+    case ND_SUB:
+    case ND_MUL:
+    case ND_DIV: {
+        const char *op = node->kind == ND_ADD ? "addsd" : node->kind == ND_SUB ? "subsd" : node->kind == ND_MUL ? "mulsd" : "divsd";
+        long offset = var_offset(g->ast->nodes[node->a].a);
+        fprintf(fp, "\tmovsd\t%ld(%%rbp), %%xmm0\n", offset);
+        fprintf(fp, "\t%s\t", op);
+        asm_operand(g, node->b);
+        fprintf(fp, ", %%xmm0\n");
+        fprintf(fp, "\tmovsd\t%%xmm0, %ld(%%rbp)\n", offset);
+        return;
+    }
+
+    case ND_INPUT:
+        fprintf(fp, "\tleaq\t%ld(%%rbp), %%rsi\n", var_offset(g->ast->nodes[node->a].a));
+        fprintf(fp, "\tleaq\t.LFMT_IN(%%rip), %%rdi\n");
+        fprintf(fp, "\txorl\t%%eax, %%eax\n");
+        fprintf(fp, "\tcall\tscanf@PLT\n");
+        return;
+
+    case ND_OUTPUT:
+        if (g->ast->nodes[node->a].kind == ND_STR_LIT) {
+            asm_printf(g, node->a);
+        } else {
+            asm_load(g, node->a, 0);
+            fprintf(fp, "\tleaq\t.LFMT_NUM(%%rip), %%rdi\n");
+            fprintf(fp, "\tmovl\t$1, %%eax\n");
+            fprintf(fp, "\tcall\tprintf@PLT\n");
+        }
+        return;
+
+    default:
+        error(g->ctx, ERR_CODEGEN, "Unknown Node Kind %d", node->kind);
+    }
+}
+
+// 定数と文字列 (AST 中のすべての定数・文字列リテラルにノードの添字で名前を付ける)
+static void asm_data(AsmGen *g) {
+    FILE *fp = g->fp;
+    fprintf(fp, "\t.section\t.rodata\n");
+    fprintf(fp, ".LFMT_IN:\n\t.string\t\"%%lf\"\n");
+    fprintf(fp, ".LFMT_NUM:\n\t.string\t\"%%g\\n\"\n");
+    for (uint32_t i = 1; i < g->ast->count; i++) {
+        const ANode *node = &g->ast->nodes[i];
+        if (node->kind == ND_STR_LIT) {
+            fprintf(fp, ".LS%u:\n\t.string\t", i);
+            asm_string(ast_str(g->ast, node), fp);
+            fputc('\n', fp);
+        }
+    }
+    fprintf(fp, "\t.align\t8\n");
+    for (uint32_t i = 1; i < g->ast->count; i++) {
+        const ANode *node = &g->ast->nodes[i];
+        if (node->kind == ND_LITERAL) {
+            // double のビット列をそのまま置く
+            fprintf(fp, ".LC%u:\n\t.quad\t0x%08x%08x\n", i, node->b, node->a);
+        }
+    }
+}
+
+static void asm_program(AsmGen *g) {
+    FILE *fp = g->fp;
+    // 変数の領域。call の前に %rsp が 16 の倍数になるよう切り上げる
+    long frame = ((long)ast_var_count(g->ast) * 8 + 15) / 16 * 16;
+
+    fprintf(fp, "\t.text\n");
+    fprintf(fp, "\t.globl\tmain\n");
+    fprintf(fp, "\t.type\tmain, @function\n");
+    fprintf(fp, "main:\n");
+    fprintf(fp, "\tpushq\t%%rbp\n");
+    fprintf(fp, "\tmovq\t%%rsp, %%rbp\n");
+    if (frame > 0) fprintf(fp, "\tsubq\t$%ld, %%rsp\n", frame);
+    asm_block(g, g->ast->nodes[g->ast->root].a);
+    fprintf(fp, "\txorl\t%%eax, %%eax\n");
+    fprintf(fp, "\tleave\n");
+    fprintf(fp, "\tret\n");
+    fprintf(fp, "\t.size\tmain, .-main\n");
+    asm_data(g);
+    fprintf(fp, "\t.section\t.note.GNU-stack,\"\",@progbits\n");
+}
+
+// --- エントリーポイント ---
+
+static bool run_asmgen(AsmGen *g) {
+    jmp_buf env;
+    jmp_buf *prev = g->ctx->error_jmp;
+    g->ctx->error_jmp = &env;
+    if (setjmp(env) != 0) {
+        g->ctx->error_jmp = prev;
+        return false;
+    }
+    asm_program(g);
+    g->ctx->error_jmp = prev;
+    return true;
+}
+
+bool asmgen(JpcContext *ctx, const Ast *ast, FILE *fp) {
+    AsmGen g = { ctx, ast, fp, 0 };
+    return run_asmgen(&g);
+}
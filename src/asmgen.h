@@ -0,0 +1,17 @@
+// asmgen.h
+#ifndef ASMGEN_H
+#define ASMGEN_H
+
+#include <stdbool.h>
+#include "ast.h"
+
+// --- x86-64 アセンブリの生成 ---
+// C を経由せず、AST から GNU as 形式 (AT&T 記法) のアセンブリを直接書く。
+// 数値はすべて double として SSE2 で計算し、変数はスタックに置く。入出力は printf/scanf を呼ぶ。
+// 出力は C のコード生成 (--stdio) で作ったプログラムと同じになる。
+// 整数の変数 (最適化レベル 2) も double のまま扱う (値は 2^53 以内の整数なので結果は変わらない)
+
+// アセンブリを fp に書き出す。エラーの場合は ctx にエラーを記録して false を返す
+bool asmgen(JpcContext *ctx, const Ast *ast, FILE *fp);
+
+#endif
@@ -0,0 +1,331 @@
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "ast.h"
+#include "error.h"
+#include "context.h"
+
+// 配列 buf を need 要素以上入るように伸ばす (足りなければ倍々に)
+static void *grow(JpcContext *ctx, void *buf, uint32_t *cap, uint32_t need, size_t elem) {
+    if (need <= *cap) return buf;
+    uint32_t new_cap = *cap ? *cap : 64;
+    while (new_cap < need) new_cap *= 2;
+    void *grown = realloc(buf, elem * new_cap);
+    if (grown == NULL) error(ctx, ERR_SYSTEM, "メモリを確保できません");
+    *cap = new_cap;
+    return grown;
+}
+
+static uint32_t push_node(JpcContext *ctx, Ast *ast, NodeKind kind) {
+    ast->nodes = grow(ctx, ast->nodes, &ast->cap, ast->count + 1, sizeof(ANode));
+    uint32_t id = ast->count++;
+    ast->nodes[id] = (ANode){ .kind = kind };
+    return id;
+}
+
+static uint32_t push_str(JpcContext *ctx, Ast *ast, const char *s) {
+    uint32_t len = strlen(s) + 1;
+    ast->strs = grow(ctx, ast->strs, &ast->strs_cap, ast->strs_len + len, 1);
+    uint32_t pos = ast->strs_len;
+    memcpy(ast->strs + pos, s, len);
+    ast->strs_len += len;
+    return pos;
+}
+
+static uint32_t push_ids(JpcContext *ctx, Ast *ast, const int *ids, int n) {
+    ast->ids = grow(ctx, ast->ids, &ast->ids_cap, ast->ids_len + n, sizeof(int));
+    uint32_t pos = ast->ids_len;
+    if (n > 0) memcpy(ast->ids + pos, ids, sizeof(int) * n);
+    ast->ids_len += n;
+    return pos;
+}
+
+static void set_name(JpcContext *ctx, Ast *ast, int var_id, const char *name) {
+    uint32_t old_cap = ast->names_cap;
+    ast->names = grow(ctx, ast->names, &ast->names_cap, var_id + 1, sizeof(const char *));
+    if (ast->names_cap > old_cap) {
+        memset(ast->names + old_cap, 0, sizeof(const char *) * (ast->names_cap - old_cap));
+    }
+    ast->names[var_id] = name;
+}
+
+static uint32_t flatten_list(JpcContext *ctx, Ast *ast, Node *node);
+
+// 1つのノードとその子を並べる (next は flatten_list がつなぐ)
+static uint32_t flatten(JpcContext *ctx, Ast *ast, Node *node) {
+    if (node == NULL) return 0;
+    uint32_t id = push_node(ctx, ast, node->kind);
+    uint32_t a = 0, b = 0, c = 0;
+
+    switch (node->kind) {
+    case ND_PROGRAM:
+    case ND_BLOCK:
+        // 文の列は Node では next につながっている
+        a = flatten_list(ctx, ast, node->next);
+        break;
+    case ND_IF:
+    case ND_ELSEIF:
+        a = flatten(ctx, ast, node->cond);
+        b = flatten_list(ctx, ast, node->then);
+        c = flatten_list(ctx, ast, node->els);
+        break;
+    case ND_LOOP:
+        a = flatten(ctx, ast, node->cond);
+        b = flatten_list(ctx, ast, node->then);
+        break;
+    case ND_VAR:
+        a = node->var_id;
+        set_name(ctx, ast, node->var_id, node->name);
+        break;
+    case ND_LITERAL: {
+        uint64_t bits;
+        memcpy(&bits, &node->val, sizeof(bits));
+        a = (uint32_t)bits;
+        b = (uint32_t)(bits >> 32);
+        break;
+    }
+    case ND_STR_LIT:
+        a = push_str(ctx, ast, node->strVal);
+        b = push_ids(ctx, ast, node->args, node->argc);
+        c = node->argc;
+        break;
+    default:
+        a = flatten(ctx, ast, node->lhs);
+        b = flatten(ctx, ast, node->rhs);
+        break;
+    }
+
+    // 子を並べる間に配列が伸びて移動しうるので、最後に添字で書き込む
+    ANode *n = &ast->nodes[id];
+    n->a = a;
+    n->b = b;
+    n->c = c;
+    return id;
+}
+
+static uint32_t flatten_list(JpcContext *ctx, Ast *ast, Node *node) {
+    uint32_t first = 0, prev = 0;
+    for (; node; node = node->next) {
+        uint32_t id = flatten(ctx, ast, node);
+        if (prev) ast->nodes[prev].next = id;
+        else first = id;
+        prev = id;
+    }
+    return first;
+}
+
+// Node の木をコンパクトな AST に変換する。エラーの場合は ctx にエラーを記録して NULL を返す
+const Ast *build_ast(JpcContext *ctx, Node *root) {
+    Ast *ast = &ctx->ast;
+    jmp_buf env;
+    jmp_buf *prev = ctx->error_jmp;
+    ctx->error_jmp = &env;
+    if (setjmp(env) != 0) {
+        ctx->error_jmp = prev;
+        return NULL;
+    }
+    ast->count = 0;
+    ast->strs_len = 0;
+    ast->ids_len = 0;
+    ast->int_vars_len = 0;
+    push_node(ctx, ast, ND_PROGRAM); // 添字 0 は番兵
+    ast->root = flatten(ctx, ast, root);
+    ctx->error_jmp = prev;
+    return ast;
+}
+
+uint32_t ast_new_node(JpcContext *ctx, Ast *ast, NodeKind kind) {
+    return push_node(ctx, ast, kind);
+}
+
+void free_ast(Ast *ast) {
+    free(ast->nodes);
+    free(ast->strs);
+    free(ast->ids);
+    free(ast->names);
+    free(ast->int_vars);
+    memset(ast, 0, sizeof(*ast));
+}
+
+uint32_t ast_var_count(const Ast *ast) {
+    uint32_t nvars = 0;
+    for (uint32_t i = 1; i < ast->count; i++) {
+        if (ast->nodes[i].kind == ND_VAR && ast->nodes[i].a + 1 > nvars) nvars = ast->nodes[i].a + 1;
+    }
+    for (uint32_t i = 0; i < ast->ids_len; i++) {
+        if ((uint32_t)ast->ids[i] + 1 > nvars) nvars = (uint32_t)ast->ids[i] + 1;
+    }
+    return nvars;
+}
+
+void ast_split_text(JpcContext *ctx, const Ast *ast, uint32_t str_id, AstText *t) {
+    const ANode *str = &ast->nodes[str_id];
+    const char *p = ast_str(ast, str);
+    t->pieces = context_alloc(ctx, sizeof(AstPiece) * (str->c + 1));
+    char *buf = context_alloc(ctx, strlen(p) + 1);
+    uint32_t arg = 0;
+    t->count = 0;
+    AstPiece *piece = &t->pieces[t->count++];
+    *piece = (AstPiece){ buf, 0, -1 };
+    for (; *p; p++) {
+        if (p[0] == '%' && p[1] == 'f') {
+            piece->var = ast->ids[str->b + arg++];
+            buf += piece->len;
+            piece = &t->pieces[t->count++];
+            *piece = (AstPiece){ buf, 0, -1 };
+            p++;
+        } else if (p[0] == '%') {
+            // %% は % そのもの
+            buf[piece->len++] = *++p;
+        } else if (p[0] == '\\') {
+            // \n 以外 (\" と \\) は 2 文字目そのもの
+            p++;
+            buf[piece->len++] = *p == 'n' ? '\n' : *p;
+        } else {
+            buf[piece->len++] = *p;
+        }
+    }
+}
+
+// --- 直列化 ---
+// ヘッダに続けて nodes, strs, ids をそのまま並べる (バイト順は実行環境のもの)。
+// コード生成に使わない変数名 (names) と、最適化で決める int_vars は含めない
+
+#define AST_MAGIC "JPCA"
+
+typedef struct {
+    char magic[4];
+    uint32_t format;    // AST_FORMAT_VERSION
+    uint64_t key;       // 呼び出し側が照合に使う値 (キャッシュではソースのハッシュ)
+    uint64_t checksum;  // ヘッダ以降の内容のハッシュ
+    uint32_t count, strs_len, ids_len, root;
+    uint32_t nvars;     // 変数の数 (ast_var_count)。読み込み時に変数IDの範囲を確かめる
+} AstFileHeader;
+
+// FNV-1a を 8 バイト単位で回したもの (壊れたファイルを見分けられればよい)
+static uint64_t checksum(uint64_t h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        h = (h ^ word) * 0x100000001b3ULL;
+    }
+    for (; len > 0; p++, len--) h = (h ^ *p) * 0x100000001b3ULL;
+    return h;
+}
+
+#define CHECKSUM_INIT 0xcbf29ce484222325ULL
+
+// 直列化した AST を fp に書き出す (書き込めなければ false)
+bool write_ast(const Ast *ast, uint64_t key, FILE *fp) {
+    AstFileHeader h = {
+        .format = AST_FORMAT_VERSION,
+        .key = key,
+        .count = ast->count,
+        .strs_len = ast->strs_len,
+        .ids_len = ast->ids_len,
+        .root = ast->root,
+        .nvars = ast_var_count(ast),
+    };
+    memcpy(h.magic, AST_MAGIC, 4);
+    h.checksum = checksum(CHECKSUM_INIT, ast->nodes, sizeof(ANode) * ast->count);
+    h.checksum = checksum(h.checksum, ast->strs, ast->strs_len);
+    h.checksum = checksum(h.checksum, ast->ids, sizeof(int) * ast->ids_len);
+    return fwrite(&h, sizeof(h), 1, fp) == 1
+        && fwrite(ast->nodes, sizeof(ANode), ast->count, fp) == ast->count
+        && fwrite(ast->strs, 1, ast->strs_len, fp) == ast->strs_len
+        && fwrite(ast->ids, sizeof(int), ast->ids_len, fp) == ast->ids_len;
+}
+
+// 子の添字は親より後ろを指す (前順に並べてあるので循環しない)
+static bool valid_child(uint32_t id, uint32_t child, uint32_t count) {
+    return child == 0 || (child > id && child < count);
+}
+
+// 書式の中の %f (埋め込み変数) の数。ast_split_text と同じく読み、% や \ で終わる壊れた書式なら -1
+static int64_t count_placeholders(const char *p) {
+    int64_t n = 0;
+    for (; *p; p++) {
+        if (p[0] == '%' || p[0] == '\\') {
+            if (p[1] == '\0') return -1;
+            if (p[0] == '%' && p[1] == 'f') n++;
+            p++;
+        }
+    }
+    return n;
+}
+
+// 読み込んだ AST の添字がすべて範囲内かを確かめる。
+// 変数IDは nvars 未満、文字列はいずれかの書式の先頭を指し、埋め込み変数の数が書式の %f の数と合うこと
+static bool valid_ast(const Ast *ast, uint32_t nvars) {
+    if (ast->count < 2 || ast->root == 0 || ast->root >= ast->count) return false;
+    if (ast->strs_len > 0 && ast->strs[ast->strs_len - 1] != '\0') return false;
+    // 変数はそれぞれ宣言の VAR ノードを持つので、ノードの数より多くはならない
+    if (nvars >= ast->count) return false;
+    for (uint32_t i = 0; i < ast->ids_len; i++) {
+        if (ast->ids[i] < 0 || (uint32_t)ast->ids[i] >= nvars) return false;
+    }
+    for (uint32_t id = 1; id < ast->count; id++) {
+        const ANode *n = &ast->nodes[id];
+        if (n->kind > ND_OR || !valid_child(id, n->next, ast->count)) return false;
+        switch (n->kind) {
+        case ND_VAR:
+            if (n->a >= nvars) return false;
+            break;
+        case ND_LITERAL:
+            break;
+        case ND_STR_LIT:
+            if (n->a >= ast->strs_len || (n->a > 0 && ast->strs[n->a - 1] != '\0')
+                || (uint64_t)n->b + n->c > ast->ids_len) return false;
+            if (count_placeholders(ast->strs + n->a) != n->c) return false;
+            break;
+        default:
+            if (!valid_child(id, n->a, ast->count) || !valid_child(id, n->b, ast->count)
+                || !valid_child(id, n->c, ast->count)) return false;
+            // 宣言・代入・四則・入力の左辺は変数 (コード生成は左辺の変数IDをそのまま使う)
+            if (n->kind >= ND_DECLARE && n->kind <= ND_INPUT && (n->a == 0 || ast->nodes[n->a].kind != ND_VAR)) return false;
+            break;
+        }
+    }
+    return true;
+}
+
+// write_ast で書き出した内容から ctx->ast を作る。
+// 形式やキーが合わない、または壊れている場合は NULL を返す (エラーは記録しない)
+const Ast *read_ast(JpcContext *ctx, const void *buf, size_t len, uint64_t key) {
+    AstFileHeader h;
+    if (len < sizeof(h)) return NULL;
+    memcpy(&h, buf, sizeof(h));
+    if (memcmp(h.magic, AST_MAGIC, 4) != 0 || h.format != AST_FORMAT_VERSION || h.key != key) return NULL;
+    size_t nodes_size = (size_t)h.count * sizeof(ANode);
+    size_t ids_size = (size_t)h.ids_len * sizeof(int);
+    if (len != sizeof(h) + nodes_size + h.strs_len + ids_size) return NULL;
+    // 書き出し時と同じく、配列ごとに区切ってハッシュを取る
+    const char *p = (const char *)buf + sizeof(h);
+    uint64_t sum = checksum(CHECKSUM_INIT, p, nodes_size);
+    sum = checksum(sum, p + nodes_size, h.strs_len);
+    sum = checksum(sum, p + nodes_size + h.strs_len, ids_size);
+    if (sum != h.checksum) return NULL;
+
+    Ast *ast = &ctx->ast;
+    free_ast(ast);
+    ast->nodes = malloc(nodes_size);
+    ast->strs = malloc(h.strs_len + 1);
+    ast->ids = malloc(ids_size + sizeof(int));
+    if (ast->nodes == NULL || ast->strs == NULL || ast->ids == NULL) {
+        free_ast(ast);
+        return NULL;
+    }
+    memcpy(ast->nodes, p, nodes_size);
+    memcpy(ast->strs, p + nodes_size, h.strs_len);
+    memcpy(ast->ids, p + nodes_size + h.strs_len, ids_size);
+    ast->count = ast->cap = h.count;
+    ast->strs_len = ast->strs_cap = h.strs_len;
+    ast->ids_len = ast->ids_cap = h.ids_len;
+    ast->root = h.root;
+    if (!valid_ast(ast, h.nvars)) {
+        free_ast(ast);
+        return NULL;
+    }
+    return ast;
+}
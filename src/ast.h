@@ -0,0 +1,96 @@
+#ifndef AST_H
+#define AST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "parser.h"
+
+// --- コンパクトな AST ---
+// 構文解析で作った Node の木を、1本の配列に前順で並べ直したもの。
+// 子や次の文は 32 ビットの添字で指し、添字 0 は「なし」を表す。
+// 種類ごとの a, b, c の中身:
+//   PROGRAM, BLOCK         a: 最初の文
+//   IF, ELSEIF             a: 条件  b: 実行ブロックの最初の文  c: ELSEIF ノードまたは else の最初の文
+//   LOOP                   a: 条件  b: 実行ブロックの最初の文
+//   DECLARE, ASSIGN, ADD, SUB, MUL, DIV, 比較, 論理
+//                          a: 左辺  b: 右辺
+//   INPUT, OUTPUT          a: 対象
+//   VAR                    a: 変数ID (名前は names[a])
+//   LITERAL                a, b: double のビット列 (下位, 上位)
+//   STR_LIT                a: 書式 (strs 内の位置)  b: 埋め込み変数ID列 (ids 内の位置)  c: その個数
+
+typedef struct {
+    uint32_t kind;  // NodeKind
+    uint32_t a, b, c;
+    uint32_t next;  // 次の文
+} ANode;
+
+typedef struct {
+    ANode *nodes;       // nodes[0] は番兵
+    uint32_t count, cap;
+    char *strs;         // 文字列リテラルの書式 (NUL 区切り)
+    uint32_t strs_len, strs_cap;
+    int *ids;           // 文字列リテラルの埋め込み変数ID
+    uint32_t ids_len, ids_cap;
+    const char **names; // 変数ID -> 変数名 (インターン済み)
+    uint32_t names_cap;
+    bool *int_vars;     // 変数ID -> 整数 (int64_t) として出力するか (最適化で決める)
+    uint32_t int_vars_len;
+    uint32_t root;      // PROGRAM ノード
+} Ast;
+
+typedef struct JpcContext JpcContext;
+
+// Node の木をコンパクトな AST に変換し、ctx->ast に置く。エラーの場合は NULL を返す。
+// 変換後は Node の木を参照しないので、構文解析のアリーナは解放してよい
+const Ast *build_ast(JpcContext *ctx, Node *root);
+void free_ast(Ast *ast);
+
+// 末尾に kind のノードを1つ足して添字を返す (nodes は再確保されうるので、ポインタは取り直すこと)
+uint32_t ast_new_node(JpcContext *ctx, Ast *ast, NodeKind kind);
+
+// 使われている変数IDの最大値 + 1 (変数の領域の大きさ)
+uint32_t ast_var_count(const Ast *ast);
+
+// 文字列の出力を、そのまま書く部分と変数の値に分けたもの
+typedef struct {
+    const char *text;   // 書式のエスケープを戻した文字列
+    uint32_t len;
+    int var;            // この部分の後に %f で書く変数ID (なければ -1)
+} AstPiece;
+
+typedef struct {
+    AstPiece *pieces;
+    uint32_t count;
+} AstText;
+
+// STR_LIT ノード str_id の書式 (C の文字列リテラルの中身) を、そのまま書く部分と変数に分けて t に書く。
+// 分けた文字列は ctx のアリーナに置く (確保できなければエラー)
+void ast_split_text(JpcContext *ctx, const Ast *ast, uint32_t str_id, AstText *t);
+
+// 直列化の形式 (ANode の並びや中身を変えたら上げる)
+#define AST_FORMAT_VERSION 2
+
+// 直列化した AST を書き出す / 読み込む。key は読み込み時に照合する任意の値。
+// read_ast は結果を ctx->ast に置き、形式違いや壊れた入力では NULL を返す (エラーは記録しない)
+bool write_ast(const Ast *ast, uint64_t key, FILE *fp);
+const Ast *read_ast(JpcContext *ctx, const void *buf, size_t len, uint64_t key);
+
+static inline double ast_num(const ANode *n) {
+    uint64_t bits = (uint64_t)n->b << 32 | n->a;
+    double val;
+    memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+
+static inline bool ast_is_int_var(const Ast *ast, uint32_t var) {
+    return var < ast->int_vars_len && ast->int_vars[var];
+}
+
+static inline const char *ast_str(const Ast *ast, const ANode *n) {
+    return ast->strs + n->a;
+}
+
+#endif
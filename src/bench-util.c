@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "bench-util.h"
+#include "context.h"
+
+double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+char *bench_read_file(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) return NULL;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+    char *buf = size < 0 ? NULL : malloc(size + 1);
+    if (buf != NULL) {
+        *len = fread(buf, 1, size, fp);
+        buf[*len] = '\0';
+    }
+    fclose(fp);
+    return buf;
+}
+
+bool bench_same_file(const char *path1, const char *path2) {
+    FILE *f1 = fopen(path1, "r");
+    FILE *f2 = fopen(path2, "r");
+    bool same = f1 != NULL && f2 != NULL;
+    while (same) {
+        int c1 = fgetc(f1), c2 = fgetc(f2);
+        if (c1 != c2) same = false;
+        if (c1 == EOF) break;
+    }
+    if (f1 != NULL) fclose(f1);
+    if (f2 != NULL) fclose(f2);
+    return same;
+}
+
+bool bench_write_source(const char *path, void (*generate)(FILE *fp, long n), long n) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) return false;
+    generate(fp, n);
+    return fclose(fp) == 0;
+}
+
+bool bench_compile(const char *path, const DriverOptions *opts, OptStats *stats, char **code, size_t *len) {
+    JpcContext *ctx = new_context();
+    if (ctx == NULL) {
+        fprintf(stderr, "Error: Cannot allocate context\n");
+        return false;
+    }
+    const Ast *ast = driver_load(ctx, path, opts, stats);
+    bool ok = ast != NULL && driver_generate(ctx, ast, opts, code, len);
+    if (!ok) print_errors(ctx, stderr);
+    free_context(ctx);
+    return ok;
+}
+
+double bench_build(const BuildOptions *opts, const char *code, size_t len, const char *exe) {
+    JpcContext *ctx = new_context();
+    if (ctx == NULL) {
+        fprintf(stderr, "Error: Cannot allocate context\n");
+        return -1;
+    }
+    double start = bench_now();
+    bool ok = build_executable(ctx, opts, code, len, exe, NULL);
+    double elapsed = bench_now() - start;
+    if (!ok) print_errors(ctx, stderr);
+    free_context(ctx);
+    return ok ? elapsed : -1;
+}
+
+double bench_run(const char *exe, const char *input, const char *out, int runs) {
+    // パスは 4096 バイトまでなので、3 つのパスとリダイレクトが収まる
+    char cmd[3 * 4096 + 16];
+    int n = input != NULL ? snprintf(cmd, sizeof(cmd), "%s < %s > %s", exe, input, out)
+                          : snprintf(cmd, sizeof(cmd), "%s > %s", exe, out);
+    if (n < 0 || (size_t)n >= sizeof(cmd)) return -1;
+    double best = -1;
+    for (int r = 0; r < runs; r++) {
+        double start = bench_now();
+        if (system(cmd) != 0) return -1;
+        double elapsed = bench_now() - start;
+        if (best < 0 || elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+bool bench_compare(const char *src, const char *input, const DriverOptions variants[2], const char *const names[2], int runs) {
+    char exe[2][4096 + 16] = { "", "" }, out[2][4096 + 16] = { "", "" };
+    double best[2];
+    bool ok = true;
+    for (int i = 0; ok && i < 2; i++) {
+        snprintf(exe[i], sizeof(exe[i]), "%s.%d", src, i);
+        snprintf(out[i], sizeof(out[i]), "%s.%d.out", src, i);
+        // jpc -o と同じく、gcc には最適化を指定しない。gcc を動かすので実行ファイルのキャッシュは使わない
+        DriverOptions opts = variants[i];
+        opts.build.use_cache = false;
+        char *code;
+        size_t len;
+        ok = bench_compile(src, &opts, NULL, &code, &len);
+        if (!ok) break;
+        ok = bench_build(&opts.build, code, len, exe[i]) >= 0;
+        free(code);
+        best[i] = ok ? bench_run(exe[i], input, out[i], runs) : -1;
+        if (ok && best[i] < 0) {
+            fprintf(stderr, "Error: %s failed\n", exe[i]);
+            ok = false;
+        }
+    }
+    bool same = ok && bench_same_file(out[0], out[1]);
+    if (ok) {
+        printf("%s: best of %d: %.3f ms\n", names[0], runs, best[0] * 1e3);
+        printf("%s: best of %d: %.3f ms (%.2fx)\n", names[1], runs, best[1] * 1e3, best[0] / best[1]);
+        printf("output: %s\n", same ? "identical" : "DIFFERENT");
+    }
+    for (int i = 0; i < 2; i++) {
+        unlink(exe[i]);
+        unlink(out[i]);
+    }
+    return same;
+}
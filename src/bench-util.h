@@ -0,0 +1,42 @@
+// bench-util.h
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "driver.h"
+
+// --- ベンチマークとテストの共通部分 ---
+// *-bench と *-test が使う。時間の計測、ソースの生成と読み込み、
+// jpc と同じ手順 (driver.h・build.h) でのコンパイル、実行ファイルの実行と出力の比較
+
+// 単調増加する時計の秒数
+double bench_now(void);
+
+// ファイル全体を読む (末尾に '\0' を付ける)。読めなければ NULL。呼び出し側で free する
+char *bench_read_file(const char *path, size_t *len);
+
+// ファイルの中身が同じか
+bool bench_same_file(const char *path1, const char *path2);
+
+// generate(fp, n) で生成したソースを path に書く。書けなければ false
+bool bench_write_source(const char *path, void (*generate)(FILE *fp, long n), long n);
+
+// path を jpc と同じく読み込んで最適化し、C (opts->build.assembly ならアセンブリ) をメモリ上に生成する。
+// stats が NULL でなければ最適化の回数を書き込む。失敗したらエラーを標準エラー出力に表示して false
+bool bench_compile(const char *path, const DriverOptions *opts, OptStats *stats, char **code, size_t *len);
+
+// len バイトの code から jpc -o と同じく実行ファイル exe を作る。かかった秒数を返し、失敗したら負の値
+double bench_build(const BuildOptions *opts, const char *code, size_t len, const char *exe);
+
+// exe を runs 回実行し、最も短い秒数を返す。失敗したら負の値。
+// 標準入力は input (NULL なら入力なし)、標準出力は out に書く
+double bench_run(const char *exe, const char *input, const char *out, int runs);
+
+// src を variants[0] と variants[1] で実行ファイルにし、それぞれ runs 回実行して速さと出力を比べる。
+// 実行ファイルと出力は src の隣に作って最後に消す。標準入力は input (NULL なら入力なし)。
+// names を見出しにして最短の秒数と出力が同じかを表示し、同じなら true (作れない・実行できない場合も false)
+bool bench_compare(const char *src, const char *input, const DriverOptions variants[2], const char *const names[2], int runs);
+
+#endif
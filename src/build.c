@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "build.h"
+#include "cache.h"
+#include "error.h"
+
+extern char **environ;
+
+// gcc のコマンドライン (要素は呼び出し側のバッファを指す)
+#define MAX_ARGS 16
+
+typedef struct {
+    char *argv[MAX_ARGS + 1];
+    int argc;
+    char opt_flag[8];       // -O<level>
+    char march_flag[256];   // -march=<arch>
+} GccArgs;
+
+bool build_valid_cc_opt(const char *level) {
+    return level[0] >= '0' && level[0] <= '3' && level[1] == '\0';
+}
+
+bool build_valid_march(const char *arch) {
+    if (*arch == '\0' || strlen(arch) > 200) return false;
+    for (const char *p = arch; *p; p++) {
+        if (!isalnum((unsigned char)*p) && *p != '-' && *p != '_' && *p != '.') return false;
+    }
+    return true;
+}
+
+// ファイルの中身を読む (読めなければ NULL)
+static char *read_file(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) return NULL;
+    char *buf = NULL;
+    size_t cap = 0;
+    *len = 0;
+    for (;;) {
+        if (*len == cap) {
+            cap = cap ? cap * 2 : 4096;
+            char *grown = realloc(buf, cap);
+            if (grown == NULL) break;
+            buf = grown;
+        }
+        size_t n = fread(buf + *len, 1, cap - *len, fp);
+        if (n == 0) break;
+        *len += n;
+    }
+    bool ok = !ferror(fp) && buf != NULL;
+    fclose(fp);
+    if (!ok) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+static void add_arg(GccArgs *args, const char *arg) {
+    if (args->argc < MAX_ARGS) args->argv[args->argc++] = (char *)arg;
+    args->argv[args->argc] = NULL;
+}
+
+// "gcc" と、最適化レベル・-march (指定があれば) から始める
+static void gcc_args(GccArgs *args, const BuildOptions *opts) {
+    args->argc = 0;
+    add_arg(args, "gcc");
+    if (opts->cc_opt != NULL) {
+        snprintf(args->opt_flag, sizeof(args->opt_flag), "-O%s", opts->cc_opt);
+        add_arg(args, args->opt_flag);
+    }
+    if (opts->march != NULL) {
+        snprintf(args->march_flag, sizeof(args->march_flag), "-march=%s", opts->march);
+        add_arg(args, args->march_flag);
+    }
+}
+
+// argv を起動して終わるのを待つ。終了コードが 0 なら true。
+// src があればパイプで標準入力に書き、なければ in_path (NULL ならそのまま) を標準入力にする。
+// quiet なら標準出力は捨てる
+static bool spawn_wait(char *const argv[], const char *src, size_t len, const char *in_path, bool quiet) {
+    posix_spawn_file_actions_t actions;
+    int pipe_fd[2] = { -1, -1 };
+    posix_spawn_file_actions_init(&actions);
+    if (src != NULL) {
+        if (pipe(pipe_fd) != 0) {
+            posix_spawn_file_actions_destroy(&actions);
+            return false;
+        }
+        // 書き込み側は gcc に渡さない (渡すと gcc が入力の終わりを受け取れない)
+        fcntl(pipe_fd[1], F_SETFD, FD_CLOEXEC);
+        posix_spawn_file_actions_adddup2(&actions, pipe_fd[0], 0);
+        posix_spawn_file_actions_addclose(&actions, pipe_fd[0]);
+    } else if (in_path != NULL) {
+        posix_spawn_file_actions_addopen(&actions, 0, in_path, O_RDONLY, 0);
+    }
+    if (quiet) posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+
+    pid_t pid;
+    int err = posix_spawnp(&pid, argv[0], &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (src != NULL) close(pipe_fd[0]);
+    if (err != 0) {
+        if (src != NULL) close(pipe_fd[1]);
+        return false;
+    }
+
+    bool ok = true;
+    if (src != NULL) {
+        // gcc が途中で終わっても SIGPIPE で止まらず、書き込みの失敗として扱う。
+        // 複数のスレッドから同時に呼ばれる (jpc -d) ので、プロセス全体の設定は変えずにこのスレッドだけで止める
+        sigset_t pipe_set, saved;
+        sigemptyset(&pipe_set);
+        sigaddset(&pipe_set, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipe_set, &saved);
+        bool broken = false;
+        for (size_t off = 0; off < len; ) {
+            ssize_t n = write(pipe_fd[1], src + off, len - off);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                broken = errno == EPIPE;
+                ok = false;
+                break;
+            }
+            off += (size_t)n;
+        }
+        close(pipe_fd[1]);
+        if (broken) {
+            // 止めている間に届いた SIGPIPE を捨ててから元に戻す
+            struct timespec zero = { 0, 0 };
+            while (sigtimedwait(&pipe_set, NULL, &zero) == SIGPIPE) {}
+        }
+        pthread_sigmask(SIG_SETMASK, &saved, NULL);
+    }
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return false;
+    }
+    return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// gcc のバージョンとターゲット (例: "12.2.0\nx86_64-linux-gnu\n") を buf に読む
+static bool gcc_version(char *buf, size_t size) {
+    char *argv[] = { "gcc", "-dumpfullversion", "-dumpmachine", NULL };
+    posix_spawn_file_actions_t actions;
+    int pipe_fd[2];
+    if (pipe(pipe_fd) != 0) return false;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, pipe_fd[1], 1);
+    posix_spawn_file_actions_addclose(&actions, pipe_fd[0]);
+    posix_spawn_file_actions_addclose(&actions, pipe_fd[1]);
+    pid_t pid;
+    int err = posix_spawnp(&pid, argv[0], &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(pipe_fd[1]);
+    size_t len = 0;
+    if (err == 0) {
+        while (len + 1 < size) {
+            ssize_t n = read(pipe_fd[0], buf + len, size - 1 - len);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            len += (size_t)n;
+        }
+    }
+    close(pipe_fd[0]);
+    buf[len] = '\0';
+    if (err != 0) return false;
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 && len > 0;
+}
+
+// gcc のバージョンはプロセスの中で 1 回だけ調べる
+static pthread_once_t version_once = PTHREAD_ONCE_INIT;
+static char version[256];
+static bool has_version;
+
+static void read_gcc_version(void) {
+    has_version = gcc_version(version, sizeof(version));
+}
+
+// 実行ファイルのキャッシュのキー (生成したソース・gcc のコマンドライン・gcc のバージョン)
+static bool binary_key(const GccArgs *args, const char *src, size_t len, uint64_t *key) {
+    pthread_once(&version_once, read_gcc_version);
+    if (!has_version) return false;
+    *key = cache_key(src, len);
+    for (int i = 1; i < args->argc; i++) {
+        *key = *key * 31 + cache_key(args->argv[i], strlen(args->argv[i]));
+    }
+    *key = *key * 31 + cache_key(version, strlen(version));
+    return true;
+}
+
+// プロファイルのキー (生成したソース・gcc のオプション・学習用の入力)
+static bool profile_key(JpcContext *ctx, const BuildOptions *opts, const GccArgs *args, const char *src, size_t len, uint64_t *key) {
+    size_t input_len;
+    char *train = read_file(opts->pgo_input, &input_len);
+    if (train == NULL) {
+        record_error(ctx, ERR_SYSTEM, "ファイルを読めません: %s", opts->pgo_input);
+        return false;
+    }
+    *key = cache_key(src, len);
+    for (int i = 1; i < args->argc; i++) {
+        *key = *key * 31 + cache_key(args->argv[i], strlen(args->argv[i]));
+    }
+    *key = *key * 31 + cache_key(train, input_len);
+    free(train);
+    return true;
+}
+
+// プロファイルを取って、それを使った実行ファイルを作る。
+// オブジェクトをプロファイルのディレクトリに置くと、.gcda も同じ名前でそこに書かれる
+static bool build_with_profile(JpcContext *ctx, const BuildOptions *opts, const char *src, size_t len, const char *exe) {
+    char root[4096], dir[4096], obj[4096 + 16], stamp[4096 + 16];
+    GccArgs args;
+    uint64_t key;
+    gcc_args(&args, opts);
+    if (!profile_key(ctx, opts, &args, src, len, &key)) return false;
+    if (!cache_dir(root, sizeof(root)) || !cache_profile_dir(dir, sizeof(dir), root, key)) {
+        record_error(ctx, ERR_SYSTEM, "プロファイルを置くディレクトリを作成できません。");
+        return false;
+    }
+    snprintf(obj, sizeof(obj), "%s/prog.o", dir);
+    snprintf(stamp, sizeof(stamp), "%s/trained", dir);
+    int base = args.argc;
+
+    if (access(stamp, F_OK) != 0) {
+        // 前回の計測の途中で止まっていたら、回数が足されないように消してから取り直す
+        char gcda[4096 + 16];
+        snprintf(gcda, sizeof(gcda), "%s/prog.gcda", dir);
+        remove(gcda);
+        char *link[] = { "gcc", "-fprofile-generate", "-o", (char *)exe, obj, NULL };
+        const char *compile[] = { "-fprofile-generate", "-x", "c", "-c", "-o", obj, "-" };
+        for (size_t i = 0; i < sizeof(compile) / sizeof(compile[0]); i++) add_arg(&args, compile[i]);
+        if (!spawn_wait(args.argv, src, len, NULL, false) || !spawn_wait(link, NULL, 0, NULL, false)) {
+            record_error(ctx, ERR_SYSTEM, "計測用の実行ファイルを作成できません。");
+            return false;
+        }
+        char *train[] = { (char *)exe, NULL };
+        char exe_path[4096 + 2];
+        if (strchr(exe, '/') == NULL) {
+            snprintf(exe_path, sizeof(exe_path), "./%s", exe);
+            train[0] = exe_path;
+        }
+        if (!spawn_wait(train, NULL, 0, opts->pgo_input, true)) {
+            record_error(ctx, ERR_SYSTEM, "計測用の実行ファイルが失敗しました: %s", opts->pgo_input);
+            return false;
+        }
+        FILE *fp = fopen(stamp, "w");
+        if (fp != NULL) fclose(fp);
+    }
+
+    args.argc = base;
+    const char *compile[] = { "-fprofile-use", "-fprofile-correction", "-x", "c", "-c", "-o", obj, "-" };
+    for (size_t i = 0; i < sizeof(compile) / sizeof(compile[0]); i++) add_arg(&args, compile[i]);
+    char *link[] = { "gcc", "-o", (char *)exe, obj, NULL };
+    if (!spawn_wait(args.argv, src, len, NULL, false) || !spawn_wait(link, NULL, 0, NULL, false)) {
+        record_error(ctx, ERR_SYSTEM, "GCCコンパイルに失敗しました。");
+        return false;
+    }
+    return true;
+}
+
+bool build_executable(JpcContext *ctx, const BuildOptions *opts, const char *src, size_t len, const char *exe, bool *cache_hit) {
+    if (cache_hit != NULL) *cache_hit = false;
+    if (opts->pgo_input != NULL) {
+        if (opts->assembly) {
+            record_error(ctx, ERR_SYSTEM, "--pgo は --asm と一緒には使えません。");
+            return false;
+        }
+        return build_with_profile(ctx, opts, src, len, exe);
+    }
+
+    GccArgs args;
+    if (opts->assembly) {
+        // -x assembler: プリプロセッサも C のコンパイラも通さず、as と ld だけを動かす
+        args.argc = 0;
+        add_arg(&args, "gcc");
+        add_arg(&args, "-x");
+        add_arg(&args, "assembler");
+    } else {
+        gcc_args(&args, opts);
+        add_arg(&args, "-x");
+        add_arg(&args, "c");
+    }
+
+    // 同じソースを同じ gcc で作ったことがあれば、キャッシュの実行ファイルを使う
+    char root[4096];
+    uint64_t key;
+    bool use_cache = opts->use_cache && cache_dir(root, sizeof(root)) && binary_key(&args, src, len, &key);
+    if (use_cache && cache_fetch_binary(root, key, exe)) {
+        if (cache_hit != NULL) *cache_hit = true;
+        return true;
+    }
+
+    add_arg(&args, "-o");
+    add_arg(&args, exe);
+    add_arg(&args, "-");
+    if (!spawn_wait(args.argv, src, len, NULL, false)) {
+        record_error(ctx, ERR_SYSTEM, opts->assembly ? "アセンブルまたはリンクに失敗しました。" : "GCCコンパイルに失敗しました。");
+        return false;
+    }
+    // キャッシュに入れられなくても実行ファイルはできているので、結果は見ない
+    if (use_cache) cache_store_binary(root, key, exe);
+    return true;
+}
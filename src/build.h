@@ -0,0 +1,37 @@
+// build.h
+#ifndef BUILD_H
+#define BUILD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "context.h"
+
+// --- 実行ファイルの作成 (gcc の呼び出し) ---
+// メモリ上に生成した C (--asm ではアセンブリ) を、シェルを通さずに起動した gcc にパイプで渡して実行ファイルにする
+// (一時ファイルを作らないので、同じディレクトリで同時にコンパイルしてもぶつからない)。
+// gcc の最適化レベルと -march はそのまま渡す (--asm ではアセンブラとリンカだけなので使わない)。
+// --pgo では計測用の実行ファイルを作って学習用の入力で動かし、そのプロファイルを使って作り直す。
+// プロファイルは生成したソース・gcc のオプション・学習用の入力から作ったキーごとにキャッシュに置き、
+// 同じ組み合わせなら計測を省く。
+// PGO を使わないときは、生成したソース・gcc のコマンドライン・gcc のバージョンが同じなら
+// gcc を動かさずにキャッシュした実行ファイルを使う (cache.h)
+
+typedef struct {
+    bool assembly;          // ソースがアセンブリ (--asm)
+    const char *cc_opt;     // gcc の最適化レベル "0"〜"3" (NULL なら指定しない)
+    const char *march;      // gcc の -march (NULL なら指定しない)
+    const char *pgo_input;  // プロファイルを取るときの標準入力のファイル (NULL なら PGO しない)
+    bool use_cache;         // 実行ファイルのキャッシュを使う (--no-cache でなければ true)
+} BuildOptions;
+
+#define BUILD_DEFAULTS ((BuildOptions){ false, NULL, NULL, NULL, true })
+
+// gcc の最適化レベルと -march の値として使えるか (シェルに渡すので使える文字を限る)
+bool build_valid_cc_opt(const char *level);
+bool build_valid_march(const char *arch);
+
+// len バイトのソース src から実行ファイル exe を作る。失敗したら ctx にエラーを記録して false を返す。
+// cache_hit が NULL でなければ、キャッシュの実行ファイルを使ったかを書き込む
+bool build_executable(JpcContext *ctx, const BuildOptions *opts, const char *src, size_t len, const char *exe, bool *cache_hit);
+
+#endif
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "bench-util.h"
+#include "lexer.h"
+#include "parser.h"
+#include "codegen.h"
+#include "context.h"
+#include "cache.h"
+
+// 同じ入力を、キャッシュなし (字句解析・構文解析から) とキャッシュあり (AST を読み込む) でコンパイルして比べる
+
+// 宣言・演算・条件分岐・出力を繰り返した入力を生成する
+static void generate_input(FILE *fp, int blocks) {
+    fprintf(fp, "メイン｛\n");
+    fprintf(fp, "　　”合計”を「０」で宣言する。\n");
+    for (int i = 0; i < blocks; i++) {
+        fprintf(fp, "　　＃　ブロック%d\n", i);
+        fprintf(fp, "　　”変数%d”を「%d」で宣言する。\n", i, i % 100);
+        fprintf(fp, "　　”変数%d”に「１．５」をたす。\n", i);
+        fprintf(fp, "　　”変数%d”から「２」をひく。\n", i);
+        fprintf(fp, "　　ループ（”変数%d”が「５０」以上か　かつ　”合計”が「１０００」より小さいか）｛\n", i);
+        fprintf(fp, "　　　　”合計”に”変数%d”をたす。\n", i);
+        fprintf(fp, "　　｝\n");
+        fprintf(fp, "　　もし（”変数%d”が「１」と一緒か）｛\n", i);
+        fprintf(fp, "　　　　「値は”変数%d”、合計は”合計”です」と出力する。\n", i);
+        fprintf(fp, "　　｝\n");
+        fprintf(fp, "　　ではない｛\n");
+        fprintf(fp, "　　　　”変数%d”を「４」でわる。\n", i);
+        fprintf(fp, "　　｝\n");
+    }
+    fprintf(fp, "｝\n");
+}
+
+// jpc と同じ手順で1回コンパイルし、生成コードは捨てる。失敗したら false
+static bool compile_once(FILE *fp, FILE *out, const char *dir, bool use_cache) {
+    JpcContext *ctx = new_context();
+    bool ok = false;
+    rewind(fp);
+    if (!loadLexerSource(ctx, fp)) goto done;
+    uint64_t key = cache_key(ctx->src_begin, ctx->src_end - ctx->src_begin);
+    const Ast *ast = use_cache ? cache_load_ast(ctx, dir, key) : NULL;
+    if (use_cache && ast == NULL) {
+        fprintf(stderr, "Error: cache miss\n");
+        goto done;
+    }
+    if (ast == NULL) {
+        if (!tokenizeSource(ctx)) goto done;
+        getNextToken(ctx);
+        Node *root = parse_program(ctx);
+        if (root == NULL || (ast = build_ast(ctx, root)) == NULL) goto done;
+        cache_store_ast(ast, dir, key);
+    }
+    ok = codegen(ctx, ast, NULL, out);
+done:
+    if (!ok) print_errors(ctx, stderr);
+    free_context(ctx);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    int blocks = argc > 1 ? atoi(argv[1]) : 20000;
+    int runs = 5;
+
+    char dir[] = "/tmp/jpc-cache-bench-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        fprintf(stderr, "Error: Cannot create cache directory\n");
+        return 1;
+    }
+    FILE *fp = tmpfile();
+    FILE *out = fopen("/dev/null", "w");
+    if (fp == NULL || out == NULL) {
+        fprintf(stderr, "Error: Cannot create temporary file\n");
+        return 1;
+    }
+    generate_input(fp, blocks);
+    fflush(fp);
+    long bytes = ftell(fp);
+
+    double best[2] = {0, 0};
+    for (int warm = 0; warm < 2; warm++) {
+        for (int r = 0; r < runs; r++) {
+            double start = bench_now();
+            if (!compile_once(fp, out, dir, warm)) return 1;
+            double elapsed = bench_now() - start;
+            if (r == 0 || elapsed < best[warm]) best[warm] = elapsed;
+        }
+    }
+
+    printf("=== Cache Bench: %ld bytes ===\n", bytes);
+    printf("cold (lex + parse + codegen): best of %d: %.3f ms\n", runs, best[0] * 1e3);
+    printf("warm (cached AST + codegen):  best of %d: %.3f ms (%.1fx)\n", runs, best[1] * 1e3, best[0] / best[1]);
+
+    // キャッシュを片付ける
+    rewind(fp);
+    JpcContext *ctx = new_context();
+    if (loadLexerSource(ctx, fp)) {
+        char path[4096];
+        cache_path(path, sizeof(path), dir, cache_key(ctx->src_begin, ctx->src_end - ctx->src_begin));
+        unlink(path);
+    }
+    free_context(ctx);
+    rmdir(dir);
+
+    fclose(out);
+    fclose(fp);
+    return 0;
+}
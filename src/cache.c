@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#include "cache.h"
+#include "context.h"
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME  0x100000001b3ULL
+
+static uint64_t fnv1a(uint64_t h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+uint64_t cache_key(const void *src, size_t len) {
+    // バージョン文字列は NUL まで含めて、ソースとの境目をはっきりさせる
+    uint64_t h = fnv1a(FNV_OFFSET, JPC_VERSION, sizeof(JPC_VERSION));
+    return fnv1a(h, src, len);
+}
+
+// path までのディレクトリを順に作る (既にあればそのまま)
+static bool make_dirs(char *path) {
+    for (char *p = path + 1; ; p++) {
+        if (*p != '/' && *p != '\0') continue;
+        char c = *p;
+        *p = '\0';
+        int r = mkdir(path, 0755);
+        *p = c;
+        if (r != 0 && errno != EEXIST) return false;
+        if (c == '\0') return true;
+    }
+}
+
+bool cache_dir(char *buf, size_t size) {
+    const char *env;
+    int n;
+    if ((env = getenv("JPC_CACHE_DIR")) != NULL && *env) {
+        n = snprintf(buf, size, "%s", env);
+    } else if ((env = getenv("XDG_CACHE_HOME")) != NULL && *env) {
+        n = snprintf(buf, size, "%s/jpc", env);
+    } else if ((env = getenv("HOME")) != NULL && *env) {
+        n = snprintf(buf, size, "%s/.cache/jpc", env);
+    } else {
+        return false;
+    }
+    if (n < 0 || (size_t)n >= size) return false;
+    return make_dirs(buf);
+}
+
+void cache_path(char *buf, size_t size, const char *dir, uint64_t key) {
+    snprintf(buf, size, "%s/%016llx.ast", dir, (unsigned long long)key);
+}
+
+static void evict_cache(const char *dir);
+
+bool cache_profile_dir(char *buf, size_t size, const char *dir, uint64_t key) {
+    int n = snprintf(buf, size, "%s/pgo/%016llx", dir, (unsigned long long)key);
+    if (n < 0 || (size_t)n >= size) return false;
+    bool created = access(buf, F_OK) != 0;
+    if (!make_dirs(buf)) return false;
+    // ディレクトリの更新時刻を使った時刻として LRU に使う。新しく作ったなら、ほかのものを消して場所を空ける
+    utimensat(AT_FDCWD, buf, NULL, 0);
+    if (created) evict_cache(dir);
+    return true;
+}
+
+const Ast *cache_load_ast(JpcContext *ctx, const char *dir, uint64_t key) {
+    char path[4096];
+    cache_path(path, sizeof(path), dir, key);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    const Ast *ast = NULL;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            ast = read_ast(ctx, p, (size_t)st.st_size, key);
+            munmap(p, (size_t)st.st_size);
+        }
+    }
+    // 更新時刻を使った時刻として LRU に使う
+    if (ast != NULL) futimens(fd, NULL);
+    close(fd);
+    return ast;
+}
+
+bool cache_store_ast(const Ast *ast, const char *dir, uint64_t key) {
+    char path[4096], tmp[4096 + 16];
+    cache_path(path, sizeof(path), dir, key);
+    // 書きかけのファイルを読まれないように、一時ファイルに書いてから置き換える
+    snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path);
+    int fd = mkstemp(tmp);
+    if (fd < 0) return false;
+    FILE *fp = fdopen(fd, "wb");
+    if (fp == NULL) {
+        close(fd);
+        unlink(tmp);
+        return false;
+    }
+    bool ok = write_ast(ast, key, fp);
+    if (fclose(fp) != 0) ok = false;
+    if (ok && rename(tmp, path) != 0) ok = false;
+    if (!ok) unlink(tmp);
+    if (ok) evict_cache(dir);
+    return ok;
+}
+
+// --- 実行ファイルのキャッシュ ---
+
+// キャッシュにあるもの 1 つ (実行ファイル、AST、プロファイルのディレクトリ)
+typedef struct {
+    char name[32];          // キャッシュディレクトリからの相対パス
+    struct timespec used;   // 最後に使った時刻 (更新時刻)
+    uint64_t size;
+    bool is_dir;            // プロファイルのディレクトリ
+} CacheEntry;
+
+// キャッシュを数えた結果
+typedef struct {
+    CacheEntry *list;       // 一覧 (want_list のときだけ)
+    uint64_t cap;
+    bool want_list;
+    uint64_t count;         // すべての数
+    uint64_t bytes;         // すべての合計の大きさ
+} CacheScan;
+
+// 実行ファイルを置くディレクトリ dir/bin を作り、パスを buf に書き込む
+static bool bin_dir(char *buf, size_t size, const char *dir) {
+    int n = snprintf(buf, size, "%s/bin", dir);
+    if (n < 0 || (size_t)n >= size) return false;
+    return make_dirs(buf);
+}
+
+static uint64_t cache_limit(void) {
+    const char *env = getenv("JPC_CACHE_SIZE");
+    if (env != NULL && *env) {
+        char *end;
+        unsigned long long mib = strtoull(env, &end, 10);
+        if (*end == '\0') return (uint64_t)mib << 20;
+    }
+    return CACHE_SIZE_DEFAULT;
+}
+
+// ヒット・ミスの回数 (bin/stats) を読む。fd は flock 済みであること
+static void read_counts(int fd, unsigned long long *hits, unsigned long long *misses) {
+    char buf[64];
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    *hits = *misses = 0;
+    if (n <= 0) return;
+    buf[n] = '\0';
+    if (sscanf(buf, "%llu %llu", hits, misses) != 2) *hits = *misses = 0;
+}
+
+// ヒット・ミスの回数を足す (同時に動く jpc と数がずれないように flock で守る)
+static void count_binary(const char *bdir, bool hit) {
+    char path[4096 + 16];
+    snprintf(path, sizeof(path), "%s/stats", bdir);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return;
+    if (flock(fd, LOCK_EX) == 0) {
+        unsigned long long hits, misses;
+        read_counts(fd, &hits, &misses);
+        if (hit) hits++; else misses++;
+        char buf[64];
+        int len = snprintf(buf, sizeof(buf), "%llu %llu\n", hits, misses);
+        if (pwrite(fd, buf, (size_t)len, 0) == len && ftruncate(fd, len) != 0) {
+            // 数がずれても害はないので何もしない
+        }
+    }
+    close(fd);
+}
+
+// src を dst にコピーする (書きかけのファイルを使われないように、一時ファイルに書いてから置き換える)。
+// reflink できるファイルシステムではデータを共有したまま別のファイルにし、できなければ中身をコピーする。
+// ハードリンクにすると、出力先を書き換えたときにキャッシュも壊れ、LRU のための更新時刻も出力先に付いてしまう
+static bool copy_file(const char *src, const char *dst) {
+    char tmp[4096 + 16];
+    int in = open(src, O_RDONLY);
+    if (in < 0) return false;
+    snprintf(tmp, sizeof(tmp), "%s.XXXXXX", dst);
+    int out = mkstemp(tmp);
+    if (out < 0) {
+        close(in);
+        return false;
+    }
+    bool ok = fchmod(out, 0755) == 0;
+    bool cloned = ok && ioctl(out, FICLONE, in) == 0;
+    char buf[1 << 16];
+    while (ok && !cloned) {
+        ssize_t n = read(in, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            ok = n == 0;
+            break;
+        }
+        for (ssize_t off = 0; ok && off < n; ) {
+            ssize_t w = write(out, buf + off, (size_t)(n - off));
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) ok = false;
+            else off += w;
+        }
+    }
+    close(in);
+    if (close(out) != 0) ok = false;
+    if (ok && rename(tmp, dst) != 0) ok = false;
+    if (!ok) unlink(tmp);
+    return ok;
+}
+
+// 16 桁の 16 進数のキーのあとに suffix が続く名前か
+static bool is_key_name(const char *name, const char *suffix) {
+    return strspn(name, "0123456789abcdef") == 16 && strcmp(name + 16, suffix) == 0;
+}
+
+// ディレクトリの中のファイルの大きさの合計
+static uint64_t dir_size(int parent, const char *name) {
+    int fd = openat(parent, name, O_RDONLY | O_DIRECTORY);
+    DIR *d = fd < 0 ? NULL : fdopendir(fd);
+    if (d == NULL) {
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    uint64_t bytes = 0;
+    struct dirent *de;
+    struct stat st;
+    while ((de = readdir(d)) != NULL) {
+        if (fstatat(dirfd(d), de->d_name, &st, 0) == 0 && S_ISREG(st.st_mode)) bytes += (uint64_t)st.st_size;
+    }
+    closedir(d);
+    return bytes;
+}
+
+// dir/sub (sub が "" なら dir) にある、キーと suffix の名前のものを scan に加える。count にはその数を足す
+static void scan_entries(const char *dir, const char *sub, const char *suffix, bool is_dir, CacheScan *scan, uint64_t *count) {
+    char path[4096 + 16];
+    snprintf(path, sizeof(path), "%s/%s", dir, sub);
+    DIR *d = opendir(path);
+    if (d == NULL) return;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        struct stat st;
+        if (!is_key_name(de->d_name, suffix) || fstatat(dirfd(d), de->d_name, &st, 0) != 0) continue;
+        if (S_ISDIR(st.st_mode) != is_dir) continue;
+        uint64_t size = is_dir ? dir_size(dirfd(d), de->d_name) : (uint64_t)st.st_size;
+        if (scan->want_list) {
+            if (scan->count == scan->cap) {
+                uint64_t cap = scan->cap ? scan->cap * 2 : 64;
+                CacheEntry *grown = realloc(scan->list, sizeof(CacheEntry) * cap);
+                if (grown == NULL) break;
+                scan->list = grown;
+                scan->cap = cap;
+            }
+            CacheEntry *e = &scan->list[scan->count];
+            // 名前はキーと suffix だけなので 20 バイトに収まる
+            snprintf(e->name, sizeof(e->name), "%s%s%.20s", sub, *sub ? "/" : "", de->d_name);
+            e->used = st.st_mtim;
+            e->size = size;
+            e->is_dir = is_dir;
+        }
+        scan->count++;
+        scan->bytes += size;
+        (*count)++;
+    }
+    closedir(d);
+}
+
+// キャッシュにある実行ファイル・AST・プロファイルを数える
+static void scan_cache(const char *dir, CacheScan *scan, BinCacheStats *stats) {
+    scan_entries(dir, "bin", "", false, scan, &stats->entries);
+    scan_entries(dir, "", ".ast", false, scan, &stats->asts);
+    scan_entries(dir, "pgo", "", true, scan, &stats->profiles);
+    stats->bytes = scan->bytes;
+}
+
+static int compare_used(const void *a, const void *b) {
+    const struct timespec *x = &((const CacheEntry *)a)->used, *y = &((const CacheEntry *)b)->used;
+    if (x->tv_sec != y->tv_sec) return x->tv_sec < y->tv_sec ? -1 : 1;
+    if (x->tv_nsec != y->tv_nsec) return x->tv_nsec < y->tv_nsec ? -1 : 1;
+    return 0;
+}
+
+// プロファイルのディレクトリを中のファイルごと消す
+static bool remove_profile(const char *path) {
+    DIR *d = opendir(path);
+    if (d == NULL) return false;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (strcmp(de->d_name, ".") != 0 && strcmp(de->d_name, "..") != 0) unlinkat(dirfd(d), de->d_name, 0);
+    }
+    closedir(d);
+    return rmdir(path) == 0;
+}
+
+// 実行ファイル・AST・プロファイルの合計が上限を超えていれば、種類を問わず最後に使ってから長いものから消す
+static void evict_cache(const char *dir) {
+    CacheScan scan = { .want_list = true };
+    BinCacheStats counts = { 0 };
+    uint64_t limit = cache_limit();
+    scan_cache(dir, &scan, &counts);
+    if (scan.bytes > limit) {
+        qsort(scan.list, scan.count, sizeof(CacheEntry), compare_used);
+        char path[4096 + 48];
+        for (uint64_t i = 0; i < scan.count && scan.bytes > limit; i++) {
+            snprintf(path, sizeof(path), "%s/%s", dir, scan.list[i].name);
+            bool removed = scan.list[i].is_dir ? remove_profile(path) : unlink(path) == 0;
+            if (removed) scan.bytes -= scan.list[i].size;
+        }
+    }
+    free(scan.list);
+}
+
+bool cache_fetch_binary(const char *dir, uint64_t key, const char *exe) {
+    char bdir[4096], path[4096 + 32];
+    if (!bin_dir(bdir, sizeof(bdir), dir)) return false;
+    snprintf(path, sizeof(path), "%s/%016llx", bdir, (unsigned long long)key);
+    bool hit = access(path, X_OK) == 0 && copy_file(path, exe);
+    // 更新時刻を使った時刻として LRU に使う
+    if (hit) utimensat(AT_FDCWD, path, NULL, 0);
+    count_binary(bdir, hit);
+    return hit;
+}
+
+bool cache_store_binary(const char *dir, uint64_t key, const char *exe) {
+    char bdir[4096], path[4096 + 32];
+    if (!bin_dir(bdir, sizeof(bdir), dir)) return false;
+    snprintf(path, sizeof(path), "%s/%016llx", bdir, (unsigned long long)key);
+    if (!copy_file(exe, path)) return false;
+    evict_cache(dir);
+    return true;
+}
+
+bool cache_binary_stats(const char *dir, BinCacheStats *stats) {
+    char bdir[4096], path[4096 + 16];
+    if (!bin_dir(bdir, sizeof(bdir), dir)) return false;
+    memset(stats, 0, sizeof(*stats));
+    stats->limit = cache_limit();
+    snprintf(path, sizeof(path), "%s/stats", bdir);
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        unsigned long long hits, misses;
+        if (flock(fd, LOCK_SH) == 0) {
+            read_counts(fd, &hits, &misses);
+            stats->hits = hits;
+            stats->misses = misses;
+        }
+        close(fd);
+    }
+    CacheScan scan = { .want_list = false };
+    scan_cache(dir, &scan, stats);
+    return true;
+}
@@ -0,0 +1,58 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "ast.h"
+
+// --- AST キャッシュ ---
+// 入力内容とコンパイラのバージョンから作ったキーごとに、直列化した AST をファイルに置く。
+// 同じ入力を再びコンパイルするときは、字句解析・構文解析の代わりにキャッシュを読み込む。
+
+// コンパイラのバージョン (キャッシュのキーに含める)
+#define JPC_VERSION "0.11.0"
+
+// 入力内容のキー (コンパイラのバージョンとソースの FNV-1a 64 ビットハッシュ)
+uint64_t cache_key(const void *src, size_t len);
+
+// キャッシュディレクトリを決めて作成し、buf に書き込む (使えなければ false)
+// $JPC_CACHE_DIR、$XDG_CACHE_HOME/jpc、$HOME/.cache/jpc の順に探す
+bool cache_dir(char *buf, size_t size);
+
+// キーに対応するキャッシュファイルのパスを buf に書き込む
+void cache_path(char *buf, size_t size, const char *dir, uint64_t key);
+
+// キーに対応するプロファイル (--pgo) のディレクトリ dir/pgo/<key> を作り、パスを buf に書き込む。
+// AST とプロファイルも実行ファイルのキャッシュと同じ上限で LRU に消す (下の 実行ファイルのキャッシュ)
+bool cache_profile_dir(char *buf, size_t size, const char *dir, uint64_t key);
+
+// キャッシュから ctx->ast を読み込む (なければ、または壊れていれば NULL)
+const Ast *cache_load_ast(JpcContext *ctx, const char *dir, uint64_t key);
+// AST をキャッシュに書き込む (失敗しても害はないので結果だけ返す)
+bool cache_store_ast(const Ast *ast, const char *dir, uint64_t key);
+
+// --- 実行ファイルのキャッシュ ---
+// 生成したソース・gcc のコマンドライン・gcc のバージョンから作ったキーごとに、作った実行ファイルを dir/bin/<key> に置く。
+// 実行ファイル・AST・プロファイルの合計の大きさが上限 ($JPC_CACHE_SIZE MiB、既定は CACHE_SIZE_DEFAULT) を超えたら、
+// 種類を問わず最後に使ってから長いものから消す (LRU)
+
+#define CACHE_SIZE_DEFAULT (256ULL << 20)
+
+typedef struct {
+    uint64_t hits, misses;  // これまでのヒット・ミスの回数
+    uint64_t entries;       // キャッシュにある実行ファイルの数
+    uint64_t asts;          // キャッシュにある AST の数
+    uint64_t profiles;      // キャッシュにあるプロファイル (--pgo) の数
+    uint64_t bytes;         // そのすべての合計の大きさ
+    uint64_t limit;         // 大きさの上限
+} BinCacheStats;
+
+// キャッシュにあれば exe にコピー (できれば reflink) して true。ヒット・ミスの回数も数える
+bool cache_fetch_binary(const char *dir, uint64_t key, const char *exe);
+// exe をキャッシュにコピーし、上限を超えたら古いものから消す
+bool cache_store_binary(const char *dir, uint64_t key, const char *exe);
+// ヒット・ミスの回数とキャッシュの大きさ (AST とプロファイルも含める)
+bool cache_binary_stats(const char *dir, BinCacheStats *stats);
+
+#endif
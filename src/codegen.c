@@ -1,12 +1,25 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <setjmp.h>
 #include "codegen.h"
 #include "error.h"
+#include "context.h"
 
 // --- プロトタイプ宣言 (内部関数) ---
-void gen(Node *node, int depth, FILE *fp);
-void gen_block(Node *node, int depth, FILE *fp);
+void gen(JpcContext *ctx, const Ast *ast, const CodegenOptions *opts, uint32_t id, int depth, FILE *fp);
+void gen_block(JpcContext *ctx, const Ast *ast, const CodegenOptions *opts, uint32_t id, int depth, FILE *fp);
 void print_indent(int depth, FILE *fp);
+void gen_number(double val, FILE *fp);
+void gen_value(JpcContext *ctx, const Ast *ast, const CodegenOptions *opts, uint32_t id, bool as_int, FILE *fp);
+void gen_format(const Ast *ast, const ANode *str, FILE *fp);
+void gen_runtime_output(const Ast *ast, const ANode *str, int depth, FILE *fp);
+
+// 生成するプログラムに埋め込むランタイム (src/runtime.h を Makefile が文字列にしたもの)
+static const char runtime_source[] =
+#include "runtime.inc"
+;
 
 // --- ヘルパー関数 ---
 
@@ -17,24 +30,141 @@ void print_indent(int depth, FILE *fp) {
     }
 }
 
+// 数値を C の double 定数として出力する。
+// 整数はそのまま、それ以外は読み戻して同じ値になる最短の桁数で書く (値は正確に保たれる)
+void gen_number(double val, FILE *fp) {
+    if (isnan(val)) {
+        fprintf(fp, "(0.0 / 0.0)");
+        return;
+    }
+    if (isinf(val)) {
+        fprintf(fp, val > 0 ? "(1.0 / 0.0)" : "(-1.0 / 0.0)");
+        return;
+    }
+    if (fabs(val) < 1e15 && (double)(long long)val == val) {
+        fprintf(fp, "%.0f.0", val);
+        return;
+    }
+    char buf[32];
+    for (int prec = 1; prec <= 17; prec++) {
+        snprintf(buf, sizeof(buf), "%.*g", prec, val);
+        if (strtod(buf, NULL) == val) break;
+    }
+    fputs(buf, fp);
+    if (strpbrk(buf, ".e") == NULL) fputs(".0", fp);
+}
+
+// 整数 (int64_t) の文脈での値。整数の定数は小数点を付けずに出力する
+void gen_value(JpcContext *ctx, const Ast *ast, const CodegenOptions *opts, uint32_t id, bool as_int, FILE *fp) {
+    const ANode *node = &ast->nodes[id];
+    if (as_int && node->kind == ND_LITERAL) {
+        double val = ast_num(node);
+        if (fabs(val) <= 9007199254740992.0 && (double)(long long)val == val && !(val == 0 && signbit(val))) {
+            fprintf(fp, "%.0f", val);
+            return;
+        }
+    }
+    gen(ctx, ast, opts, id, 0, fp);
+}
+
+// 出力の書式。整数の変数に対応する %f は、double の %f と同じ表示になるよう
+// %" PRId64 ".000000 に置き換える (%% は変数に対応しないので飛ばす)
+void gen_format(const Ast *ast, const ANode *str, FILE *fp) {
+    const char *fmt = ast_str(ast, str);
+    const char *p = fmt;
+    uint32_t arg = 0;
+    fputc('"', fp);
+    while (*p) {
+        if (p[0] == '%' && p[1] == 'f') {
+            if (ast_is_int_var(ast, ast->ids[str->b + arg])) {
+                fwrite(fmt, 1, p - fmt, fp);
+                fprintf(fp, "%%\" PRId64 \".000000");
+                fmt = p + 2;
+            }
+            arg++;
+            p += 2;
+        } else if (p[0] == '%' || p[0] == '\\') {
+            p += 2;
+        } else {
+            p++;
+        }
+    }
+    fputs(fmt, fp);
+    fputc('"', fp);
+}
+
+// ランタイムでの出力。書式を文字列の部分と変数に分け、順に書き出す呼び出しにする
+void gen_runtime_output(const Ast *ast, const ANode *str, int depth, FILE *fp) {
+    const char *p = ast_str(ast, str);
+    uint32_t arg = 0;
+    bool open = false; // JPC_WRITE("... を書きかけているか
+    while (*p) {
+        if (p[0] == '%' && p[1] == 'f') {
+            if (open) fprintf(fp, "\");\n");
+            open = false;
+            int var = ast->ids[str->b + arg++];
+            print_indent(depth, fp);
+            fprintf(fp, "jpc_put_%c(jpc_var_%d);\n", ast_is_int_var(ast, var) ? 'i' : 'f', var);
+            p += 2;
+            continue;
+        }
+        if (!open) {
+            print_indent(depth, fp);
+            fprintf(fp, "JPC_WRITE(\"");
+            open = true;
+        }
+        if (p[0] == '%') {
+            // %% は % そのもの
+            fputc('%', fp);
+            p += 2;
+        } else if (p[0] == '\\') {
+            fwrite(p, 1, 2, fp);
+            p += 2;
+        } else {
+            fputc(*p++, fp);
+        }
+    }
+    if (open) fprintf(fp, "\");\n");
+}
+
 // --- コード生成メイン ---
 
 // ブロック処理 (出力先 fp を指定)
-void gen_block(Node *node, int depth, FILE *fp) {
-    for (; node; node = node->next) {
-        gen(node, depth, fp);
+void gen_block(JpcContext *ctx, const Ast *ast, const CodegenOptions *opts, uint32_t id, int depth, FILE *fp) {
+    for (; id; id = ast->nodes[id].next) {
+        gen(ctx, ast, opts, id, depth, fp);
     }
 }
 
 // 再帰的なノード処理 (出力先 fp を指定)
-void gen(Node *node, int depth, FILE *fp) {
-    if (!node) return;
+void gen(JpcContext *ctx, const Ast *ast, const CodegenOptions *opts, uint32_t id, int depth, FILE *fp) {
+    if (!id) return;
+    const ANode *node = &ast->nodes[id];
 
     switch (node->kind) {
     case ND_PROGRAM:
+        if (opts->use_runtime) {
+            fputs(runtime_source, fp);
+            fprintf(fp, "int main() {\n");
+            gen_block(ctx, ast, opts, node->a, 1, fp);
+            print_indent(1, fp);
+            fprintf(fp, "jpc_flush();\n");
+            print_indent(1, fp);
+            fprintf(fp, "return 0;\n");
+            fprintf(fp, "}\n");
+            return;
+        }
         fprintf(fp, "#include <stdio.h>\n");
+        // 整数の変数があるときだけ int64_t と PRId64 を使う
+        for (uint32_t v = 0; v < ast->int_vars_len; v++) {
+            if (ast->int_vars[v]) {
+                fprintf(fp, "#include <stdint.h>\n");
+                fprintf(fp, "#include <inttypes.h>\n");
+                break;
+            }
+        }
         fprintf(fp, "int main() {\n");
-        gen_block(node->next, 1, fp);
+        gen_block(ctx, ast, opts, node->a, 1, fp);
         print_indent(1, fp);
         fprintf(fp, "return 0;\n");
         fprintf(fp, "}\n");
@@ -42,7 +172,7 @@ void gen(Node *node, int depth, FILE *fp) {
 
     case ND_BLOCK:
         // スコープ管理は C 側で行われる
-        gen_block(node->next, depth, fp);
+        gen_block(ctx, ast, opts, node->a, depth, fp);
         return;
 
     // --- 制御構文 ---
@@ -55,18 +185,18 @@ void gen(Node *node, int depth, FILE *fp) {
             fprintf(fp, " else if (");
         }
 
-        gen(node->cond, 0, fp);
+        gen(ctx, ast, opts, node->a, 0, fp);
         fprintf(fp, ") {\n");
-        gen_block(node->then, depth + 1, fp);
+        gen_block(ctx, ast, opts, node->b, depth + 1, fp);
         print_indent(depth, fp);
         fprintf(fp, "}");
 
-        if (node->els) {
-            if (node->els->kind == ND_ELSEIF) {
-                gen(node->els, depth, fp);
+        if (node->c) {
+            if (ast->nodes[node->c].kind == ND_ELSEIF) {
+                gen(ctx, ast, opts, node->c, depth, fp);
             } else {
                 fprintf(fp, " else {\n");
-                gen_block(node->els, depth + 1, fp);
+                gen_block(ctx, ast, opts, node->c, depth + 1, fp);
                 print_indent(depth, fp);
                 fprintf(fp, "}\n");
             }
@@ -78,48 +208,85 @@ void gen(Node *node, int depth, FILE *fp) {
     case ND_LOOP:
         print_indent(depth, fp);
         fprintf(fp, "while (");
-        gen(node->cond, 0, fp);
+        gen(ctx, ast, opts, node->a, 0, fp);
         fprintf(fp, ") {\n");
-        gen_block(node->then, depth + 1, fp);
+        gen_block(ctx, ast, opts, node->b, depth + 1, fp);
         print_indent(depth, fp);
         fprintf(fp, "}\n");
         return;
 
     // --- 文 ---
     
-    case ND_DECLARE:
+    case ND_DECLARE: {
+        uint32_t var = ast->nodes[node->a].a;
+        bool as_int = ast_is_int_var(ast, var);
         print_indent(depth, fp);
-        fprintf(fp, "double jpc_var_%d = ", node->lhs->var_id);
-        gen(node->rhs, 0, fp);
+        fprintf(fp, "%s jpc_var_%u = ", as_int ? "int64_t" : "double", var);
+        gen_value(ctx, ast, opts, node->b, as_int, fp);
         fprintf(fp, ";\n");
         return;
+    }
 
-    case ND_ASSIGN:
+    case ND_ASSIGN: {
+        uint32_t var = ast->nodes[node->a].a;
         print_indent(depth, fp);
-        fprintf(fp, "jpc_var_%d = ", node->lhs->var_id);
-        gen(node->rhs, 0, fp);
+        fprintf(fp, "jpc_var_%u = ", var);
+        gen_value(ctx, ast, opts, node->b, ast_is_int_var(ast, var), fp);
         fprintf(fp, ";\n");
         return;
+    }
 
     case ND_INPUT:
+        if (opts->use_runtime) {
+            print_indent(depth, fp);
+            fprintf(fp, "jpc_before_input();\n");
+            print_indent(depth, fp);
+            fprintf(fp, "jpc_read_f(&jpc_var_%u);\n", ast->nodes[node->a].a);
+            return;
+        }
         print_indent(depth, fp);
-        fprintf(fp, "scanf(\"%%lf\", &jpc_var_%d);\n", node->lhs->var_id);
+        fprintf(fp, "scanf(\"%%lf\", &jpc_var_%u);\n", ast->nodes[node->a].a);
         return;
 
     case ND_OUTPUT:
+        if (opts->use_runtime) {
+            if (ast->nodes[node->a].kind == ND_STR_LIT) {
+                gen_runtime_output(ast, &ast->nodes[node->a], depth, fp);
+            } else if (ast->nodes[node->a].kind != ND_LITERAL) {
+                // 構文上は数値の定数しか来ないが、念のため printf に任せる (ためた出力を先に書き出す)
+                print_indent(depth, fp);
+                fprintf(fp, "jpc_flush();\n");
+                print_indent(depth, fp);
+                fprintf(fp, "printf(\"%%g\\n\", (double)");
+                gen(ctx, ast, opts, node->a, 0, fp);
+                fprintf(fp, ");\n");
+            } else {
+                // 出力する数値は定数なので、表示する文字列はここで決まる
+                char buf[64];
+                snprintf(buf, sizeof(buf), "%g", ast_num(&ast->nodes[node->a]));
+                print_indent(depth, fp);
+                fprintf(fp, "JPC_WRITE(\"%s\\n\");\n", buf);
+            }
+            return;
+        }
         print_indent(depth, fp);
-        if (node->lhs->kind == ND_STR_LIT) {
+        if (ast->nodes[node->a].kind == ND_STR_LIT) {
             // 文字列リテラル: Parserが生成したfmtとargsを使う
-            fprintf(fp, "printf(\"%s\"", node->lhs->strVal);
+            const ANode *str = &ast->nodes[node->a];
+            fprintf(fp, "printf(");
+            gen_format(ast, str, fp);
             // 埋め込まれた変数のIDリストを出力
-            for (int i = 0; i < node->lhs->argc; i++) {
-                fprintf(fp, ", jpc_var_%d", node->lhs->args[i]);
+            for (uint32_t i = 0; i < str->c; i++) {
+                fprintf(fp, ", jpc_var_%d", ast->ids[str->b + i]);
             }
             fprintf(fp, ");\n");
         } else {
             // 通常の数値出力
             fprintf(fp, "printf(\"%%g\\n\", ");
-            gen(node->lhs, 0, fp);
+            if (ast->nodes[node->a].kind == ND_VAR && ast_is_int_var(ast, ast->nodes[node->a].a)) {
+                fprintf(fp, "(double)");
+            }
+            gen(ctx, ast, opts, node->a, 0, fp);
             fprintf(fp, ");\n");
         }
         return;
@@ -129,7 +296,7 @@ void gen(Node *node, int depth, FILE *fp) {
     case ND_MUL:
     case ND_DIV:
         print_indent(depth, fp);
-        gen(node->lhs, 0, fp); 
+        gen(ctx, ast, opts, node->a, 0, fp); 
         switch (node->kind) {
             case ND_ADD: fprintf(fp, " += "); break;
             case ND_SUB: fprintf(fp, " -= "); break;
@@ -137,7 +304,7 @@ void gen(Node *node, int depth, FILE *fp) {
             case ND_DIV: fprintf(fp, " /= "); break;
             default: break;
         }
-        gen(node->rhs, 0, fp);
+        gen_value(ctx, ast, opts, node->b, ast_is_int_var(ast, ast->nodes[node->a].a), fp);
         fprintf(fp, ";\n");
         return;
 
@@ -149,9 +316,12 @@ void gen(Node *node, int depth, FILE *fp) {
     case ND_GT:
     case ND_GE:
     case ND_AND:
-    case ND_OR:
+    case ND_OR: {
+        // 整数の変数と整数の定数の比較は、定数も整数のまま書く
+        const ANode *l = &ast->nodes[node->a], *r = &ast->nodes[node->b];
+        bool as_int = (l->kind == ND_VAR && ast_is_int_var(ast, l->a)) || (r->kind == ND_VAR && ast_is_int_var(ast, r->a));
         fprintf(fp, "(");
-        gen(node->lhs, 0, fp);
+        gen_value(ctx, ast, opts, node->a, as_int, fp);
         switch (node->kind) {
             case ND_EQ:  fprintf(fp, " == "); break;
             case ND_NE:  fprintf(fp, " != "); break;
@@ -163,26 +333,42 @@ void gen(Node *node, int depth, FILE *fp) {
             case ND_OR:  fprintf(fp, " || "); break;
             default: break;
         }
-        gen(node->rhs, 0, fp);
+        gen_value(ctx, ast, opts, node->b, as_int, fp);
         fprintf(fp, ")");
         return;
+    }
 
     case ND_LITERAL:
-        fprintf(fp, "%f", node->val);
+        gen_number(ast_num(node), fp);
         return;
 
     case ND_VAR:
-        fprintf(fp, "jpc_var_%d", node->var_id);
+        fprintf(fp, "jpc_var_%u", node->a);
         return;
 
     default:
         // エラー報告は stderr に行う error() 関数を呼ぶ
-        error(ERR_CODEGEN, "Unknown Node Kind %d", node->kind);
+        error(ctx, ERR_CODEGEN, "Unknown Node Kind %d", node->kind);
     }
 }
 
 // --- エントリーポイント ---
-// jpc.c から呼び出される
-void codegen(Node *node, FILE *fp) {
-    gen(node, 0, fp);
-}
\ No newline at end of file
+
+static bool run_codegen(JpcContext *ctx, const Ast *ast, const CodegenOptions *opts, FILE *fp) {
+    jmp_buf env;
+    jmp_buf *prev = ctx->error_jmp;
+    ctx->error_jmp = &env;
+    if (setjmp(env) != 0) {
+        ctx->error_jmp = prev;
+        return false;
+    }
+    gen(ctx, ast, opts, ast->root, 0, fp);
+    ctx->error_jmp = prev;
+    return true;
+}
+
+// jpc.c から呼び出される。エラーの場合は ctx にエラーを記録して false を返す
+bool codegen(JpcContext *ctx, const Ast *ast, const CodegenOptions *opts, FILE *fp) {
+    CodegenOptions defaults = CODEGEN_DEFAULTS;
+    return run_codegen(ctx, ast, opts != NULL ? opts : &defaults, fp);
+}
@@ -2,9 +2,18 @@
 #ifndef CODEGEN_H
 #define CODEGEN_H
 
-#include "parser.h"
+#include <stdbool.h>
+#include "ast.h"
 
-// コード生成の実行
-void codegen(Node *node, FILE *fp);
+typedef struct {
+    // 出力をバッファにためて数値を自前で文字列にするランタイムを埋め込む
+    // (false なら printf/scanf を直接呼ぶ)
+    bool use_runtime;
+} CodegenOptions;
+
+#define CODEGEN_DEFAULTS ((CodegenOptions){ .use_runtime = true })
+
+// コード生成の実行 (opts が NULL なら既定の設定。エラーの場合は false)
+bool codegen(JpcContext *ctx, const Ast *ast, const CodegenOptions *opts, FILE *fp);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include <stdlib.h>
+#include "context.h"
+#include "error.h"
+
+#define INITIAL_ERROR_CAP 4
+
+// 空の文脈を作る (確保できなければ NULL)
+JpcContext *new_context(void) {
+    JpcContext *ctx = calloc(1, sizeof(JpcContext));
+    if (ctx == NULL) return NULL;
+    ctx->current_line = 1;
+    ctx->errors = malloc(sizeof(JpcError) * INITIAL_ERROR_CAP);
+    if (ctx->errors == NULL) {
+        free(ctx);
+        return NULL;
+    }
+    ctx->error_cap = INITIAL_ERROR_CAP;
+    return ctx;
+}
+
+// 文脈と、文脈が持つソース・トークン列・インターン済み文字列・AST を解放する
+void free_context(JpcContext *ctx) {
+    if (ctx == NULL) return;
+    closeLexer(ctx);
+    free(ctx->intern_table);
+    free(ctx->sym_table);
+    free(ctx->scopes);
+    arena_release(&ctx->strings);
+    arena_release(&ctx->arena);
+    free_ast(&ctx->ast);
+    free(ctx->errors);
+    free(ctx);
+}
+
+// 文脈のアリーナから 0 で初期化した領域を切り出す (確保できなければエラー)
+void *context_alloc(JpcContext *ctx, size_t size) {
+    void *p = arena_alloc(&ctx->arena, size);
+    if (p == NULL) error(ctx, ERR_SYSTEM, "メモリを確保できません");
+    return p;
+}
@@ -0,0 +1,77 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <setjmp.h>
+#include "lexer.h"
+#include "error.h"
+#include "arena.h"
+#include "ast.h"
+
+// --- コンパイラ文脈 ---
+// 1回のコンパイルに必要な可変状態 (字句解析・構文解析・エラー) をすべてここに持つ。
+// 文脈ごとに独立しているので、別々の文脈を使えば複数のコンパイルを別スレッドで同時に実行できる。
+
+typedef struct InternEntry InternEntry;
+typedef struct LVar LVar;
+typedef struct SymbolSlot SymbolSlot;
+typedef struct ScopeInfo ScopeInfo;
+
+// 記録されたエラー
+typedef struct {
+    ErrorType type;
+    int line;       // 行番号 (ERR_SYSTEM では 0)
+    int offset;     // トークン位置 (ソース先頭からのバイト数)
+    int len;        // トークン長
+    char message[512];
+} JpcError;
+
+struct JpcContext {
+    // ソースバッファ
+    const unsigned char *src_begin;
+    const unsigned char *src_end;
+    const unsigned char *src_cur;
+    size_t src_mapped_len; // mmap した場合の長さ (0 なら malloc)
+    bool src_owned;        // closeLexer で解放するか
+
+    // トークン列
+    int current_line;
+    Token current_token;
+    Token *token_list;     // ソース全体のトークン列 (末尾は TK_EOF)
+    int token_count;
+    int token_pos;         // 次に getNextToken が返すトークンの添字
+
+    // 文字列インターン (文字列本体は strings に置く)
+    InternEntry *intern_table;
+    int intern_cap;
+    int intern_used;
+    Arena strings;
+
+    // AST・変数など構文解析で作るもの (文脈の解放時にまとめて解放する)
+    Arena arena;
+    Ast ast;               // コード生成に渡すコンパクトな AST (build_ast で作る)
+
+    // 変数スコープ
+    LVar *locals;          // 宣言済み変数のリスト (新しい順)
+    int var_counter;
+    SymbolSlot *sym_table; // 名前 -> 束縛のハッシュ表
+    int sym_cap;
+    int sym_used;
+    ScopeInfo *scopes;     // スコープ番号ごとの親と閉じた印
+    int scope_count;
+    int scope_cap;
+    int current_scope;
+
+    // エラー
+    jmp_buf *error_jmp;    // error() の脱出先
+    JpcError *errors;      // 記録されたエラー (発生順)
+    int error_count;
+    int error_cap;
+};
+
+JpcContext *new_context(void);
+void free_context(JpcContext *ctx);
+void *context_alloc(JpcContext *ctx, size_t size);
+
+#endif
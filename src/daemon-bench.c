@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <spawn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "bench-util.h"
+
+extern char **environ;
+
+// 編集しては作り直す開発の流れを、jpc -o を毎回起動する場合と、jpc --daemon に jpc --client -o で頼む場合とで比べる。
+// どちらも実際に jpc のプロセスを起動して、起動から実行ファイルができるまでの時間を測る。
+// 変えていないソースの作り直し (どちらも実行ファイルのキャッシュを使う) と、保存してからの作り直し (どちらも gcc を動かす) を測る
+
+// 宣言・演算・条件分岐・出力を繰り返したソースを書く (version を変えると中身が変わる)
+static bool write_source(const char *path, int blocks, int version) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) return false;
+    fprintf(fp, "メイン｛\n");
+    fprintf(fp, "　　”合計”を「%d」で宣言する。\n", version);
+    for (int i = 0; i < blocks; i++) {
+        fprintf(fp, "　　”変数%d”を「%d」で宣言する。\n", i, i % 100);
+        fprintf(fp, "　　”変数%d”に「１．５」をたす。\n", i);
+        fprintf(fp, "　　ループ（”変数%d”が「５０」以上か　かつ　”合計”が「１０００」より小さいか）｛\n", i);
+        fprintf(fp, "　　　　”合計”に”変数%d”をたす。\n", i);
+        fprintf(fp, "　　｝\n");
+        fprintf(fp, "　　もし（”変数%d”が「１」と一緒か）｛\n", i);
+        fprintf(fp, "　　　　「値は”変数%d”、合計は”合計”です」と出力する。\n", i);
+        fprintf(fp, "　　｝\n");
+    }
+    fprintf(fp, "｝\n");
+    return fclose(fp) == 0;
+}
+
+// argv を起動する (標準エラー出力は err へ)。wait なら終わるまで待って成功したかを返す
+static bool spawn(char *const argv[], const char *err, bool wait, pid_t *pid_out) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 2, err, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    pid_t pid;
+    int rc = posix_spawn(&pid, argv[0], &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (rc != 0) return false;
+    if (pid_out != NULL) *pid_out = pid;
+    if (!wait) return true;
+    int status;
+    return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *jpc = argc > 1 ? argv[1] : "./jpc";
+    int runs = argc > 2 ? atoi(argv[2]) : 20;
+    int blocks = 200;
+
+    char dir[] = "/tmp/jpc-daemon-bench-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        fprintf(stderr, "Error: Cannot create temporary directory\n");
+        return 1;
+    }
+    // キャッシュとソケットは一時ディレクトリに置く (デーモンにも環境変数で伝わる)
+    char cache[4096 + 16], sock[4096 + 16], src[4096 + 16], exe[4096 + 16], log[4096 + 16], cmd[4096 + 16];
+    snprintf(cache, sizeof(cache), "%s/cache", dir);
+    snprintf(sock, sizeof(sock), "%s/daemon.sock", dir);
+    snprintf(src, sizeof(src), "%s/prog.jpc", dir);
+    snprintf(exe, sizeof(exe), "%s/prog", dir);
+    snprintf(log, sizeof(log), "%s/log", dir);
+    setenv("JPC_CACHE_DIR", cache, 1);
+    setenv("JPC_DAEMON_SOCKET", sock, 1);
+
+    char *daemon_argv[] = { (char *)jpc, "--daemon", NULL };
+    pid_t daemon_pid;
+    if (!write_source(src, blocks, 0) || !spawn(daemon_argv, log, false, &daemon_pid)) {
+        fprintf(stderr, "Error: Cannot start %s --daemon\n", jpc);
+        return 1;
+    }
+    struct stat st;
+    for (int i = 0; i < 500 && stat(sock, &st) != 0; i++) usleep(10000);
+
+    char *local_argv[] = { (char *)jpc, "-o", exe, src, NULL };
+    char *client_argv[] = { (char *)jpc, "--client", "-o", exe, src, NULL };
+    char *const *modes[2] = { local_argv, client_argv };
+    const char *names[2] = { "jpc -o          ", "jpc --client -o " };
+    double unchanged[2] = {0, 0}, edited[2] = {0, 0};
+    int version = 1;
+    bool ok = true;
+    for (int m = 0; m < 2 && ok; m++) {
+        // 1 回目でキャッシュとデーモンを温める
+        ok = spawn(modes[m], log, true, NULL);
+        for (int r = 0; r < runs && ok; r++) {
+            double start = bench_now();
+            ok = spawn(modes[m], log, true, NULL);
+            unchanged[m] += bench_now() - start;
+        }
+        for (int r = 0; r < runs && ok; r++) {
+            // 保存してから実行ファイルができるまで (デーモンは保存を inotify で知って作り直す)
+            double start = bench_now();
+            ok = write_source(src, blocks, version++) && spawn(modes[m], log, true, NULL);
+            edited[m] += bench_now() - start;
+        }
+    }
+    kill(daemon_pid, SIGTERM);
+    waitpid(daemon_pid, NULL, 0);
+    if (!ok) {
+        fprintf(stderr, "Error: compilation failed (see %s)\n", log);
+        return 1;
+    }
+
+    printf("=== Daemon Bench: %d blocks, %d runs each ===\n", blocks, runs);
+    for (int m = 0; m < 2; m++) {
+        printf("%s: unchanged %.2f ms, after edit %.2f ms\n", names[m], unchanged[m] / runs * 1e3, edited[m] / runs * 1e3);
+    }
+    printf("daemon speedup: unchanged %.2fx, after edit %.2fx\n", unchanged[0] / unchanged[1], edited[0] / edited[1]);
+
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    if (system(cmd) != 0) fprintf(stderr, "Error: Cannot remove %s\n", dir);
+    return 0;
+}
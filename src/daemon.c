@@ -0,0 +1,524 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "daemon.h"
+#include "build.h"
+#include "cache.h"
+#include "error.h"
+#include "context.h"
+#include "json.h"
+
+// 要求・応答の大きさの上限
+#define MESSAGE_MAX (1 << 20)
+// デーモンがクライアントの要求を読み終える (相手が送信側を閉じる) までと、応答を送るときの時間の上限。
+// デーモンは 1 つずつ要求を処理するので、止まったクライアントに待たされないようにする
+#define CLIENT_TIMEOUT_MS 5000
+
+// コンパイル済みのソース (ソースのパスと、生成するコードが変わるオプションの組ごとに 1 つ)
+typedef struct {
+    char *path;             // 絶対パス
+    DriverOptions opts;     // 最後の要求のオプション (build.cc_opt と build.march は複製を持つ)
+    char *code;             // 生成したコード (エラーなら NULL)
+    size_t len;
+    char *errors;           // エラーの表示 (成功なら NULL)
+    struct timespec mtime;  // 読み込んだときのソースの更新時刻と大きさ
+    off_t size;
+    bool stale;             // 読み込んでから変わった (まだ読み込んでいない)
+} Entry;
+
+// 見張っているディレクトリ (エディタは別のファイルに書いてから置き換えることがあるので、ファイルではなくディレクトリを見る)
+typedef struct {
+    int wd;
+    char *dir;
+} Watch;
+
+typedef struct {
+    int inotify_fd;
+    Entry *entries;
+    int nentries;
+    Watch *watches;
+    int nwatches;
+} Daemon;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_stop_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+bool daemon_socket_path(char *buf, size_t size) {
+    const char *env = getenv("JPC_DAEMON_SOCKET");
+    int n;
+    if (env != NULL && *env) {
+        n = snprintf(buf, size, "%s", env);
+    } else {
+        char root[4096];
+        if (!cache_dir(root, sizeof(root))) return false;
+        n = snprintf(buf, size, "%s/daemon.sock", root);
+    }
+    return n >= 0 && (size_t)n < size;
+}
+
+// --- ソケット ---
+
+// path のソケットのアドレスを作る (パスが長すぎれば false)
+static bool socket_address(struct sockaddr_un *addr, const char *path) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) return false;
+    strcpy(addr->sun_path, path);
+    return true;
+}
+
+static int connect_socket(const char *path) {
+    struct sockaddr_un addr;
+    if (!socket_address(&addr, path)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool send_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+// 相手が送信側を閉じるまで読む (NUL 終端して返す。失敗したら NULL)。
+// timeout_ms が負でなければ、読み終えるまでの時間をその長さに限り、過ぎたら errno を ETIMEDOUT にして NULL を返す
+static char *recv_all(int fd, size_t *len, int timeout_ms) {
+    size_t cap = 4096;
+    char *buf = malloc(cap);
+    double deadline = now_ms() + timeout_ms;
+    *len = 0;
+    while (buf != NULL) {
+        if (timeout_ms >= 0) {
+            // 少しずつ送ってくる相手にも待たされないよう、1 回の recv ではなく全体の時間で区切る
+            int left = (int)(deadline - now_ms());
+            struct pollfd pfd = { fd, POLLIN, 0 };
+            int r = left > 0 ? poll(&pfd, 1, left) : 0;
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) {
+                if (r == 0) errno = ETIMEDOUT;
+                break;
+            }
+        }
+        if (*len + 1 >= cap) {
+            char *grown = cap < MESSAGE_MAX ? realloc(buf, cap * 2) : NULL;
+            if (grown == NULL) break;
+            buf = grown;
+            cap *= 2;
+        }
+        ssize_t n = recv(fd, buf + *len, cap - *len - 1, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) break;
+        if (n == 0) {
+            buf[*len] = '\0';
+            return buf;
+        }
+        *len += n;
+    }
+    free(buf);
+    return NULL;
+}
+
+static bool json_get_bool(const JsonValue *obj, const char *key, bool def) {
+    JsonValue *v = json_get(obj, key);
+    return v != NULL && v->type == JSON_BOOL ? v->boolean : def;
+}
+
+// 記録されたエラーの表示を文字列にする
+static char *format_errors(JpcContext *ctx) {
+    char *text = NULL;
+    size_t len = 0;
+    FILE *fp = open_memstream(&text, &len);
+    if (fp == NULL) return strdup("メモリを確保できません\n");
+    if (ctx != NULL) print_errors(ctx, fp);
+    else fprintf(fp, "メモリを確保できません\n");
+    fclose(fp);
+    return text;
+}
+
+// --- コンパイル済みのソース ---
+
+// 生成するコードが同じになるオプションか (gcc のオプションは実行ファイルのキャッシュのキーに入るので見ない)
+static bool same_code_options(const DriverOptions *a, const DriverOptions *b) {
+    return a->opt_level == b->opt_level && a->use_cache == b->use_cache &&
+           a->no_loop_opt == b->no_loop_opt && a->codegen.use_runtime == b->codegen.use_runtime &&
+           a->build.assembly == b->build.assembly;
+}
+
+static void free_entry(Entry *e) {
+    free(e->path);
+    free(e->code);
+    free(e->errors);
+    free((char *)e->opts.build.cc_opt);
+    free((char *)e->opts.build.march);
+}
+
+// ソースを読み込んでコードを生成し直す
+static void load_entry(Entry *e) {
+    struct stat st;
+    if (stat(e->path, &st) == 0) {
+        e->mtime = st.st_mtim;
+        e->size = st.st_size;
+    } else {
+        e->size = -1;
+    }
+    free(e->code);
+    free(e->errors);
+    e->code = NULL;
+    e->len = 0;
+    e->errors = NULL;
+    e->stale = false;
+
+    JpcContext *ctx = new_context();
+    const Ast *ast = ctx != NULL ? driver_load(ctx, e->path, &e->opts, NULL) : NULL;
+    if (ast == NULL || !driver_generate(ctx, ast, &e->opts, &e->code, &e->len)) e->errors = format_errors(ctx);
+    if (ctx != NULL) free_context(ctx);
+}
+
+// 読み込んでからソースが変わったか (inotify のイベントを取りこぼしても古いコードを使わないように、要求のたびに確かめる)
+static bool source_changed(const Entry *e) {
+    struct stat st;
+    if (stat(e->path, &st) != 0) return true;
+    return st.st_size != e->size || st.st_mtim.tv_sec != e->mtime.tv_sec || st.st_mtim.tv_nsec != e->mtime.tv_nsec;
+}
+
+// 最後の要求と同じ gcc のオプションで実行ファイルを作り、実行ファイルのキャッシュに入れておく
+static void prebuild_entry(const Entry *e) {
+    const BuildOptions *build = &e->opts.build;
+    char root[4096], exe[4096 + 32];
+    if (e->code == NULL || !build->use_cache || build->pgo_input != NULL || !cache_dir(root, sizeof(root))) return;
+    snprintf(exe, sizeof(exe), "%s/daemon-XXXXXX", root);
+    int fd = mkstemp(exe);
+    if (fd < 0) return;
+    close(fd);
+    JpcContext *ctx = new_context();
+    if (ctx != NULL) {
+        build_executable(ctx, build, e->code, e->len, exe, NULL);
+        free_context(ctx);
+    }
+    unlink(exe);
+}
+
+// ソースのディレクトリを見張る (同じディレクトリなら inotify は同じ番号を返す)
+static void watch_source(Daemon *d, const char *path) {
+    const char *slash = strrchr(path, '/');
+    char *dir = strndup(path, slash > path ? (size_t)(slash - path) : 1);
+    if (dir == NULL) return;
+    int wd = inotify_add_watch(d->inotify_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE);
+    for (int i = 0; wd >= 0 && i < d->nwatches; i++) {
+        if (d->watches[i].wd == wd) wd = -1;
+    }
+    Watch *grown = wd >= 0 ? realloc(d->watches, sizeof(Watch) * (d->nwatches + 1)) : NULL;
+    if (grown == NULL) {
+        free(dir);
+        return;
+    }
+    d->watches = grown;
+    d->watches[d->nwatches++] = (Watch){ wd, dir };
+}
+
+// path と opts のコンパイル済みのソースを探し、なければ作る (失敗したら -1)
+static int find_entry(Daemon *d, const char *path, const DriverOptions *opts) {
+    for (int i = 0; i < d->nentries; i++) {
+        if (strcmp(d->entries[i].path, path) == 0 && same_code_options(&d->entries[i].opts, opts)) return i;
+    }
+    Entry *grown = realloc(d->entries, sizeof(Entry) * (d->nentries + 1));
+    if (grown == NULL) return -1;
+    d->entries = grown;
+    Entry *e = &d->entries[d->nentries];
+    memset(e, 0, sizeof(*e));
+    e->path = strdup(path);
+    if (e->path == NULL) return -1;
+    e->opts = *opts;
+    e->opts.build.cc_opt = NULL;
+    e->opts.build.march = NULL;
+    e->stale = true;
+    watch_source(d, path);
+    return d->nentries++;
+}
+
+// 溜まっている inotify のイベントを読み、変わったソースだけを作り直す
+static void handle_events(Daemon *d) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t n;
+    bool changed = false;
+    while ((n = read(d->inotify_fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + n; ) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW) {
+                // 取りこぼしたので、すべて変わったものとする
+                for (int i = 0; i < d->nentries; i++) d->entries[i].stale = true;
+                changed = true;
+                continue;
+            }
+            if (ev->len == 0) continue;
+            const char *dir = NULL;
+            for (int i = 0; i < d->nwatches && dir == NULL; i++) {
+                if (d->watches[i].wd == ev->wd) dir = d->watches[i].dir;
+            }
+            if (dir == NULL) continue;
+            size_t dir_len = strlen(dir);
+            for (int i = 0; i < d->nentries; i++) {
+                const char *path = d->entries[i].path;
+                if (strncmp(path, dir, dir_len) == 0 && path[dir_len] == '/' && strcmp(path + dir_len + 1, ev->name) == 0) {
+                    d->entries[i].stale = true;
+                    changed = true;
+                }
+            }
+        }
+    }
+    if (!changed) return;
+    for (int i = 0; i < d->nentries; i++) {
+        Entry *e = &d->entries[i];
+        if (!e->stale) continue;
+        double start = now_ms();
+        load_entry(e);
+        prebuild_entry(e);
+        fprintf(stderr, "変更: %s を%s (%.1f ms)\n", e->path, e->errors ? "解析しましたが、エラーがあります" : "作り直しました", now_ms() - start);
+    }
+}
+
+// --- 要求 ---
+
+static void respond(int fd, bool ok, bool cache_hit, const char *errors) {
+    char *text = NULL;
+    size_t len = 0;
+    FILE *fp = open_memstream(&text, &len);
+    if (fp == NULL) return;
+    fprintf(fp, "{\"ok\":%s,\"cache_hit\":%s", ok ? "true" : "false", cache_hit ? "true" : "false");
+    if (errors != NULL) {
+        fprintf(fp, ",\"errors\":");
+        json_write_string(fp, errors, (int)strlen(errors));
+    }
+    fprintf(fp, "}\n");
+    fclose(fp);
+    send_all(fd, text, len);
+    free(text);
+}
+
+static void handle_client(Daemon *d, int fd) {
+    double start = now_ms();
+    size_t len;
+    char *text = recv_all(fd, &len, CLIENT_TIMEOUT_MS);
+    if (text == NULL && errno == ETIMEDOUT) {
+        fprintf(stderr, "クライアントが %d ms のうちに要求を送り終えなかったので、接続を閉じます\n", CLIENT_TIMEOUT_MS);
+        return;
+    }
+    JsonValue *req = text != NULL ? json_parse(text, len) : NULL;
+    free(text);
+    const char *input = json_get_string(req, "input");
+    const char *output = json_get_string(req, "output");
+    const char *cc_opt = json_get_string(req, "cc_opt");
+    const char *march = json_get_string(req, "march");
+    if (input == NULL || output == NULL || input[0] != '/' || output[0] != '/' ||
+        (cc_opt != NULL && !build_valid_cc_opt(cc_opt)) || (march != NULL && !build_valid_march(march))) {
+        respond(fd, false, false, "デーモンへの要求が正しくありません\n");
+        json_free(req);
+        return;
+    }
+    DriverOptions opts = {
+        .opt_level = (int)json_get_number(req, "opt_level", OPT_LEVEL_DEFAULT),
+        .use_cache = json_get_bool(req, "cache", true),
+        .codegen = { .use_runtime = !json_get_bool(req, "stdio", false) },
+        .build = BUILD_DEFAULTS,
+    };
+    if (opts.opt_level < 0) opts.opt_level = 0;
+    if (opts.opt_level > OPT_LEVEL_MAX) opts.opt_level = OPT_LEVEL_MAX;
+    opts.build.assembly = json_get_bool(req, "asm", false);
+    opts.build.use_cache = opts.use_cache;
+
+    // 要求より前の保存を見落とさないように、先にイベントを片付ける
+    handle_events(d);
+    int i = find_entry(d, input, &opts);
+    if (i < 0) {
+        respond(fd, false, false, "メモリを確保できません\n");
+        json_free(req);
+        return;
+    }
+    Entry *e = &d->entries[i];
+    // --no-cache ではメモリ上のコードも使わない
+    bool reload = e->stale || !opts.use_cache || source_changed(e);
+    if (reload) load_entry(e);
+    free((char *)e->opts.build.cc_opt);
+    free((char *)e->opts.build.march);
+    e->opts.build.cc_opt = cc_opt != NULL ? strdup(cc_opt) : NULL;
+    e->opts.build.march = march != NULL ? strdup(march) : NULL;
+
+    bool ok = false, cache_hit = false;
+    char *errors = NULL;
+    if (e->errors == NULL) {
+        JpcContext *ctx = new_context();
+        ok = ctx != NULL && build_executable(ctx, &e->opts.build, e->code, e->len, output, &cache_hit);
+        if (!ok) errors = format_errors(ctx);
+        if (ctx != NULL) free_context(ctx);
+    }
+    respond(fd, ok, cache_hit, ok ? NULL : e->errors ? e->errors : errors);
+    fprintf(stderr, "%s -> %s: %.1f ms (%s, %s)\n", input, output, now_ms() - start,
+            reload ? "解析し直しました" : "解析済み", !ok ? "失敗" : cache_hit ? "キャッシュ" : "gcc");
+    free(errors);
+    json_free(req);
+}
+
+int run_daemon(const char *socket_path) {
+    struct sockaddr_un addr;
+    if (!socket_address(&addr, socket_path)) {
+        fprintf(stderr, "ソケットのパスが長すぎます: %s\n", socket_path);
+        return 1;
+    }
+    // つながるなら別のデーモンが動いている。つながらなければ前のデーモンが残したソケットなので消す
+    int other = connect_socket(socket_path);
+    if (other >= 0) {
+        close(other);
+        fprintf(stderr, "デーモンはすでに動いています: %s\n", socket_path);
+        return 1;
+    }
+    unlink(socket_path);
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        chmod(socket_path, 0600) != 0 || listen(listen_fd, 16) != 0) {
+        fprintf(stderr, "ソケットを作成できません: %s (%s)\n", socket_path, strerror(errno));
+        if (listen_fd >= 0) close(listen_fd);
+        return 1;
+    }
+    Daemon d = { .inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC) };
+    if (d.inotify_fd < 0) {
+        fprintf(stderr, "inotify を使えません (%s)\n", strerror(errno));
+        close(listen_fd);
+        unlink(socket_path);
+        return 1;
+    }
+
+    // SA_RESTART を付けず、poll から戻って終わる
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    fprintf(stderr, "デーモンを起動しました: %s\n", socket_path);
+
+    while (!stop_requested) {
+        struct pollfd fds[2] = { { listen_fd, POLLIN, 0 }, { d.inotify_fd, POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "poll に失敗しました (%s)\n", strerror(errno));
+            break;
+        }
+        if (fds[1].revents & POLLIN) handle_events(&d);
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd < 0) continue;
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            // 応答を読まないクライアントにも止められないよう、送信にも時間の上限を付ける
+            struct timeval tv = { CLIENT_TIMEOUT_MS / 1000, CLIENT_TIMEOUT_MS % 1000 * 1000 };
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+            handle_client(&d, fd);
+            close(fd);
+        }
+    }
+
+    close(listen_fd);
+    unlink(socket_path);
+    close(d.inotify_fd);
+    for (int i = 0; i < d.nentries; i++) free_entry(&d.entries[i]);
+    for (int i = 0; i < d.nwatches; i++) free(d.watches[i].dir);
+    free(d.entries);
+    free(d.watches);
+    fprintf(stderr, "デーモンを終了しました\n");
+    return 0;
+}
+
+// --- クライアント ---
+
+// path を絶対パスにする (入力はシンボリックリンクも解決して、デーモンが見張るディレクトリと合わせる)
+static char *absolute_path(const char *path, bool resolve) {
+    char *real = resolve ? realpath(path, NULL) : NULL;
+    if (real != NULL || path[0] == '/') return real != NULL ? real : strdup(path);
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) == NULL) return NULL;
+    size_t size = strlen(cwd) + strlen(path) + 2;
+    char *abs = malloc(size);
+    if (abs != NULL) snprintf(abs, size, "%s/%s", cwd, path);
+    return abs;
+}
+
+DaemonResult daemon_compile(const char *socket_path, const char *input, const char *output,
+                            const DriverOptions *opts, bool *cache_hit) {
+    int fd = connect_socket(socket_path);
+    if (fd < 0) return DAEMON_UNAVAILABLE;
+    char *abs_input = absolute_path(input, true);
+    char *abs_output = absolute_path(output, false);
+    char *req = NULL;
+    size_t req_len = 0;
+    FILE *fp = abs_input != NULL && abs_output != NULL ? open_memstream(&req, &req_len) : NULL;
+    if (fp != NULL) {
+        fprintf(fp, "{\"input\":");
+        json_write_string(fp, abs_input, (int)strlen(abs_input));
+        fprintf(fp, ",\"output\":");
+        json_write_string(fp, abs_output, (int)strlen(abs_output));
+        fprintf(fp, ",\"opt_level\":%d,\"stdio\":%s,\"asm\":%s,\"cache\":%s", opts->opt_level,
+                opts->codegen.use_runtime ? "false" : "true", opts->build.assembly ? "true" : "false",
+                opts->use_cache ? "true" : "false");
+        if (opts->build.cc_opt != NULL) {
+            fprintf(fp, ",\"cc_opt\":");
+            json_write_string(fp, opts->build.cc_opt, (int)strlen(opts->build.cc_opt));
+        }
+        if (opts->build.march != NULL) {
+            fprintf(fp, ",\"march\":");
+            json_write_string(fp, opts->build.march, (int)strlen(opts->build.march));
+        }
+        fprintf(fp, "}\n");
+        fclose(fp);
+    }
+    free(abs_input);
+    free(abs_output);
+
+    // 応答がなければ (途中でデーモンが終わったなど) 接続できなかったのと同じに扱う
+    DaemonResult result = DAEMON_UNAVAILABLE;
+    size_t len;
+    char *text = req != NULL && send_all(fd, req, req_len) && shutdown(fd, SHUT_WR) == 0 ? recv_all(fd, &len, -1) : NULL;
+    JsonValue *res = text != NULL ? json_parse(text, len) : NULL;
+    if (res != NULL && json_get(res, "ok") != NULL) {
+        result = json_get_bool(res, "ok", false) ? DAEMON_OK : DAEMON_FAILED;
+        if (cache_hit != NULL) *cache_hit = json_get_bool(res, "cache_hit", false);
+        const char *errors = json_get_string(res, "errors");
+        if (result == DAEMON_FAILED && errors != NULL) fputs(errors, stderr);
+    }
+    json_free(res);
+    free(text);
+    free(req);
+    close(fd);
+    return result;
+}
@@ -0,0 +1,34 @@
+// daemon.h
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "driver.h"
+
+// --- コンパイルデーモン (jpc --daemon) ---
+// Unix ソケットで jpc --client -o の要求を受け、実行ファイルを作る。
+// 一度コンパイルしたソースは生成したコードをメモリに残し、inotify でソースのディレクトリを見張って、
+// 変わったものだけを解析し直す (変わったときはすぐに作り直して、実行ファイルのキャッシュを温めておく)。
+// 変わっていないソースの要求では、プロセスの起動・読み込み・解析・コード生成・gcc のバージョンの確認を省き、
+// キャッシュの実行ファイルをコピー (できれば reflink) するだけで済む。
+// 要求と応答は 1 つの JSON オブジェクトで、書き終えたら送信側を閉じる
+
+typedef enum {
+    DAEMON_OK,          // 実行ファイルを作った
+    DAEMON_FAILED,      // コンパイルエラーなど (エラーの表示は標準エラー出力に書いた)
+    DAEMON_UNAVAILABLE  // デーモンに接続できない
+} DaemonResult;
+
+// ソケットのパス ($JPC_DAEMON_SOCKET、なければキャッシュディレクトリの daemon.sock)。作れなければ false
+bool daemon_socket_path(char *buf, size_t size);
+
+// デーモンとして動く。SIGINT か SIGTERM で終わり、終了コードを返す
+int run_daemon(const char *socket_path);
+
+// input を output の実行ファイルにするようデーモンに頼む。
+// cache_hit が NULL でなければ、キャッシュの実行ファイルを使ったかを書き込む
+DaemonResult daemon_compile(const char *socket_path, const char *input, const char *output,
+                            const DriverOptions *opts, bool *cache_hit);
+
+#endif
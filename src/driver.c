@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "driver.h"
+#include "lexer.h"
+#include "parser.h"
+#include "asmgen.h"
+#include "cache.h"
+#include "error.h"
+#include "context.h"
+
+// 1 つのファイルのコンパイル
+typedef struct {
+    const char *input;
+    char *output;
+    double front_time;      // 読み込みから生成まで
+    double build_time;      // gcc (またはキャッシュ)
+    bool ok;
+    bool cache_hit;
+} Job;
+
+typedef struct {
+    const DriverOptions *opts;
+    Job *jobs;
+    int count;
+    int next;               // 次に取るジョブ
+    int done;               // 終わったジョブの数 (表示用)
+    pthread_mutex_t lock;   // next・done と標準エラー出力を守る
+} Pool;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// --- 1 つのファイル ---
+
+// fp のソースから最適化前の AST を作る
+static const Ast *load_ast(JpcContext *ctx, FILE *fp, bool use_cache) {
+    if (!loadLexerSource(ctx, fp)) return NULL;
+    char cache_root[4096];
+    bool has_cache = use_cache && cache_dir(cache_root, sizeof(cache_root));
+    uint64_t key = has_cache ? cache_key(ctx->src_begin, ctx->src_end - ctx->src_begin) : 0;
+    const Ast *ast = has_cache ? cache_load_ast(ctx, cache_root, key) : NULL;
+    if (ast == NULL) {
+        if (!tokenizeSource(ctx)) return NULL;
+        getNextToken(ctx);
+        Node *root = parse_program(ctx);
+        if (root == NULL) return NULL;
+
+        // コンパクトな AST に変換し、構文解析で作った木は解放する
+        ast = build_ast(ctx, root);
+        if (ast == NULL) return NULL;
+        reset_scope(ctx);
+        arena_release(&ctx->arena);
+        if (has_cache) cache_store_ast(ast, cache_root, key);
+    }
+    closeLexer(ctx);
+    return ast;
+}
+
+const Ast *driver_load(JpcContext *ctx, const char *path, const DriverOptions *opts, OptStats *stats) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        record_error(ctx, ERR_SYSTEM, "ファイルを開けません: %s", path);
+        return NULL;
+    }
+    const Ast *ast = load_ast(ctx, fp, opts->use_cache);
+    fclose(fp);
+    if (ast == NULL) return NULL;
+
+    // キャッシュには最適化前の AST を置き、最適化は毎回行う
+    if (!optimize_ast(ctx, &ctx->ast, opts->opt_level, !opts->no_loop_opt, stats)) return NULL;
+    return ast;
+}
+
+bool driver_generate(JpcContext *ctx, const Ast *ast, const DriverOptions *opts, char **code, size_t *len) {
+    *code = NULL;
+    *len = 0;
+    FILE *fp = open_memstream(code, len);
+    if (fp == NULL) {
+        record_error(ctx, ERR_SYSTEM, "メモリを確保できません");
+        return false;
+    }
+    bool ok = opts->build.assembly ? asmgen(ctx, ast, fp) : codegen(ctx, ast, &opts->codegen, fp);
+    fclose(fp);
+    if (!ok) {
+        free(*code);
+        *code = NULL;
+    }
+    return ok;
+}
+
+// --- マニフェスト ---
+
+bool driver_read_manifest(JpcContext *ctx, const char *path, char ***inputs, int *count) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        record_error(ctx, ERR_SYSTEM, "ファイルを開けません: %s", path);
+        return false;
+    }
+    const char *slash = strrchr(path, '/');
+    int dir_len = slash ? (int)(slash - path + 1) : 0;
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t n;
+    bool ok = true;
+    while ((n = getline(&line, &cap, fp)) != -1) {
+        while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r' || line[n - 1] == ' ' || line[n - 1] == '\t')) line[--n] = '\0';
+        const char *name = line + strspn(line, " \t");
+        if (*name == '\0' || *name == '#') continue;
+        char **grown = realloc(*inputs, sizeof(char *) * (*count + 1));
+        size_t size = (*name == '/' ? 0 : dir_len) + strlen(name) + 1;
+        char *entry = malloc(size);
+        if (grown != NULL) *inputs = grown;
+        if (grown == NULL || entry == NULL) {
+            free(entry);
+            record_error(ctx, ERR_SYSTEM, "メモリを確保できません");
+            ok = false;
+            break;
+        }
+        snprintf(entry, size, "%.*s%s", *name == '/' ? 0 : dir_len, path, name);
+        (*inputs)[(*count)++] = entry;
+    }
+    free(line);
+    fclose(fp);
+    return ok;
+}
+
+// --- 並列コンパイル ---
+
+// 出力先 out_dir/<ソースのファイル名から .jpc を除いたもの> を決める。
+// 別のディレクトリの同じ名前のソースがあっても上書きしあわないように、2 つ目からは -2, -3, ... を付ける
+static bool assign_outputs(Job *jobs, int count, const char *out_dir) {
+    for (int i = 0; i < count; i++) {
+        const char *slash = strrchr(jobs[i].input, '/');
+        const char *base = slash ? slash + 1 : jobs[i].input;
+        int base_len = (int)strlen(base);
+        if (base_len > 4 && strcmp(base + base_len - 4, ".jpc") == 0) base_len -= 4;
+        size_t size = strlen(out_dir) + base_len + 16;
+        char *out = malloc(size);
+        if (out == NULL) return false;
+        snprintf(out, size, "%s/%.*s", out_dir, base_len, base);
+        for (int n = 2; ; n++) {
+            bool taken = false;
+            for (int j = 0; j < i && !taken; j++) taken = strcmp(jobs[j].output, out) == 0;
+            if (!taken) break;
+            snprintf(out, size, "%s/%.*s-%d", out_dir, base_len, base, n);
+        }
+        jobs[i].output = out;
+    }
+    return true;
+}
+
+static void compile_job(Pool *pool, Job *job) {
+    JpcContext *ctx = new_context();
+    char *code = NULL;
+    size_t len = 0;
+    double start = now_sec();
+    job->ok = ctx != NULL;
+    if (job->ok) {
+        const Ast *ast = driver_load(ctx, job->input, pool->opts, NULL);
+        job->ok = ast != NULL && driver_generate(ctx, ast, pool->opts, &code, &len);
+    }
+    double mid = now_sec();
+    if (job->ok) job->ok = build_executable(ctx, &pool->opts->build, code, len, job->output, &job->cache_hit);
+    double end = now_sec();
+    free(code);
+    job->front_time = mid - start;
+    job->build_time = end - mid;
+
+    // 終わった順に表示する (エラーの表示が他のファイルと混ざらないようにロックの中で書く)
+    pthread_mutex_lock(&pool->lock);
+    int done = ++pool->done;
+    if (job->ok) {
+        fprintf(stderr, "[%d/%d] %s -> %s: %.1f ms (解析と生成 %.1f ms, %s %.1f ms)\n",
+                done, pool->count, job->input, job->output, (end - start) * 1e3, job->front_time * 1e3,
+                job->cache_hit ? "キャッシュ" : "gcc", job->build_time * 1e3);
+    } else {
+        if (ctx != NULL) print_errors(ctx, stderr);
+        else fprintf(stderr, "メモリを確保できません\n");
+        fprintf(stderr, "[%d/%d] %s: 失敗しました\n", done, pool->count, job->input);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (ctx != NULL) free_context(ctx);
+}
+
+static void *worker_main(void *arg) {
+    Pool *pool = arg;
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        int i = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        if (i >= pool->count) return NULL;
+        compile_job(pool, &pool->jobs[i]);
+    }
+}
+
+bool driver_compile_all(const DriverOptions *opts, char *const inputs[], int count, const char *out_dir, int jobs) {
+    if (mkdir(out_dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "出力先のディレクトリを作成できません: %s\n", out_dir);
+        return false;
+    }
+    Pool pool = { .opts = opts, .count = count };
+    pool.jobs = calloc(count > 0 ? count : 1, sizeof(Job));
+    if (pool.jobs == NULL) {
+        fprintf(stderr, "メモリを確保できません\n");
+        return false;
+    }
+    for (int i = 0; i < count; i++) pool.jobs[i].input = inputs[i];
+    bool ok = assign_outputs(pool.jobs, count, out_dir);
+    if (!ok) fprintf(stderr, "メモリを確保できません\n");
+
+    // gcc を同時に動かすのもこのスレッドなので、スレッドの数がそのまま gcc の同時実行数になる
+    if (jobs <= 0) jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs > count) jobs = count;
+    if (jobs < 1) jobs = 1;
+    pthread_t *threads = ok ? malloc(sizeof(pthread_t) * jobs) : NULL;
+    double start = now_sec();
+    int started = 0;
+    if (threads != NULL) {
+        pthread_mutex_init(&pool.lock, NULL);
+        while (started < jobs && pthread_create(&threads[started], NULL, worker_main, &pool) == 0) started++;
+        // スレッドを 1 つも作れなければ、このスレッドでコンパイルする
+        if (started == 0) worker_main(&pool);
+        for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+        pthread_mutex_destroy(&pool.lock);
+    }
+    double wall = now_sec() - start;
+
+    if (ok && threads != NULL) {
+        int failed = 0, hits = 0;
+        double sum = 0;
+        for (int i = 0; i < count; i++) {
+            if (!pool.jobs[i].ok) failed++;
+            if (pool.jobs[i].cache_hit) hits++;
+            sum += pool.jobs[i].front_time + pool.jobs[i].build_time;
+        }
+        fprintf(stderr, "%d 個のファイルをコンパイルしました (失敗 %d 個, キャッシュ %d 個)。%d スレッドで %.1f ms (ファイルごとの時間の合計 %.1f ms)\n",
+                count, failed, hits, started > 0 ? started : 1, wall * 1e3, sum * 1e3);
+        ok = failed == 0;
+    } else if (ok) {
+        fprintf(stderr, "メモリを確保できません\n");
+        ok = false;
+    }
+    for (int i = 0; i < count; i++) free(pool.jobs[i].output);
+    free(pool.jobs);
+    free(threads);
+    return ok;
+}
@@ -0,0 +1,40 @@
+// driver.h
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "ast.h"
+#include "build.h"
+#include "codegen.h"
+#include "optimize.h"
+
+// --- コンパイルの流れ ---
+// ソースファイルの読み込みから、C (またはアセンブリ) の生成、実行ファイルの作成まで。
+// jpc の main と、複数のファイルをスレッドで並べてコンパイルする jpc -d が使う
+
+typedef struct {
+    int opt_level;
+    bool use_cache;         // AST キャッシュを使う (--no-cache でなければ true)
+    CodegenOptions codegen;
+    BuildOptions build;     // build.assembly なら C の代わりにアセンブリを生成する (--asm)
+    bool no_loop_opt;       // ループの最適化を行わない (loop-bench がその効果だけを測るため)
+} DriverOptions;
+
+// path を読んで構文解析し、最適化した AST を返す (同じ内容をコンパイル済みなら、キャッシュした AST を使う)。
+// エラーの場合は ctx にエラーを記録して NULL を返す
+const Ast *driver_load(JpcContext *ctx, const char *path, const DriverOptions *opts, OptStats *stats);
+
+// ast から C (--asm ではアセンブリ) をメモリ上に生成する。*code は呼び出し側で free する
+bool driver_generate(JpcContext *ctx, const Ast *ast, const DriverOptions *opts, char **code, size_t *len);
+
+// マニフェスト (1 行に 1 つのソースファイル。空行と # で始まる行は読み飛ばす) を読み、inputs に追加する。
+// 相対パスはマニフェストのあるディレクトリから見たものとする。失敗したら ctx にエラーを記録して false を返す
+bool driver_read_manifest(JpcContext *ctx, const char *path, char ***inputs, int *count);
+
+// inputs を out_dir の下の実行ファイルに並列にコンパイルし、ファイルごとの時間と全体の時間を標準エラー出力に書く。
+// 実行ファイル名はソースのファイル名から .jpc を除いたもので、同じ名前になるものには -2, -3, ... を付ける。
+// jobs が 0 ならコアの数だけスレッドを使う。すべて成功したら true
+bool driver_compile_all(const DriverOptions *opts, char *const inputs[], int count, const char *out_dir, int jobs);
+
+#endif
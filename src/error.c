@@ -1,14 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <setjmp.h>
 #include "error.h"
-#include "lexer.h" // current_token を使うため
-
-// 行番号の初期値
-int current_line = 1;
+#include "context.h" // current_token を使うため
 
 // エラー種別ごとのラベルを取得
-static const char *get_error_label(ErrorType type) {
+const char *get_error_label(ErrorType type) {
     switch (type) {
         case ERR_LEXER:    return "字句解析エラー";
         case ERR_SYNTAX:   return "構文解析エラー";
@@ -19,24 +17,74 @@ static const char *get_error_label(ErrorType type) {
     }
 }
 
-void error(ErrorType type, const char *fmt, ...) {
+static void print_error(const JpcError *e, FILE *fp) {
+    fprintf(fp, "\033[1;31m[%s]\033[0m ", get_error_label(e->type)); // 赤字ボールド
+
+    // ERR_SYSTEM の場合は行番号を表示しない
+    if (e->type != ERR_SYSTEM) {
+        fprintf(fp, "%d行目: ", e->line);
+    }
+    fprintf(fp, "%s\n", e->message);
+}
+
+// tok が NULL なら current_token の位置に記録する
+static void vrecord_error(JpcContext *ctx, const Token *tok, ErrorType type, const char *fmt, va_list ap) {
+    // 記録領域は new_context で確保済み。拡張できなければ最後のエラーを上書きする
+    if (ctx->error_count == ctx->error_cap) {
+        JpcError *errors = realloc(ctx->errors, sizeof(JpcError) * ctx->error_cap * 2);
+        if (errors != NULL) {
+            ctx->errors = errors;
+            ctx->error_cap *= 2;
+        } else {
+            ctx->error_count--;
+        }
+    }
+    JpcError *e = &ctx->errors[ctx->error_count++];
+
+    vsnprintf(e->message, sizeof(e->message), fmt, ap);
+    e->type = type;
+    // 構造体から行番号を取得
+    if (tok == NULL) tok = &ctx->current_token;
+    e->line = type == ERR_SYSTEM ? 0 : tok->line;
+    e->offset = tok->offset;
+    e->len = tok->len;
+}
+
+void record_error(JpcContext *ctx, ErrorType type, const char *fmt, ...) {
     va_list ap;
     va_start(ap, fmt);
+    vrecord_error(ctx, NULL, type, fmt, ap);
+    va_end(ap);
+}
 
-    const char *label = get_error_label(type);
-
-    // 標準エラー出力へ
-    fprintf(stderr, "\033[1;31m[%s]\033[0m ", label); // 赤字ボールド
+// 記録したエラーで ctx->error_jmp へ脱出する
+static void raise_error(JpcContext *ctx) __attribute__((noreturn));
+static void raise_error(JpcContext *ctx) {
+    if (ctx->error_jmp != NULL) longjmp(*ctx->error_jmp, 1);
 
-    // ERR_SYSTEM の場合は行番号を表示しない
-    if (type != ERR_SYSTEM) {
-        // 構造体から行番号を取得
-        fprintf(stderr, "%d行目: ", current_token.line);
-    }
+    // 脱出先がないのは呼び出し側の誤り
+    print_error(&ctx->errors[ctx->error_count - 1], stderr);
+    abort();
+}
 
-    vfprintf(stderr, fmt, ap);
-    fprintf(stderr, "\n");
+void error(JpcContext *ctx, ErrorType type, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vrecord_error(ctx, NULL, type, fmt, ap);
+    va_end(ap);
+    raise_error(ctx);
+}
 
+void error_at(JpcContext *ctx, const Token *tok, ErrorType type, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vrecord_error(ctx, tok, type, fmt, ap);
     va_end(ap);
-    exit(1);
-}
\ No newline at end of file
+    raise_error(ctx);
+}
+
+void print_errors(JpcContext *ctx, FILE *fp) {
+    for (int i = 0; i < ctx->error_count; i++) {
+        print_error(&ctx->errors[i], fp);
+    }
+}
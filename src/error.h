@@ -1,6 +1,9 @@
 #ifndef ERROR_H
 #define ERROR_H
 
+#include <stdio.h>
+#include "lexer.h" // Token
+
 // エラー種別の定義
 typedef enum {
     ERR_LEXER,    // 字句解析エラー (不正な文字、閉じ忘れなど)
@@ -10,12 +13,24 @@ typedef enum {
     ERR_SYSTEM    // システムエラー (メモリ不足など)
 } ErrorType;
 
-// グローバルな行番号カウンタ
-extern int current_line;
+typedef struct JpcContext JpcContext;
+
+// エラー種別のラベル (「字句解析エラー」など)
+const char *get_error_label(ErrorType type);
 
 // エラー報告関数
+// エラーを ctx に記録し、ctx->error_jmp へ longjmp する (呼び出し元には戻らない)
 // type: エラーの種類
 // fmt: フォーマット文字列
-void error(ErrorType type, const char *fmt, ...);
+void error(JpcContext *ctx, ErrorType type, const char *fmt, ...) __attribute__((noreturn));
+
+// エラーを ctx に記録するだけで、呼び出し元に戻る
+void record_error(JpcContext *ctx, ErrorType type, const char *fmt, ...);
+
+// error と同じだが、位置は current_token ではなく tok にする (読み進めた後で、前のトークンを指すとき)
+void error_at(JpcContext *ctx, const Token *tok, ErrorType type, const char *fmt, ...) __attribute__((noreturn));
+
+// 記録されたエラーを発生順に出力する
+void print_errors(JpcContext *ctx, FILE *fp);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bench-util.h"
+
+// 数値を count 個入力して合計する入力を、scanf を呼ぶコード (--stdio) とランタイムを埋め込んだコードにして、
+// 生成した実行ファイルの速さを比べる
+
+static void generate_input(FILE *fp, long count) {
+    fprintf(fp, "メイン｛\n");
+    fprintf(fp, "　　”合計”を「０」で宣言する。\n");
+    fprintf(fp, "　　”値”を「０」で宣言する。\n");
+    fprintf(fp, "　　”i”を「０」で宣言する。\n");
+    fprintf(fp, "　　ループ（”i”が「%ld」より小さいか）｛\n", count);
+    fprintf(fp, "　　　　”値”に入力する。\n");
+    fprintf(fp, "　　　　”合計”に”値”をたす。\n");
+    fprintf(fp, "　　　　”i”に「１」をたす。\n");
+    fprintf(fp, "　　｝\n");
+    fprintf(fp, "　　「合計は”合計”です」と出力する。\n");
+    fprintf(fp, "｝\n");
+}
+
+// 生成したプログラムに流し込む数値を count 個書く。
+// 整数・小数・指数表記のほか、正確な変換に strtod が要る長い仮数部も少し混ぜる
+static bool generate_data(const char *path, long count) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) return false;
+    unsigned long long x = 88172645463325252ull;
+    for (long i = 0; i < count; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        switch (i % 8) {
+        case 0: case 1: case 2:
+            fprintf(fp, "%lld", (long long)(x % 2000001) - 1000000);
+            break;
+        case 3: case 4:
+            fprintf(fp, "%llu.%03llu", x % 100000, (x >> 20) % 1000);
+            break;
+        case 5:
+            fprintf(fp, "-0.%06llu", x % 1000000);
+            break;
+        case 6:
+            fprintf(fp, "%llue%d", x % 10000, (int)((x >> 32) % 41) - 20);
+            break;
+        default:
+            fprintf(fp, "%.17g", (double)(x >> 11) * 0x1p-53);
+            break;
+        }
+        fputc(i % 10 == 9 ? '\n' : ' ', fp);
+    }
+    return fclose(fp) == 0;
+}
+
+int main(int argc, char *argv[]) {
+    long count = argc > 1 ? atol(argv[1]) : 2000000;
+    char dir[] = "/tmp/jpc-input-bench-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        fprintf(stderr, "Error: Cannot create temporary directory\n");
+        return 1;
+    }
+    char src[4096 + 16], data[4096 + 16];
+    snprintf(src, sizeof(src), "%s/input.jpc", dir);
+    snprintf(data, sizeof(data), "%s/input.txt", dir);
+    if (!bench_write_source(src, generate_input, count)) {
+        fprintf(stderr, "Error: Cannot write %s\n", src);
+        return 1;
+    }
+    if (!generate_data(data, count)) {
+        fprintf(stderr, "Error: Cannot write %s\n", data);
+        return 1;
+    }
+
+    DriverOptions variants[2] = {
+        { OPT_LEVEL_DEFAULT, false, { .use_runtime = false }, BUILD_DEFAULTS, false },
+        { OPT_LEVEL_DEFAULT, false, { .use_runtime = true }, BUILD_DEFAULTS, false },
+    };
+    const char *const names[2] = { "scanf   (--stdio)", "runtime (default)" };
+    printf("=== Input Bench: %ld numbers ===\n", count);
+    bool same = bench_compare(src, data, variants, names, 3);
+
+    unlink(src);
+    unlink(data);
+    rmdir(dir);
+    return same ? 0 : 1;
+}
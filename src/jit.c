@@ -0,0 +1,418 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <sys/mman.h>
+#include "jit.h"
+#include "error.h"
+#include "context.h"
+
+// 前方参照の飛び先 (code[pos] からの 4 バイトに label への相対位置を書く)
+typedef struct {
+    uint32_t pos;
+    uint32_t label;
+} JitFixup;
+
+// 生成中の状態 (realloc で伸ばす配列は、エラーで抜けても jit_run が解放する)
+typedef struct {
+    JpcContext *ctx;
+    const Ast *ast;
+    uint8_t *code;
+    uint32_t len, cap;
+    uint32_t *labels;       // ラベル -> code 上の位置 (未定なら UINT32_MAX)
+    uint32_t nlabels, labels_cap;
+    JitFixup *fixups;
+    uint32_t nfixups, fixups_cap;
+    AstText *texts;         // STR_LIT ノードの添字 -> 分けた文字列
+} Jit;
+
+// --- プロトタイプ宣言 (内部関数) ---
+static void jit_stmt(Jit *j, uint32_t id);
+static void jit_block(Jit *j, uint32_t id);
+static void jit_branch(Jit *j, uint32_t id, bool jump_if, uint32_t label);
+
+// --- 生成した機械語から呼ぶ入出力 ---
+
+static void jit_output_text(const AstText *t, const double *vars) {
+    for (uint32_t i = 0; i < t->count; i++) {
+        const AstPiece *p = &t->pieces[i];
+        fwrite(p->text, 1, p->len, stdout);
+        if (p->var >= 0) printf("%f", vars[p->var]);
+    }
+}
+
+static void jit_output_number(double val) {
+    printf("%g\n", val);
+}
+
+static void jit_input(double *var) {
+    // 読めなければ C の scanf と同じく変数はそのまま
+    if (scanf("%lf", var) != 1) return;
+}
+
+// --- 機械語のバッファ ---
+
+static void *jit_grow(Jit *j, void *buf, uint32_t *cap, uint32_t need, size_t elem) {
+    if (need <= *cap) return buf;
+    uint32_t new_cap = *cap ? *cap : 256;
+    while (new_cap < need) new_cap *= 2;
+    void *grown = realloc(buf, elem * new_cap);
+    if (grown == NULL) error(j->ctx, ERR_SYSTEM, "メモリを確保できません");
+    *cap = new_cap;
+    return grown;
+}
+
+static void emit(Jit *j, const uint8_t *bytes, uint32_t n) {
+    j->code = jit_grow(j, j->code, &j->cap, j->len + n, 1);
+    memcpy(j->code + j->len, bytes, n);
+    j->len += n;
+}
+
+#define EMIT(j, ...) do { \
+        const uint8_t bytes_[] = { __VA_ARGS__ }; \
+        emit(j, bytes_, sizeof(bytes_)); \
+    } while (0)
+
+static void emit_u32(Jit *j, uint32_t v) {
+    EMIT(j, v & 0xFF, (v >> 8) & 0xFF, (v >> 16) & 0xFF, v >> 24);
+}
+
+static void emit_u64(Jit *j, uint64_t v) {
+    emit_u32(j, (uint32_t)v);
+    emit_u32(j, (uint32_t)(v >> 32));
+}
+
+static uint32_t new_label(Jit *j) {
+    j->labels = jit_grow(j, j->labels, &j->labels_cap, j->nlabels + 1, sizeof(uint32_t));
+    j->labels[j->nlabels] = UINT32_MAX;
+    return j->nlabels++;
+}
+
+static void place_label(Jit *j, uint32_t label) {
+    j->labels[label] = j->len;
+}
+
+// 飛び先 label の rel32 を書く (位置は最後にまとめて埋める)
+static void emit_rel32(Jit *j, uint32_t label) {
+    j->fixups = jit_grow(j, j->fixups, &j->fixups_cap, j->nfixups + 1, sizeof(JitFixup));
+    j->fixups[j->nfixups++] = (JitFixup){ j->len, label };
+    emit_u32(j, 0);
+}
+
+// x86 の条件コード (jcc rel32 は 0F 80+cc)
+enum { CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6, CC_A = 0x7, CC_P = 0xA };
+
+static void emit_jcc(Jit *j, int cc, uint32_t label) {
+    EMIT(j, 0x0F, 0x80 + cc);
+    emit_rel32(j, label);
+}
+
+static void emit_jmp(Jit *j, uint32_t label) {
+    EMIT(j, 0xE9);
+    emit_rel32(j, label);
+}
+
+// 変数の位置 (%rbx が変数の配列を指す)
+static uint32_t var_disp(uint32_t var) {
+    return var * 8;
+}
+
+// SSE2 の命令 (prefix 0F op) を xmm reg と [rbx + 変数] に対して書く
+static void emit_sse_var(Jit *j, uint8_t prefix, uint8_t op, int reg, uint32_t var) {
+    EMIT(j, prefix, 0x0F, op, 0x83 | reg << 3);
+    emit_u32(j, var_disp(var));
+}
+
+// 値 (変数か定数) を xmm reg に読み込む。定数は rax を経由する
+static void emit_load(Jit *j, uint32_t id, int reg) {
+    const ANode *node = &j->ast->nodes[id];
+    switch (node->kind) {
+    case ND_VAR:
+        emit_sse_var(j, 0xF2, 0x10, reg, node->a);  // movsd xmm, [rbx + disp32]
+        return;
+    case ND_LITERAL:
+        EMIT(j, 0x48, 0xB8);                        // movabs rax, imm64
+        emit_u64(j, (uint64_t)node->b << 32 | node->a);
+        EMIT(j, 0x66, 0x48, 0x0F, 0x6E, 0xC0 | reg << 3); // movq xmm, rax
+        return;
+    default:
+        error(j->ctx, ERR_CODEGEN, "Unknown Node Kind %d", node->kind);
+    }
+}
+
+// xmm0 と値 id に prefix 0F op を適用する (変数ならメモリを直接、定数なら xmm1 に読んでから)
+static void emit_sse_value(Jit *j, uint8_t prefix, uint8_t op, uint32_t id) {
+    const ANode *node = &j->ast->nodes[id];
+    if (node->kind == ND_VAR) {
+        emit_sse_var(j, prefix, op, 0, node->a);
+        return;
+    }
+    emit_load(j, id, 1);
+    EMIT(j, prefix, 0x0F, op, 0xC1);  // op xmm0, xmm1
+}
+
+// 関数 fn を呼ぶ (引数は呼び出し側で用意する)
+static void emit_call(Jit *j, void *fn) {
+    EMIT(j, 0x48, 0xB8);              // movabs rax, fn
+    emit_u64(j, (uint64_t)(uintptr_t)fn);
+    EMIT(j, 0xFF, 0xD0);              // call rax
+}
+
+// movabs rdi, ptr
+static void emit_arg_ptr(Jit *j, const void *ptr) {
+    EMIT(j, 0x48, 0xBF);
+    emit_u64(j, (uint64_t)(uintptr_t)ptr);
+}
+
+// --- 条件分岐 (asmgen.c と同じ組み立て) ---
+
+static void jit_compare(Jit *j, const ANode *node, bool jump_if, uint32_t label) {
+    uint32_t lhs = node->a, rhs = node->b;
+    if (node->kind == ND_LT || node->kind == ND_LE) {
+        lhs = node->b;
+        rhs = node->a;
+    }
+    emit_load(j, lhs, 0);
+    emit_sse_value(j, 0x66, 0x2E, rhs);  // ucomisd xmm0, rhs
+
+    switch (node->kind) {
+    case ND_GT:
+    case ND_LT:
+        emit_jcc(j, jump_if ? CC_A : CC_BE, label);
+        return;
+    case ND_GE:
+    case ND_LE:
+        emit_jcc(j, jump_if ? CC_AE : CC_B, label);
+        return;
+    case ND_EQ:
+    case ND_NE:
+        if ((node->kind == ND_EQ) == jump_if) {
+            uint32_t skip = new_label(j);
+            emit_jcc(j, CC_P, skip);
+            emit_jcc(j, CC_E, label);
+            place_label(j, skip);
+        } else {
+            emit_jcc(j, CC_P, label);
+            emit_jcc(j, CC_NE, label);
+        }
+        return;
+    default:
+        error(j->ctx, ERR_CODEGEN, "Unknown Node Kind %d", node->kind);
+    }
+}
+
+static void jit_branch(Jit *j, uint32_t id, bool jump_if, uint32_t label) {
+    const ANode *node = &j->ast->nodes[id];
+    switch (node->kind) {
+    case ND_AND:
+    case ND_OR: {
+        bool short_circuit = node->kind == ND_AND ? !jump_if : jump_if;
+        if (short_circuit) {
+            jit_branch(j, node->a, jump_if, label);
+            jit_branch(j, node->b, jump_if, label);
+        } else {
+            uint32_t skip = new_label(j);
+            jit_branch(j, node->a, !jump_if, skip);
+            jit_branch(j, node->b, jump_if, label);
+            place_label(j, skip);
+        }
+        return;
+    }
+
+    case ND_EQ:
+    case ND_NE:
+    case ND_LT:
+    case ND_LE:
+    case ND_GT:
+    case ND_GE:
+        jit_compare(j, node, jump_if, label);
+        return;
+
+    case ND_LITERAL:
+        if ((ast_num(node) != 0) == jump_if) emit_jmp(j, label);
+        return;
+
+    case ND_VAR: {
+        emit_load(j, id, 0);
+        EMIT(j, 0x66, 0x0F, 0x57, 0xC9);  // xorpd xmm1, xmm1
+        EMIT(j, 0x66, 0x0F, 0x2E, 0xC1);  // ucomisd xmm0, xmm1
+        if (jump_if) {
+            emit_jcc(j, CC_P, label);
+            emit_jcc(j, CC_NE, label);
+        } else {
+            uint32_t skip = new_label(j);
+            emit_jcc(j, CC_P, skip);
+            emit_jcc(j, CC_E, label);
+            place_label(j, skip);
+        }
+        return;
+    }
+
+    default:
+        error(j->ctx, ERR_CODEGEN, "Unknown Node Kind %d", node->kind);
+    }
+}
+
+// --- 文 ---
+
+// 出力する書式を、そのまま書く部分と変数に分ける
+static const AstText *jit_text(Jit *j, uint32_t str_id) {
+    AstText *t = &j->texts[str_id];
+    ast_split_text(j->ctx, j->ast, str_id, t);
+    return t;
+}
+
+static void jit_if(Jit *j, uint32_t id, uint32_t end) {
+    const ANode *node = &j->ast->nodes[id];
+    uint32_t next = new_label(j);
+    jit_branch(j, node->a, false, next);
+    jit_block(j, node->b);
+    if (node->c) emit_jmp(j, end);
+    place_label(j, next);
+    if (node->c) {
+        if (j->ast->nodes[node->c].kind == ND_ELSEIF) {
+            jit_if(j, node->c, end);
+        } else {
+            jit_block(j, node->c);
+        }
+    }
+}
+
+static void jit_block(Jit *j, uint32_t id) {
+    for (; id; id = j->ast->nodes[id].next) {
+        jit_stmt(j, id);
+    }
+}
+
+static void jit_stmt(Jit *j, uint32_t id) {
+    const ANode *node = &j->ast->nodes[id];
+
+    switch (node->kind) {
+    case ND_BLOCK:
+        jit_block(j, node->a);
+        return;
+
+    case ND_IF: {
+        uint32_t end = new_label(j);
+        jit_if(j, id, end);
+        place_label(j, end);
+        return;
+    }
+
+    case ND_LOOP: {
+        uint32_t body = new_label(j), cond = new_label(j);
+        emit_jmp(j, cond);
+        place_label(j, body);
+        jit_block(j, node->b);
+        place_label(j, cond);
+        jit_branch(j, node->a, true, body);
+        return;
+    }
+
+    case ND_DECLARE:
+    case ND_ASSIGN:
+        emit_load(j, node->b, 0);
+        emit_sse_var(j, 0xF2, 0x11, 0, j->ast->nodes[node->a].a);  // movsd [rbx + disp32], xmm0
+        return;
+
+    case ND_ADD:
+    case ND_SUB:
+    case ND_MUL:
+    case ND_DIV: {
+        uint8_t op = node->kind == ND_ADD ? 0x58 : node->kind == ND_SUB ? 0x5C : node->kind == ND_MUL ? 0x59 : 0x5E;
+        uint32_t var = j->ast->nodes[node->a].a;
+        emit_sse_var(j, 0xF2, 0x10, 0, var);
+        emit_sse_value(j, 0xF2, op, node->b);
+        emit_sse_var(j, 0xF2, 0x11, 0, var);
+        return;
+    }
+
+    case ND_INPUT:
+        EMIT(j, 0x48, 0x8D, 0xBB);    // lea rdi, [rbx + disp32]
+        emit_u32(j, var_disp(j->ast->nodes[node->a].a));
+        emit_call(j, (void *)jit_input);
+        return;
+
+    case ND_OUTPUT:
+        if (j->ast->nodes[node->a].kind == ND_STR_LIT) {
+            emit_arg_ptr(j, jit_text(j, node->a));
+            EMIT(j, 0x48, 0x89, 0xDE);    // mov rsi, rbx
+            emit_call(j, (void *)jit_output_text);
+        } else {
+            emit_load(j, node->a, 0);
+            emit_call(j, (void *)jit_output_number);
+        }
+        return;
+
+    default:
+        error(j->ctx, ERR_CODEGEN, "Unknown Node Kind %d", node->kind);
+    }
+}
+
+// void f(double *vars) として呼べる関数を作る
+static void jit_program(Jit *j) {
+    EMIT(j, 0x53);                  // push rbx (呼び出し時に %rsp が 16 の倍数になる)
+    EMIT(j, 0x48, 0x89, 0xFB);      // mov rbx, rdi
+    jit_block(j, j->ast->nodes[j->ast->root].a);
+    EMIT(j, 0x5B);                  // pop rbx
+    EMIT(j, 0xC3);                  // ret
+
+    for (uint32_t i = 0; i < j->nfixups; i++) {
+        const JitFixup *f = &j->fixups[i];
+        int32_t rel = (int32_t)(j->labels[f->label] - (f->pos + 4));
+        memcpy(j->code + f->pos, &rel, sizeof(rel));
+    }
+}
+
+// --- エントリーポイント ---
+
+static bool run_jit(Jit *j) {
+    jmp_buf env;
+    jmp_buf *prev = j->ctx->error_jmp;
+    j->ctx->error_jmp = &env;
+    if (setjmp(env) != 0) {
+        j->ctx->error_jmp = prev;
+        return false;
+    }
+    j->texts = context_alloc(j->ctx, sizeof(AstText) * j->ast->count);
+    jit_program(j);
+    j->ctx->error_jmp = prev;
+    return true;
+}
+
+bool jit_run(JpcContext *ctx, const Ast *ast) {
+    Jit j = { .ctx = ctx, .ast = ast };
+    bool ok = run_jit(&j);
+    free(j.labels);
+    free(j.fixups);
+    if (!ok) {
+        free(j.code);
+        return false;
+    }
+
+    // 書き込める領域に写してから、実行だけできるようにする
+    void *mem = mmap(NULL, j.len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        free(j.code);
+        record_error(ctx, ERR_SYSTEM, "実行用のメモリを確保できません");
+        return false;
+    }
+    memcpy(mem, j.code, j.len);
+    free(j.code);
+    double *vars = calloc(ast_var_count(ast) + 1, sizeof(double));
+    if (vars == NULL || mprotect(mem, j.len, PROT_READ | PROT_EXEC) != 0) {
+        free(vars);
+        munmap(mem, j.len);
+        record_error(ctx, ERR_SYSTEM, "実行用のメモリを確保できません");
+        return false;
+    }
+
+    void (*entry)(double *);
+    memcpy(&entry, &mem, sizeof(entry));
+    entry(vars);
+    fflush(stdout);
+
+    free(vars);
+    munmap(mem, j.len);
+    return true;
+}
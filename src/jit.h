@@ -0,0 +1,16 @@
+// jit.h
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdbool.h>
+#include "ast.h"
+
+// --- その場で実行 (jpc -r) ---
+// AST から x86-64 の機械語を直接メモリに書き、コンパイラのプロセスの中でそのまま実行する。
+// 計算は --asm と同じく SSE2 の double で行い、入出力は jpc 側の小さな関数を呼ぶ
+// (表示は printf/scanf を直接呼ぶ C (--stdio) と同じになる)
+
+// ast を実行する。機械語の生成や実行領域の確保に失敗したら ctx にエラーを記録して false を返す
+bool jit_run(JpcContext *ctx, const Ast *ast);
+
+#endif
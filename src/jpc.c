@@ -2,92 +2,348 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h> // getopt用
-#include "lexer.h"
-#include "parser.h"
+#include <getopt.h> // getopt_long用
 #include "codegen.h"
+#include "jit.h"
+#include "vm.h"
+#include "build.h"
+#include "driver.h"
 #include "error.h" // エラー処理用
+#include "context.h"
+#include "server.h"
+#include "daemon.h"
+#include "cache.h"
+#include "optimize.h"
 
 void print_usage(const char *prog_name) {
     fprintf(stderr, "Usage: %s [options] <input.jpc>\n", prog_name);
+    fprintf(stderr, "       %s [options] -d <dir> <input.jpc>... (または --manifest <file>)\n", prog_name);
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "  -o <filename>  コンパイルして実行ファイル <filename> を生成します。\n");
     fprintf(stderr, "                 指定されない場合、Cコードを標準出力に出力します。\n");
-    fprintf(stderr, "  -k <filename>  中間Cファイルを <filename> として保存します。\n");
+    fprintf(stderr, "  -k <filename>  中間Cファイル (--asm ではアセンブリ) を <filename> として保存します。\n");
+    fprintf(stderr, "  -r             実行ファイルを作らず、機械語をメモリ上に生成してその場で実行します。\n");
+    fprintf(stderr, "  -i             実行ファイルを作らず、バイトコードにして解釈実行します (gcc は使いません)。\n");
+    fprintf(stderr, "  -d <dir>       複数のファイルを並列にコンパイルし、実行ファイルを <dir> に置きます (名前はソースから .jpc を除いたもの)。\n");
+    fprintf(stderr, "  -j <n>         -d で同時にコンパイルするファイルの数。既定はコアの数です。\n");
+    fprintf(stderr, "  --manifest <file> -d でコンパイルするソースの一覧 (1 行に 1 つ) を <file> から読みます。\n");
+    fprintf(stderr, "  -O <level>     最適化レベル (0〜%d)。既定は %d です。\n", OPT_LEVEL_MAX, OPT_LEVEL_DEFAULT);
+    fprintf(stderr, "                 0: 最適化しません。\n");
+    fprintf(stderr, "                 1: 定数の伝播と畳み込み、到達しない分岐・実行されないループ・読まれない代入の削除、\n");
+    fprintf(stderr, "                    ループで変わらない文のループ前への移動、2 のべき乗のわり算のかけ算化を行います。\n");
+    fprintf(stderr, "                 2: 1 に加えて、整数の値しか持たない変数を int64_t にし、帰納変数のかけ算をたし算にします。\n");
+    fprintf(stderr, "  --cc-opt <level> -o で gcc に渡す最適化レベル (0〜3)。指定しない場合は渡しません。\n");
+    fprintf(stderr, "  --march <arch> -o で gcc に -march=<arch> を渡します (native など)。\n");
+    fprintf(stderr, "  --pgo <input>  -o で <input> を標準入力にして計測し、そのプロファイルを使って gcc で作り直します。\n");
+    fprintf(stderr, "  --opt-stats    最適化で削除・移動したものの数を標準エラー出力に表示します。\n");
+    fprintf(stderr, "  --stdio        出力用のランタイムを埋め込まず、printf/scanf を直接呼ぶCコードを生成します。\n");
+    fprintf(stderr, "  --asm          Cを経由せず x86-64 のアセンブリを生成します (-o ではアセンブラとリンカだけを使います)。\n");
+    fprintf(stderr, "  --no-cache     AST と実行ファイルのキャッシュを使いません (キャッシュの場所は $JPC_CACHE_DIR で変更できます)。\n");
+    fprintf(stderr, "  --cache-stats  実行ファイルのキャッシュのヒット・ミスの回数と大きさを標準エラー出力に表示します。\n");
+    fprintf(stderr, "                 入力ファイルを省くと表示だけを行います (大きさの上限は $JPC_CACHE_SIZE (MiB) で変更できます)。\n");
+    fprintf(stderr, "  --server       診断サーバとして起動します (標準入出力で LSP 形式のメッセージをやり取りします)。\n");
+    fprintf(stderr, "  --daemon       コンパイルデーモンとして起動します (ソケットは $JPC_DAEMON_SOCKET、既定はキャッシュディレクトリの daemon.sock)。\n");
+    fprintf(stderr, "                 ソースの変更を見張り、変わったものだけを作り直します。SIGINT か SIGTERM で終わります。\n");
+    fprintf(stderr, "  --client       -o のコンパイルをデーモンに頼みます (つながらなければ、このプロセスでコンパイルします)。\n");
+}
+
+// 記録されたエラーを表示し、終了コードを返す
+static int report_errors(JpcContext *ctx) {
+    print_errors(ctx, stderr);
+    free_context(ctx);
+    return 1;
+}
+
+// 実行ファイルのキャッシュのヒット・ミスの回数と大きさを表示する (result はこの実行での結果。なければ NULL)
+static void print_cache_stats(const char *result) {
+    char root[4096];
+    BinCacheStats stats;
+    if (!cache_dir(root, sizeof(root)) || !cache_binary_stats(root, &stats)) {
+        fprintf(stderr, "キャッシュ: キャッシュディレクトリを使えません\n");
+        return;
+    }
+    if (result != NULL) fprintf(stderr, "キャッシュ: %s\n", result);
+    uint64_t total = stats.hits + stats.misses;
+    fprintf(stderr, "キャッシュ: ヒット %llu 回, ミス %llu 回 (ヒット率 %.1f%%)\n",
+            (unsigned long long)stats.hits, (unsigned long long)stats.misses, total ? 100.0 * stats.hits / total : 0.0);
+    fprintf(stderr, "キャッシュ: 実行ファイル %llu 個, AST %llu 個, プロファイル %llu 個, 合計 %.1f MiB (上限 %.1f MiB)\n",
+            (unsigned long long)stats.entries, (unsigned long long)stats.asts, (unsigned long long)stats.profiles,
+            stats.bytes / 1048576.0, stats.limit / 1048576.0);
 }
 
 int main(int argc, char *argv[]) {
     char *output_exec = NULL;
-    char *c_file_name = "_tmp_jpc.c"; // デフォルトCファイル名
+    char *c_file_name = NULL; // -k で保存するファイル名
     int compile_flag = 0; // -o が指定されたか
     int keep_flag = 0;    // -k が指定されたか
+    int show_stats = 0;   // --opt-stats が指定されたか
+    int show_cache_stats = 0; // --cache-stats が指定されたか
+    int asm_flag = 0;     // --asm が指定されたか
+    int run_flag = 0;     // -r が指定されたか
+    int interp_flag = 0;  // -i が指定されたか
+    int client_flag = 0;  // --client が指定されたか
+    char *out_dir = NULL;       // -d の出力先
+    char *manifest = NULL;      // --manifest のファイル
+    int jobs = 0;               // -j (0 ならコアの数)
+    DriverOptions opts = { OPT_LEVEL_DEFAULT, true, CODEGEN_DEFAULTS, BUILD_DEFAULTS, false };
     char *input_file = NULL;
     int opt;
+    static struct option long_options[] = {
+        {"server", no_argument, NULL, 'S'},
+        {"daemon", no_argument, NULL, 'D'},
+        {"client", no_argument, NULL, 'U'},
+        {"no-cache", no_argument, NULL, 'C'},
+        {"opt-stats", no_argument, NULL, 'T'},
+        {"cache-stats", no_argument, NULL, 'H'},
+        {"stdio", no_argument, NULL, 'P'},
+        {"asm", no_argument, NULL, 'A'},
+        {"cc-opt", required_argument, NULL, 'G'},
+        {"march", required_argument, NULL, 'M'},
+        {"pgo", required_argument, NULL, 'F'},
+        {"manifest", required_argument, NULL, 'L'},
+        {NULL, 0, NULL, 0}
+    };
 
     // 1. オプション解析
-    while ((opt = getopt(argc, argv, "o:k:")) != -1) {
+    while ((opt = getopt_long(argc, argv, "o:k:O:rid:j:", long_options, NULL)) != -1) {
         switch (opt) {
+            case 'S':
+                return run_server();
+            case 'D': {
+                char path[4096];
+                if (!daemon_socket_path(path, sizeof(path))) {
+                    fprintf(stderr, "ソケットの場所を決められません ($JPC_DAEMON_SOCKET を指定してください)\n");
+                    return 1;
+                }
+                return run_daemon(path);
+            }
+            case 'U':
+                client_flag = 1;
+                break;
+            case 'C':
+                opts.use_cache = false;
+                opts.build.use_cache = false;
+                break;
+            case 'T':
+                show_stats = 1;
+                break;
+            case 'H':
+                show_cache_stats = 1;
+                break;
+            case 'P':
+                opts.codegen.use_runtime = false;
+                break;
+            case 'A':
+                asm_flag = 1;
+                break;
+            case 'G':
+                if (!build_valid_cc_opt(optarg)) {
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                opts.build.cc_opt = optarg;
+                break;
+            case 'M':
+                if (!build_valid_march(optarg)) {
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                opts.build.march = optarg;
+                break;
+            case 'F':
+                opts.build.pgo_input = optarg;
+                break;
+            case 'L':
+                manifest = optarg;
+                break;
+            case 'd':
+                out_dir = optarg;
+                break;
+            case 'j': {
+                char *end;
+                jobs = (int)strtol(optarg, &end, 10);
+                if (*end != '\0' || jobs < 1) {
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            }
             case 'o':
                 output_exec = optarg;
                 compile_flag = 1; 
                 break;
+            case 'r':
+                run_flag = 1;
+                break;
+            case 'i':
+                interp_flag = 1;
+                break;
             case 'k':
                 c_file_name = optarg; 
                 keep_flag = 1;
                 break;
+            case 'O': {
+                char *end;
+                opts.opt_level = (int)strtol(optarg, &end, 10);
+                if (*end != '\0' || opts.opt_level < 0) {
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                if (opts.opt_level > OPT_LEVEL_MAX) opts.opt_level = OPT_LEVEL_MAX;
+                break;
+            }
             default:
                 print_usage(argv[0]);
                 return 1;
         }
     }
 
-    // ... (入力ファイル取得、fopen は変更なし) ...
+    // 2. コンパイラ文脈の用意
+    JpcContext *ctx = new_context();
+    if (ctx == NULL) {
+        fprintf(stderr, "メモリを確保できません\n");
+        return 1;
+    }
+
+    opts.build.assembly = asm_flag;
+
+    // 複数のファイル (-d): スレッドで並べてコンパイルして終わる
+    if (out_dir != NULL || manifest != NULL || argc - optind > 1) {
+        if (out_dir == NULL) {
+            record_error(ctx, ERR_SYSTEM, "複数のファイルをコンパイルするには -d で出力先を指定してください。");
+            return report_errors(ctx);
+        }
+        if (compile_flag || keep_flag || run_flag || interp_flag || client_flag) {
+            record_error(ctx, ERR_SYSTEM, "-d では -o, -k, -r, -i, --client は使えません。");
+            return report_errors(ctx);
+        }
+        char **inputs = NULL;
+        int count = 0;
+        bool ok = true;
+        if (manifest != NULL) ok = driver_read_manifest(ctx, manifest, &inputs, &count);
+        for (int i = optind; ok && i < argc; i++) {
+            char **grown = realloc(inputs, sizeof(char *) * (count + 1));
+            char *copy = strdup(argv[i]);
+            if (grown != NULL) inputs = grown;
+            if (grown == NULL || copy == NULL) {
+                free(copy);
+                record_error(ctx, ERR_SYSTEM, "メモリを確保できません");
+                ok = false;
+                break;
+            }
+            inputs[count++] = copy;
+        }
+        if (ok && count == 0) {
+            record_error(ctx, ERR_SYSTEM, "入力ファイルが指定されていません。\nUsage: ./jpc [options] -d <dir> <input.jpc>...");
+            ok = false;
+        }
+        if (ok) ok = driver_compile_all(&opts, inputs, count, out_dir, jobs);
+        for (int i = 0; i < count; i++) free(inputs[i]);
+        free(inputs);
+        if (!ok) return report_errors(ctx);
+        if (show_cache_stats) print_cache_stats(NULL);
+        free_context(ctx);
+        return 0;
+    }
+
+    if (optind >= argc && show_cache_stats) {
+        print_cache_stats(NULL);
+        free_context(ctx);
+        return 0;
+    }
     if (optind >= argc) {
-        error(ERR_SYSTEM, "入力ファイルが指定されていません。\nUsage: ./jpc [options] <input.jpc>");
+        record_error(ctx, ERR_SYSTEM, "入力ファイルが指定されていません。\nUsage: ./jpc [options] <input.jpc>");
+        return report_errors(ctx);
+    }
+    if (opts.build.pgo_input != NULL && !compile_flag) {
+        record_error(ctx, ERR_SYSTEM, "--pgo は -o で実行ファイルを作るときだけ使えます。");
+        return report_errors(ctx);
     }
     input_file = argv[optind];
 
-    FILE *fp = fopen(input_file, "r");
-    if (fp == NULL) {
-        error(ERR_SYSTEM, "ファイルを開けません: %s", input_file);
+    // --client: デーモンに頼む (つながらなければ、このプロセスでコンパイルする)
+    if (client_flag) {
+        if (!compile_flag || keep_flag || run_flag || interp_flag || show_stats || opts.build.pgo_input != NULL) {
+            record_error(ctx, ERR_SYSTEM, "--client は -o とだけ使えます (-k, -r, -i, --opt-stats, --pgo は使えません)。");
+            return report_errors(ctx);
+        }
+        char path[4096];
+        bool cache_hit = false;
+        DaemonResult result = daemon_socket_path(path, sizeof(path)) ?
+            daemon_compile(path, input_file, output_exec, &opts, &cache_hit) : DAEMON_UNAVAILABLE;
+        if (result != DAEMON_UNAVAILABLE) {
+            if (result == DAEMON_OK && show_cache_stats) {
+                print_cache_stats(cache_hit ? "ヒット (デーモンがキャッシュの実行ファイルを使いました)" :
+                                  opts.build.use_cache ? "ミス (デーモンが gcc で作った実行ファイルをキャッシュに入れました)" :
+                                  "使っていません (--no-cache)");
+            }
+            free_context(ctx);
+            return result == DAEMON_OK ? 0 : 1;
+        }
+        fprintf(stderr, "デーモンに接続できないため、このプロセスでコンパイルします\n");
     }
 
-    // 3. 構文解析
-    getNextToken(fp);
-    Node *root = parse_program(fp);
-    fclose(fp);
+    // 3. 構文解析と最適化 (同じ内容をコンパイル済みなら、キャッシュした AST を使う)
+    OptStats stats;
+    const Ast *ast = driver_load(ctx, input_file, &opts, &stats);
+    if (ast == NULL) return report_errors(ctx);
+    if (show_stats) {
+        fprintf(stderr, "最適化: %u 個のノードを削除しました (分岐 %u, ループ %u, 代入 %u)\n",
+                stats.removed_nodes, stats.removed_branches, stats.removed_loops, stats.removed_stores);
+        fprintf(stderr, "最適化: ループの前に %u 個の文を移し、%u 個の演算を軽くしました\n",
+                stats.hoisted_stmts, stats.reduced_ops);
+    }
 
-    // 4. Cコード出力先の決定（デフォルトは標準出力）
-    FILE *c_fp = stdout;
+    // -r: その場で実行して終わる
+    if (run_flag) {
+        if (!jit_run(ctx, ast)) return report_errors(ctx);
+        free_context(ctx);
+        return 0;
+    }
 
-    if (compile_flag || keep_flag) {
-        c_fp = fopen(c_file_name, "w");
-        if (c_fp == NULL) {
-            error(ERR_SYSTEM, "Cファイルを作成できません: %s", c_file_name);
-        }
+    // -i: バイトコードにして解釈実行して終わる
+    if (interp_flag) {
+        if (!vm_run(ctx, ast)) return report_errors(ctx);
+        free_context(ctx);
+        return 0;
     }
 
-    // 5. コード生成
-    codegen(root, c_fp);
+    // 4. コード生成 (メモリ上のバッファに書き、一時ファイルは作らない)
+    char *code;
+    size_t code_len;
+    if (!driver_generate(ctx, ast, &opts, &code, &code_len)) return report_errors(ctx);
 
-    // ファイルに出力した場合のみ閉じる
-    if (c_fp != stdout) {
-        fclose(c_fp);
+    // 5. 出力 (-k ならファイルに保存し、-o も -k もなければ標準出力に書く)
+    if (keep_flag) {
+        FILE *c_fp = fopen(c_file_name, "w");
+        bool written = c_fp != NULL && fwrite(code, 1, code_len, c_fp) == code_len;
+        if (c_fp != NULL && fclose(c_fp) != 0) written = false;
+        if (!written) {
+            record_error(ctx, ERR_SYSTEM, "%sファイルを作成できません: %s", asm_flag ? "アセンブリ" : "C", c_file_name);
+            free(code);
+            return report_errors(ctx);
+        }
+    } else if (!compile_flag) {
+        fwrite(code, 1, code_len, stdout);
     }
 
-    // 6. コンパイル実行 (-o が指定された場合のみ)
+    // 6. コンパイル実行 (-o が指定された場合のみ。gcc には標準入力でソースを渡す)
     if (compile_flag) {
-        char compile_cmd[1024];
-        snprintf(compile_cmd, sizeof(compile_cmd), "gcc -o %s %s", output_exec, c_file_name);
-        
-        if (system(compile_cmd) != 0) {
-            error(ERR_SYSTEM, "GCCコンパイルに失敗しました。");
+        bool cache_hit;
+        if (!build_executable(ctx, &opts.build, code, code_len, output_exec, &cache_hit)) {
+            free(code);
+            return report_errors(ctx);
         }
-    } 
-
-    // 7. 中間ファイルの削除
-    if (compile_flag && !keep_flag) {
-        remove(c_file_name); // _tmp_jpc.c を削除
+        if (show_cache_stats) {
+            print_cache_stats(cache_hit ? "ヒット (gcc を動かさずにキャッシュの実行ファイルを使いました)" :
+                              opts.build.use_cache && opts.build.pgo_input == NULL ? "ミス (gcc で作った実行ファイルをキャッシュに入れました)" :
+                              "使っていません (--no-cache または --pgo)");
+        }
+    } else if (show_cache_stats) {
+        print_cache_stats(NULL);
     }
 
+    free(code);
+    free_context(ctx);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "json.h"
+
+typedef struct {
+    const char *p;
+    const char *end;
+    bool failed;
+} JsonParser;
+
+static JsonValue *parse_value(JsonParser *ps);
+
+static JsonValue *new_value(JsonType type) {
+    JsonValue *v = calloc(1, sizeof(JsonValue));
+    if (v) v->type = type;
+    return v;
+}
+
+static void skip_ws(JsonParser *ps) {
+    while (ps->p < ps->end && (*ps->p == ' ' || *ps->p == '\t' || *ps->p == '\n' || *ps->p == '\r')) ps->p++;
+}
+
+static bool consume(JsonParser *ps, char c) {
+    skip_ws(ps);
+    if (ps->p < ps->end && *ps->p == c) {
+        ps->p++;
+        return true;
+    }
+    return false;
+}
+
+static bool consume_word(JsonParser *ps, const char *word) {
+    size_t n = strlen(word);
+    if ((size_t)(ps->end - ps->p) >= n && memcmp(ps->p, word, n) == 0) {
+        ps->p += n;
+        return true;
+    }
+    return false;
+}
+
+static int hex4(const char *p) {
+    int v = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        v <<= 4;
+        if (c >= '0' && c <= '9') v |= c - '0';
+        else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+        else return -1;
+    }
+    return v;
+}
+
+static int put_utf8(char *out, int cp) {
+    if (cp < 0x80) { out[0] = (char)cp; return 1; }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+// 先頭の '"' は読み終えている前提。エスケープを展開した文字列を返す
+static char *parse_string_body(JsonParser *ps, int *out_len) {
+    // 展開後は元の長さを超えない
+    const char *start = ps->p;
+    const char *q = start;
+    while (q < ps->end && *q != '"') q += (*q == '\\' && q + 1 < ps->end) ? 2 : 1;
+    if (q >= ps->end) return NULL;
+    char *buf = malloc((size_t)(q - start) + 1);
+    if (buf == NULL) return NULL;
+    int n = 0;
+    while (ps->p < q) {
+        char c = *ps->p++;
+        if (c != '\\') {
+            buf[n++] = c;
+            continue;
+        }
+        char e = *ps->p++;
+        switch (e) {
+            case '"':  buf[n++] = '"'; break;
+            case '\\': buf[n++] = '\\'; break;
+            case '/':  buf[n++] = '/'; break;
+            case 'b':  buf[n++] = '\b'; break;
+            case 'f':  buf[n++] = '\f'; break;
+            case 'n':  buf[n++] = '\n'; break;
+            case 'r':  buf[n++] = '\r'; break;
+            case 't':  buf[n++] = '\t'; break;
+            case 'u': {
+                if (q - ps->p < 4) goto fail;
+                int cp = hex4(ps->p);
+                if (cp < 0) goto fail;
+                ps->p += 4;
+                // サロゲートペア
+                if (cp >= 0xD800 && cp <= 0xDBFF && q - ps->p >= 6 && ps->p[0] == '\\' && ps->p[1] == 'u') {
+                    int lo = hex4(ps->p + 2);
+                    if (lo >= 0xDC00 && lo <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        ps->p += 6;
+                    }
+                }
+                n += put_utf8(buf + n, cp);
+                break;
+            }
+            default:
+                goto fail;
+        }
+    }
+    ps->p = q + 1;
+    buf[n] = '\0';
+    *out_len = n;
+    return buf;
+fail:
+    free(buf);
+    return NULL;
+}
+
+static JsonValue *parse_array(JsonParser *ps) {
+    JsonValue *v = new_value(JSON_ARRAY);
+    int cap = 0;
+    if (consume(ps, ']')) return v;
+    do {
+        JsonValue *item = parse_value(ps);
+        if (item == NULL) { json_free(v); return NULL; }
+        if (v->count == cap) {
+            cap = cap ? cap * 2 : 4;
+            v->items = realloc(v->items, sizeof(JsonValue *) * cap);
+        }
+        v->items[v->count++] = item;
+    } while (consume(ps, ','));
+    if (!consume(ps, ']')) { json_free(v); return NULL; }
+    return v;
+}
+
+static JsonValue *parse_object(JsonParser *ps) {
+    JsonValue *v = new_value(JSON_OBJECT);
+    int cap = 0;
+    if (consume(ps, '}')) return v;
+    do {
+        int key_len;
+        if (!consume(ps, '"')) { json_free(v); return NULL; }
+        char *key = parse_string_body(ps, &key_len);
+        if (key == NULL || !consume(ps, ':')) { free(key); json_free(v); return NULL; }
+        JsonValue *item = parse_value(ps);
+        if (item == NULL) { free(key); json_free(v); return NULL; }
+        if (v->count == cap) {
+            cap = cap ? cap * 2 : 4;
+            v->items = realloc(v->items, sizeof(JsonValue *) * cap);
+            v->keys = realloc(v->keys, sizeof(char *) * cap);
+        }
+        v->keys[v->count] = key;
+        v->items[v->count++] = item;
+    } while (consume(ps, ','));
+    if (!consume(ps, '}')) { json_free(v); return NULL; }
+    return v;
+}
+
+static JsonValue *parse_value(JsonParser *ps) {
+    skip_ws(ps);
+    if (ps->p >= ps->end) return NULL;
+    char c = *ps->p;
+    if (c == '{') { ps->p++; return parse_object(ps); }
+    if (c == '[') { ps->p++; return parse_array(ps); }
+    if (c == '"') {
+        ps->p++;
+        JsonValue *v = new_value(JSON_STRING);
+        v->str = parse_string_body(ps, &v->str_len);
+        if (v->str == NULL) { free(v); return NULL; }
+        return v;
+    }
+    if (consume_word(ps, "true"))  { JsonValue *v = new_value(JSON_BOOL); v->boolean = true; return v; }
+    if (consume_word(ps, "false")) { return new_value(JSON_BOOL); }
+    if (consume_word(ps, "null"))  { return new_value(JSON_NULL); }
+    if (c == '-' || (c >= '0' && c <= '9')) {
+        char buf[64];
+        int n = 0;
+        while (ps->p < ps->end && n < (int)sizeof(buf) - 1 && strchr("+-0123456789.eE", *ps->p)) buf[n++] = *ps->p++;
+        buf[n] = '\0';
+        JsonValue *v = new_value(JSON_NUMBER);
+        v->number = strtod(buf, NULL);
+        return v;
+    }
+    return NULL;
+}
+
+JsonValue *json_parse(const char *text, size_t len) {
+    JsonParser ps = { text, text + len, false };
+    return parse_value(&ps);
+}
+
+void json_free(JsonValue *v) {
+    if (v == NULL) return;
+    for (int i = 0; i < v->count; i++) {
+        json_free(v->items[i]);
+        if (v->keys) free(v->keys[i]);
+    }
+    free(v->items);
+    free(v->keys);
+    free(v->str);
+    free(v);
+}
+
+JsonValue *json_get(const JsonValue *obj, const char *key) {
+    if (obj == NULL || obj->type != JSON_OBJECT) return NULL;
+    for (int i = 0; i < obj->count; i++) {
+        if (strcmp(obj->keys[i], key) == 0) return obj->items[i];
+    }
+    return NULL;
+}
+
+const char *json_get_string(const JsonValue *obj, const char *key) {
+    JsonValue *v = json_get(obj, key);
+    return (v && v->type == JSON_STRING) ? v->str : NULL;
+}
+
+double json_get_number(const JsonValue *obj, const char *key, double def) {
+    JsonValue *v = json_get(obj, key);
+    return (v && v->type == JSON_NUMBER) ? v->number : def;
+}
+
+void json_write_string(FILE *fp, const char *s, int len) {
+    fputc('"', fp);
+    for (int i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        switch (c) {
+            case '"':  fputs("\\\"", fp); break;
+            case '\\': fputs("\\\\", fp); break;
+            case '\n': fputs("\\n", fp); break;
+            case '\r': fputs("\\r", fp); break;
+            case '\t': fputs("\\t", fp); break;
+            default:
+                if (c < 0x20) fprintf(fp, "\\u%04x", c);
+                else fputc(c, fp);
+        }
+    }
+    fputc('"', fp);
+}
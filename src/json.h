@@ -0,0 +1,45 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// 診断サーバのメッセージ用の最小限の JSON 実装
+
+typedef enum {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+} JsonType;
+
+typedef struct JsonValue JsonValue;
+
+struct JsonValue {
+    JsonType type;
+    bool boolean;
+    double number;
+    char *str;         // JSON_STRING (UTF-8, NUL 終端)
+    int str_len;
+    char **keys;       // JSON_OBJECT のキー
+    JsonValue **items; // JSON_ARRAY の要素 / JSON_OBJECT の値
+    int count;
+};
+
+// 解析に失敗した場合は NULL を返す
+JsonValue *json_parse(const char *text, size_t len);
+void json_free(JsonValue *v);
+
+// オブジェクトのメンバを取得する (無ければ NULL)
+JsonValue *json_get(const JsonValue *obj, const char *key);
+// 文字列・数値メンバの取得 (型が違えば def / NULL)
+const char *json_get_string(const JsonValue *obj, const char *key);
+double json_get_number(const JsonValue *obj, const char *key, double def);
+
+// 文字列を JSON の文字列リテラルとして書き出す
+void json_write_string(FILE *fp, const char *s, int len);
+
+#endif
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench-util.h"
+#include "lexer.h"
+#include "context.h"
+
+// 全種類のトークンを含む文を繰り返した入力を生成する
+static void generate_input(FILE *fp, int blocks) {
+    fprintf(fp, "メイン｛\n");
+    fprintf(fp, "　　”合計”を「０」で宣言する。\n");
+    for (int i = 0; i < blocks; i++) {
+        if (i % 10 == 0) {
+            fprintf(fp, "　　＄＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝\n");
+            fprintf(fp, "　　　　セクション%d：自動生成されたブロックの見出しコメント\n", i / 10);
+            fprintf(fp, "　　＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＝＄\n");
+        }
+        fprintf(fp, "　　＃　ブロック%d\n", i);
+        fprintf(fp, "　　”変数%d”を「%d」で宣言する。\n", i, i % 100);
+        fprintf(fp, "　　”変数%d”に「１．５」をたす。\n", i);
+        fprintf(fp, "　　”変数%d”から「２」をひく。\n", i);
+        fprintf(fp, "　　”変数%d”に「３」をかける。\n", i);
+        fprintf(fp, "　　”変数%d”を「４」でわる。\n", i);
+        fprintf(fp, "　　ループ（”変数%d”が「５０」以上か　かつ　”合計”が「１０００」より小さいか）｛\n", i);
+        fprintf(fp, "　　　　”合計”に”変数%d”を代入する。\n", i);
+        fprintf(fp, "　　｝\n");
+        fprintf(fp, "　　もし（”変数%d”が「１」と一緒か　または　”変数%d”が「２」と違うか）｛\n", i, i);
+        fprintf(fp, "　　　　”合計”に入力する。\n");
+        fprintf(fp, "　　｝\n");
+        fprintf(fp, "　　ではなく（”変数%d”が「３」以下か）｛\n", i);
+        fprintf(fp, "　　　　「値は”変数%d”です」と出力する。\n", i);
+        fprintf(fp, "　　｝\n");
+        fprintf(fp, "　　ではない｛\n");
+        fprintf(fp, "　　　　”合計”が「４」より大きいか。\n");
+        fprintf(fp, "　　｝\n");
+    }
+    fprintf(fp, "｝\n");
+}
+
+int main(int argc, char *argv[]) {
+    int blocks = argc > 1 ? atoi(argv[1]) : 50000;
+    int runs = 5;
+
+    FILE *fp = tmpfile();
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Cannot create temporary file\n");
+        return 1;
+    }
+    generate_input(fp, blocks);
+    fflush(fp);
+    long bytes = ftell(fp);
+
+    double best = 0;
+    long count = 0;
+    for (int r = 0; r < runs; r++) {
+        rewind(fp);
+        JpcContext *ctx = new_context();
+        count = 0;
+        double start = bench_now();
+        if (!initLexer(ctx, fp)) {
+            print_errors(ctx, stderr);
+            return 1;
+        }
+        getNextToken(ctx);
+        while (ctx->current_token.type != TK_EOF) {
+            count++;
+            getNextToken(ctx);
+        }
+        double elapsed = bench_now() - start;
+        free_context(ctx);
+        if (r == 0 || elapsed < best) best = elapsed;
+    }
+
+    printf("=== Lexer Bench: %ld bytes, %ld tokens ===\n", bytes, count);
+    printf("best of %d: %.3f ms, %.2f Mtokens/s, %.1f MB/s\n",
+           runs, best * 1e3, count / best / 1e6, bytes / best / 1e6);
+
+    fclose(fp);
+    return 0;
+}
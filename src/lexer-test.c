@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "lexer.h"
+#include "context.h"
 
 int main(int argc, char *argv[]) {
     if (argc < 2) {
@@ -16,30 +17,31 @@ int main(int argc, char *argv[]) {
 
     printf("=== Lexer Test Start: Reading %s ===\n", argv[1]);
 
+    JpcContext *ctx = new_context();
+    if (!initLexer(ctx, fp)) {
+        print_errors(ctx, stderr);
+        return 1;
+    }
+
     // ★最初のトークンを先読み
-    getNextToken(fp);
+    getNextToken(ctx);
 
     int count = 0;
-    // ★ループ条件：getNextTokenの戻り値ではなく、グローバル変数をチェック
-    while (current_token.type != TK_EOF) {
-        printf("[%03d] Token: %-30s", ++count, getTokenName(current_token.type));
+    // ★ループ条件：getNextTokenの戻り値ではなく、文脈の current_token をチェック
+    while (ctx->current_token.type != TK_EOF) {
+        printf("[%03d] Token: %-30s", ++count, getTokenName(ctx->current_token.type));
         
-        if (current_token.type == TK_VARIABLE || current_token.type == TK_LITERAL || current_token.type == TK_PRINT_LIT) {
-            printf(" Value: %s", current_token.str);
-        }
-        else if (current_token.type == TK_WS) {
-            printf(" (U+3000)");
-        }
-        else if (current_token.type == TK_LN) {
-            printf(" (\\n)");
+        if (ctx->current_token.type == TK_VARIABLE || ctx->current_token.type == TK_LITERAL || ctx->current_token.type == TK_PRINT_LIT) {
+            printf(" Value: %.*s", ctx->current_token.len, getTokenText(ctx, &ctx->current_token));
         }
         printf("\n");
 
         // ★次へ進む
-        getNextToken(fp);
+        getNextToken(ctx);
     }
 
     printf("=== Lexer Test End ===\n");
+    free_context(ctx);
     fclose(fp);
     return 0;
 }
\ No newline at end of file
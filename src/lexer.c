@@ -3,75 +3,351 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <setjmp.h>
+#include <pthread.h>
 #include "lexer.h"
 #include "error.h"
+#include "context.h"
 
-extern int current_line;
-Token current_token;
+// --- ソースバッファ ---
+// ソース全体を1つのバッファに載せ、カーソルで走査する。
+// 通常ファイルは mmap し、パイプなど mmap できない入力は一括で読み込む。
+// 先読みの取り消しはカーソルを戻すだけで済む。
+// 字句解析器の状態はすべて JpcContext に持つ。
 
-static int pushback_buf[20]; 
-static int pushback_count = 0;
+static void readWholeFile(JpcContext *ctx, FILE *fp) {
+    size_t cap = 4096, len = 0;
+    unsigned char *buf = malloc(cap);
+    if (buf == NULL) error(ctx, ERR_SYSTEM, "メモリを確保できません");
+    size_t n;
+    while ((n = fread(buf + len, 1, cap - len, fp)) > 0) {
+        len += n;
+        if (len == cap) {
+            cap *= 2;
+            buf = realloc(buf, cap);
+            if (buf == NULL) error(ctx, ERR_SYSTEM, "メモリを確保できません");
+        }
+    }
+    ctx->src_begin = buf;
+    ctx->src_end = buf + len;
+    ctx->src_mapped_len = 0;
+    ctx->src_owned = true;
+}
 
-int getCh(FILE *fp) {
-    int c;
-    if (pushback_count > 0) {
-        c = pushback_buf[--pushback_count];
-    } else {
-        if (fp == NULL) return EOF;
-        do {
-            c = fgetc(fp);
-        } while (c == '\r');
-    }
-    if (c == '\n') current_line++;
+static void loadSource(JpcContext *ctx, FILE *fp);
+static void lexToken(JpcContext *ctx);
+static void tokenize(JpcContext *ctx);
+
+// ソースを読み込み、全体をトークン列にする
+// 字句解析エラーの場合は ctx にエラーを記録して false を返す
+bool initLexer(JpcContext *ctx, FILE *fp) {
+    return loadLexerSource(ctx, fp) && tokenizeSource(ctx);
+}
+
+// ソースを読み込むだけで、トークン列は作らない (読み込んだ内容は ctx->src_begin から)
+// 読み込めない場合は ctx にエラーを記録して false を返す
+bool loadLexerSource(JpcContext *ctx, FILE *fp) {
+    jmp_buf env;
+    jmp_buf *prev = ctx->error_jmp;
+    closeLexer(ctx);
+    ctx->error_jmp = &env;
+    if (setjmp(env) != 0) {
+        ctx->error_jmp = prev;
+        return false;
+    }
+    loadSource(ctx, fp);
+    ctx->error_jmp = prev;
+    return true;
+}
+
+// 読み込み済みのソース全体をトークン列にする
+// 字句解析エラーの場合は ctx にエラーを記録して false を返す
+bool tokenizeSource(JpcContext *ctx) {
+    jmp_buf env;
+    jmp_buf *prev = ctx->error_jmp;
+    ctx->error_jmp = &env;
+    if (setjmp(env) != 0) {
+        ctx->error_jmp = prev;
+        return false;
+    }
+    tokenize(ctx);
+    ctx->error_jmp = prev;
+    return true;
+}
+
+static void loadSource(JpcContext *ctx, FILE *fp) {
+    struct stat st;
+    int fd = fileno(fp);
+    if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            ctx->src_begin = p;
+            ctx->src_end = ctx->src_begin + st.st_size;
+            ctx->src_mapped_len = (size_t)st.st_size;
+            ctx->src_owned = true;
+            ctx->src_cur = ctx->src_begin;
+            return;
+        }
+    }
+    readWholeFile(ctx, fp);
+    ctx->src_cur = ctx->src_begin;
+}
+
+// ソースバッファとトークン列を解放する (インターン済み文字列は残る)
+void closeLexer(JpcContext *ctx) {
+    free(ctx->token_list);
+    ctx->token_list = NULL;
+    ctx->token_count = ctx->token_pos = 0;
+    if (ctx->src_begin == NULL) return;
+    if (ctx->src_owned) {
+        if (ctx->src_mapped_len > 0) munmap((void *)ctx->src_begin, ctx->src_mapped_len);
+        else free((void *)ctx->src_begin);
+    }
+    ctx->src_begin = ctx->src_end = ctx->src_cur = NULL;
+    ctx->src_mapped_len = 0;
+    ctx->src_owned = false;
+}
+
+// メモリ上のソースを字句解析対象にする (buf は呼び出し側が保持し続ける)
+// トークン列は作らない。全体を字句解析するには initLexerBuffer を使う
+void setLexerSource(JpcContext *ctx, const char *buf, size_t len) {
+    closeLexer(ctx);
+    ctx->src_begin = (const unsigned char *)buf;
+    ctx->src_end = ctx->src_begin + len;
+    ctx->src_cur = ctx->src_begin;
+}
+
+// メモリ上のソース全体をトークン列にする (buf は呼び出し側が保持し続ける)
+// 字句解析エラーの場合は ctx にエラーを記録して false を返す
+bool initLexerBuffer(JpcContext *ctx, const char *buf, size_t len) {
+    jmp_buf env;
+    jmp_buf *prev = ctx->error_jmp;
+    setLexerSource(ctx, buf, len);
+    ctx->error_jmp = &env;
+    if (setjmp(env) != 0) {
+        ctx->error_jmp = prev;
+        return false;
+    }
+    tokenize(ctx);
+    ctx->error_jmp = prev;
+    return true;
+}
+
+// トークン文字列の先頭 (NUL 終端されない。長さは tok->len)
+const char *getTokenText(JpcContext *ctx, const Token *tok) {
+    return (const char *)ctx->src_begin + tok->offset;
+}
+
+// --- 文字列インターン ---
+// 変数名などのトークン文字列は、同じ内容の NUL 終端コピーを1つだけ作って共有する。
+// 文字列は文脈のアリーナに置き、文脈を解放するまで保持する (closeLexer 後も有効)
+struct InternEntry {
+    const char *str;
+    int len;
+    unsigned int hash;
+};
+
+
+static unsigned int hashBytes(const char *s, int len) {
+    unsigned int h = 2166136261u; // FNV-1a
+    for (int i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void growInternTable(JpcContext *ctx) {
+    int new_cap = ctx->intern_cap ? ctx->intern_cap * 2 : 1024;
+    InternEntry *table = calloc(new_cap, sizeof(InternEntry));
+    if (table == NULL) error(ctx, ERR_SYSTEM, "メモリを確保できません");
+    for (int i = 0; i < ctx->intern_cap; i++) {
+        if (ctx->intern_table[i].str == NULL) continue;
+        int j = ctx->intern_table[i].hash & (new_cap - 1);
+        while (table[j].str) j = (j + 1) & (new_cap - 1);
+        table[j] = ctx->intern_table[i];
+    }
+    free(ctx->intern_table);
+    ctx->intern_table = table;
+    ctx->intern_cap = new_cap;
+}
+
+const char *internString(JpcContext *ctx, const char *s, int len) {
+    if (ctx->intern_used * 2 >= ctx->intern_cap) growInternTable(ctx);
+    unsigned int h = hashBytes(s, len);
+    int i = h & (ctx->intern_cap - 1);
+    while (ctx->intern_table[i].str) {
+        InternEntry *e = &ctx->intern_table[i];
+        if (e->hash == h && e->len == len && memcmp(e->str, s, len) == 0) return e->str;
+        i = (i + 1) & (ctx->intern_cap - 1);
+    }
+    char *copy = arena_strndup(&ctx->strings, s, len);
+    if (copy == NULL) error(ctx, ERR_SYSTEM, "メモリを確保できません");
+    ctx->intern_table[i].str = copy;
+    ctx->intern_table[i].len = len;
+    ctx->intern_table[i].hash = h;
+    ctx->intern_used++;
+    return copy;
+}
+
+// トークン文字列をインターンし、NUL 終端された共有文字列を返す
+const char *internToken(JpcContext *ctx, const Token *tok) {
+    return internString(ctx, getTokenText(ctx, tok), tok->len);
+}
+
+int getCh(JpcContext *ctx) {
+    while (ctx->src_cur < ctx->src_end && *ctx->src_cur == '\r') ctx->src_cur++;
+    if (ctx->src_cur >= ctx->src_end) return EOF;
+    int c = *ctx->src_cur++;
+    if (c == '\n') ctx->current_line++;
     return c;
 }
 
-void ungetCh(int c) {
-    if (c == '\n') current_line--;
-    if (c != EOF && pushback_count < 20) {
-        pushback_buf[pushback_count++] = c;
-    } else if (pushback_count >= 20) {
-        error(ERR_SYSTEM, "プッシュバックバッファがオーバーフローしました");
-    }
-}
-
-int checkCommentOut(FILE *fp, int c) {
-    if (c == 0xEF) {
-        int next1 = getCh(fp);
-        if (next1 == 0xBC) {
-            int next2 = getCh(fp);
-            if (next2 == 0x83) { // 行コメント
-                while ((c = getCh(fp)) != '\n' && c != EOF);
-                return 1;
-            } else if (next2 == 0x84) { // ブロックコメント
-                while (1) {
-                    c = getCh(fp);
-                    if (c == EOF) break;
-                    if (c == 0xEF) {
-                        int n1 = getCh(fp);
-                        if (n1 == 0xBC) {
-                            int n2 = getCh(fp);
-                            if (n2 == 0x84) {
-                                c = getCh(fp);
-                                if (c != '\n' && c != EOF) ungetCh(c);
-                                break;
-                            }
-                            ungetCh(n2); ungetCh(n1);
-                        } else { ungetCh(n1); }
-                    }
-                }
-                return 1;
-            }
-            ungetCh(next2); ungetCh(next1);
-            return 0;
+// 直前に getCh で読んだ1バイトを戻す
+void ungetCh(JpcContext *ctx, int c) {
+    if (c == EOF) return;
+    if (c == '\n') ctx->current_line--;
+    ctx->src_cur--;
+}
+
+// --- 空白・コメントの読み飛ばし ---
+// SSE2/AVX2 が使えるときは 16/32 バイト単位で比較し、ビットマスクで読み飛ばす範囲と改行数を求める。
+// ブロック末尾にかかる全角空白・＄は次のブロックで判定し直す。残りはスカラーで処理する。
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCAN_WIDTH 32
+typedef __m256i ScanVec;
+static inline ScanVec scanLoad(const unsigned char *p) { return _mm256_loadu_si256((const __m256i *)p); }
+static inline uint32_t scanEq(ScanVec v, unsigned char c) {
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8((char)c)));
+}
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SCAN_WIDTH 16
+typedef __m128i ScanVec;
+static inline ScanVec scanLoad(const unsigned char *p) { return _mm_loadu_si128((const __m128i *)p); }
+static inline uint32_t scanEq(ScanVec v, unsigned char c) {
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8((char)c)));
+}
+#endif
+
+#ifdef SCAN_WIDTH
+// 下位 n ビットが立ったマスク
+static inline uint32_t lowBits(int n) { return n >= 32 ? 0xFFFFFFFFu : (1u << n) - 1; }
+#endif
+
+// 全角空白・半角空白・タブ・改行を読み飛ばし、フラグと行番号を更新する
+static void skipBlanks(JpcContext *ctx, bool *has_space, bool *has_newline) {
+#ifdef SCAN_WIDTH
+    while (ctx->src_end - ctx->src_cur >= SCAN_WIDTH) {
+        ScanVec v = scanLoad(ctx->src_cur);
+        uint32_t nl = scanEq(v, '\n');
+        uint32_t sp = scanEq(v, ' ') | scanEq(v, '\t');
+        uint32_t x80 = scanEq(v, 0x80);
+        // 全角空白 (E3 80 80) の先頭位置
+        uint32_t fw = scanEq(v, 0xE3) & (x80 >> 1) & (x80 >> 2);
+        uint32_t blank = (nl | sp | scanEq(v, '\r') | fw | (fw << 1) | (fw << 2)) & lowBits(SCAN_WIDTH);
+        int run = blank == lowBits(SCAN_WIDTH) ? SCAN_WIDTH : __builtin_ctz(~blank);
+        uint32_t in_run = lowBits(run);
+        if (nl & in_run) {
+            *has_newline = true;
+            ctx->current_line += __builtin_popcount(nl & in_run);
+        }
+        if ((sp | fw) & in_run) *has_space = true;
+        ctx->src_cur += run;
+        // 末尾2バイト以内で止まった場合は全角空白が途切れている可能性があるので読み直す
+        if (run < SCAN_WIDTH - 2) return;
+    }
+#endif
+    while (ctx->src_cur < ctx->src_end) {
+        unsigned char c = *ctx->src_cur;
+        if (c == '\n') {
+            *has_newline = true;
+            ctx->current_line++;
+            ctx->src_cur++;
+        } else if (c == ' ' || c == '\t') {
+            *has_space = true;
+            ctx->src_cur++;
+        } else if (c == '\r') {
+            ctx->src_cur++;
+        } else if (c == 0xE3 && ctx->src_end - ctx->src_cur >= 3 && ctx->src_cur[1] == 0x80 && ctx->src_cur[2] == 0x80) {
+            *has_space = true;
+            ctx->src_cur += 3;
+        } else {
+            break;
+        }
+    }
+}
+
+// 行コメントの終わり（改行の直後、またはファイル終端）まで進める
+static void skipLineComment(JpcContext *ctx) {
+#ifdef SCAN_WIDTH
+    while (ctx->src_end - ctx->src_cur >= SCAN_WIDTH) {
+        uint32_t nl = scanEq(scanLoad(ctx->src_cur), '\n');
+        if (nl) {
+            ctx->src_cur += __builtin_ctz(nl) + 1;
+            ctx->current_line++;
+            return;
+        }
+        ctx->src_cur += SCAN_WIDTH;
+    }
+#endif
+    int c;
+    while ((c = getCh(ctx)) != '\n' && c != EOF);
+}
+
+// 閉じの＄ (EF BC 84) の直後まで進め、途中の改行を数える
+static void skipBlockComment(JpcContext *ctx) {
+#ifdef SCAN_WIDTH
+    while (ctx->src_end - ctx->src_cur >= SCAN_WIDTH) {
+        ScanVec v = scanLoad(ctx->src_cur);
+        uint32_t nl = scanEq(v, '\n');
+        uint32_t end = scanEq(v, 0xEF) & (scanEq(v, 0xBC) >> 1) & (scanEq(v, 0x84) >> 2);
+        if (end) {
+            int k = __builtin_ctz(end);
+            ctx->current_line += __builtin_popcount(nl & lowBits(k));
+            ctx->src_cur += k + 3;
+            return;
+        }
+        // 末尾2バイトにかかる＄は次のブロックで見つける
+        ctx->current_line += __builtin_popcount(nl & lowBits(SCAN_WIDTH - 2));
+        ctx->src_cur += SCAN_WIDTH - 2;
+    }
+#endif
+    int c;
+    while ((c = getCh(ctx)) != EOF) {
+        if (c == 0xEF && ctx->src_end - ctx->src_cur >= 2 && ctx->src_cur[0] == 0xBC && ctx->src_cur[1] == 0x84) {
+            ctx->src_cur += 2;
+            return;
         }
-        ungetCh(next1);
+    }
+}
+
+// カーソル位置の＃（行コメント）・＄（ブロックコメント）を読み飛ばす
+// コメントを消費した場合は1を返す
+int checkCommentOut(JpcContext *ctx) {
+    if (ctx->src_end - ctx->src_cur < 3 || ctx->src_cur[0] != 0xEF || ctx->src_cur[1] != 0xBC) return 0;
+    if (ctx->src_cur[2] == 0x83) { // 行コメント
+        ctx->src_cur += 3;
+        skipLineComment(ctx);
+        return 1;
+    }
+    if (ctx->src_cur[2] == 0x84) { // ブロックコメント
+        ctx->src_cur += 3;
+        skipBlockComment(ctx);
+        // 閉じの＄の直後の改行はコメントの一部として扱う
+        int c = getCh(ctx);
+        if (c != '\n' && c != EOF) ungetCh(ctx, c);
+        return 1;
     }
     return 0;
 }
 
-int readUTF8Char(FILE *fp, char *buf) {
-    int c = getCh(fp);
+int readUTF8Char(JpcContext *ctx, char *buf) {
+    int c = getCh(ctx);
     if (c == EOF) return 0;
     unsigned char uc = (unsigned char)c;
     int len = 1;
@@ -80,33 +356,14 @@ int readUTF8Char(FILE *fp, char *buf) {
     else if ((uc & 0xF8) == 0xF0) len = 4;
     buf[0] = (char)c;
     for (int i = 1; i < len; i++) {
-        int next = getCh(fp);
-        if (next == EOF) break; 
+        int next = getCh(ctx);
+        if (next == EOF) { len = i; break; }
         buf[i] = (char)next;
     }
     buf[len] = '\0';
     return 1;
 }
 
-int checkKeyword(FILE *fp, const char *expect) {
-    char readBuf[100]; 
-    int readCount = 0; 
-    char charBuf[5];
-    const char *p = expect;
-    while (*p != '\0') {
-        if (!readUTF8Char(fp, charBuf)) break; 
-        int charLen = strlen(charBuf);
-        for(int i=0; i<charLen; i++) readBuf[readCount++] = charBuf[i];
-        if (strncmp(p, charBuf, strlen(charBuf)) != 0) break; 
-        p += strlen(charBuf);
-    }
-    if (*p == '\0') return 1;
-    else {
-        for (int i = readCount - 1; i >= 0; i--) ungetCh((unsigned char)readBuf[i]);
-        return 0;
-    }
-}
-
 int convertZenkakuNum(const char *utf8_char, char *out) {
     unsigned char u0 = (unsigned char)utf8_char[0];
     unsigned char u1 = (unsigned char)utf8_char[1];
@@ -182,226 +439,341 @@ const char* getTokenName(TokenType type) {
     }
 }
 
-void getNextToken(FILE *fp) {
+// --- キーワード認識 (DFA) ---
+// 記号・助詞・キーワードを1つの DFA にまとめ、先頭から1回の走査で最長一致を求める。
+// 遷移表はコードポイントを文字クラスに写してから引く。表は初回使用時に keywords[] から構築する。
+// 表は全文脈で共有する読み取り専用データなので、構築は pthread_once で1回だけ行う。
+static const struct {
+    const char *word;
+    TokenType type;
+} keywords[] = {
+    {"（", TK_LPAR}, {"）", TK_RPAR}, {"｛", TK_LBRACE}, {"｝", TK_RBRACE},
+    {"。", TK_PERIOD}, {"に", TK_NI}, {"が", TK_GA}, {"を", TK_WO}, {"から", TK_KARA},
+    {"メイン", TK_MAIN},
+    {"で宣言する", TK_DECLARE}, {"でわる", TK_DIV}, {"ではなく", TK_ELSEIF}, {"ではない", TK_ELSE},
+    {"を代入する", TK_ASSIGN}, {"をたす", TK_ADD}, {"をかける", TK_MUL}, {"をひく", TK_SUB},
+    {"入力する", TK_INPUT}, {"と出力する", TK_OUTPUT},
+    {"ループ", TK_LOOP}, {"もし", TK_IF},
+    {"以上か", TK_OP_GE}, {"以下か", TK_OP_LE}, {"より大きいか", TK_OP_GT}, {"より小さいか", TK_OP_LT},
+    {"と一緒か", TK_OP_EQ}, {"と違うか", TK_OP_NE},
+    {"かつ", TK_AND}, {"または", TK_OR},
+};
+
+#define KW_MAX_STATES  128
+#define KW_MAX_CLASSES 64
+#define KW_MAX_PAGES   32
+
+static pthread_once_t kw_once = PTHREAD_ONCE_INIT;
+static unsigned char kw_page[256];                     // コードポイント上位8bit -> ページ番号 (0 は該当なし)
+static unsigned char kw_class[KW_MAX_PAGES][256];      // ページ内下位8bit -> 文字クラス (0 はキーワード外)
+static unsigned char kw_trans[KW_MAX_STATES][KW_MAX_CLASSES]; // 状態 x 文字クラス -> 次状態 (0 は遷移なし)
+static signed char kw_accept[KW_MAX_STATES];          // 受理状態なら TokenType、それ以外は -1
+
+// UTF-8 を1文字デコードしてバイト長を返す
+static int decodeUTF8(const unsigned char *p, const unsigned char *end, int *cp) {
+    unsigned char c = p[0];
+    int len = 1;
+    if ((c & 0xE0) == 0xC0) len = 2;
+    else if ((c & 0xF0) == 0xE0) len = 3;
+    else if ((c & 0xF8) == 0xF0) len = 4;
+    if (end - p < len) { *cp = -1; return 1; }
+    switch (len) {
+        case 1:  *cp = c; break;
+        case 2:  *cp = ((c & 0x1F) << 6) | (p[1] & 0x3F); break;
+        case 3:  *cp = ((c & 0x0F) << 12) | ((p[1] & 0x3F) << 6) | (p[2] & 0x3F); break;
+        default: *cp = ((c & 0x07) << 18) | ((p[1] & 0x3F) << 12) | ((p[2] & 0x3F) << 6) | (p[3] & 0x3F); break;
+    }
+    return len;
+}
+
+static int charClass(int cp) {
+    if (cp < 0 || cp > 0xFFFF) return 0;
+    return kw_class[kw_page[cp >> 8]][cp & 0xFF];
+}
+
+// keywords[] が表の上限を超えた場合 (プログラムの誤りなので続行しない)
+static void keywordTableOverflow(const char *msg) {
+    fprintf(stderr, "%s\n", msg);
+    abort();
+}
+
+static void buildKeywordTable(void) {
+    int n_states = 1, n_classes = 1, n_pages = 1;
+    memset(kw_accept, -1, sizeof(kw_accept));
+    for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
+        const unsigned char *p = (const unsigned char *)keywords[i].word;
+        const unsigned char *end = p + strlen(keywords[i].word);
+        int state = 0;
+        while (p < end) {
+            int cp;
+            p += decodeUTF8(p, end, &cp);
+            if (kw_page[cp >> 8] == 0) {
+                if (n_pages >= KW_MAX_PAGES) keywordTableOverflow("キーワード表のページ数が上限を超えました");
+                kw_page[cp >> 8] = n_pages++;
+            }
+            unsigned char *cls = &kw_class[kw_page[cp >> 8]][cp & 0xFF];
+            if (*cls == 0) {
+                if (n_classes >= KW_MAX_CLASSES) keywordTableOverflow("キーワード表の文字クラス数が上限を超えました");
+                *cls = n_classes++;
+            }
+            if (kw_trans[state][*cls] == 0) {
+                if (n_states >= KW_MAX_STATES) keywordTableOverflow("キーワード表の状態数が上限を超えました");
+                kw_trans[state][*cls] = n_states++;
+            }
+            state = kw_trans[state][*cls];
+        }
+        kw_accept[state] = keywords[i].type;
+    }
+}
+
+// start から始まるキーワードを最長一致で認識し、カーソルをその直後へ進める。
+// 先頭の文字がどのキーワードにも現れなければ -1 を返す（カーソルは動かない）
+static int scanKeyword(JpcContext *ctx, const unsigned char *start) {
+    pthread_once(&kw_once, buildKeywordTable);
+    const unsigned char *p = start, *accept_end = NULL;
+    int state = 0, accept = -1;
+    while (p < ctx->src_end) {
+        int cp;
+        int n = decodeUTF8(p, ctx->src_end, &cp);
+        int next = kw_trans[state][charClass(cp)];
+        if (next == 0) break;
+        state = next;
+        p += n;
+        if (kw_accept[state] >= 0) {
+            accept = kw_accept[state];
+            accept_end = p;
+        }
+    }
+    if (state == 0) return -1;
+    if (accept < 0) {
+        int cp;
+        int n = decodeUTF8(start, ctx->src_end, &cp);
+        error(ctx, ERR_LEXER, "「%.*s」で始まる不明なキーワードです -> %.*s", n, (const char *)start, n, (const char *)start);
+    }
+    ctx->src_cur = accept_end;
+    return accept;
+}
+
+// 数値リテラル（TK_LITERAL）のスライスを数値に変換する
+double getTokenValue(JpcContext *ctx, const Token *tok) {
+    char small[64];
+    char *numStr = tok->len < (int)sizeof(small) ? small : malloc(tok->len + 1);
+    if (numStr == NULL) error(ctx, ERR_SYSTEM, "メモリを確保できません");
+    int n = 0;
+    const char *p = getTokenText(ctx, tok), *end = p + tok->len;
+    while (p < end) {
+        char converted;
+        if (convertZenkakuNum(p, &converted) || convertZenkakuDot(p, &converted) || convertZenkakuMinus(p, &converted)) {
+            numStr[n++] = converted;
+            p += 3;
+        } else {
+            numStr[n++] = *p++;
+        }
+    }
+    numStr[n] = '\0';
+    double val = atof(numStr);
+    if (numStr != small) free(numStr);
+    return val;
+}
+
+// ソース全体をトークン列 token_list にする
+static void tokenize(JpcContext *ctx) {
+    if (ctx->src_end - ctx->src_begin > 0x7FFFFFFF) error(ctx, ERR_SYSTEM, "ソースファイルが大きすぎます");
+    int cap = (int)((ctx->src_end - ctx->src_begin) / 8) + 16;
+    ctx->token_list = malloc(sizeof(Token) * cap);
+    if (ctx->token_list == NULL) error(ctx, ERR_SYSTEM, "メモリを確保できません");
+    ctx->token_count = ctx->token_pos = 0;
+    do {
+        lexToken(ctx);
+        if (ctx->token_count == cap) {
+            cap *= 2;
+            ctx->token_list = realloc(ctx->token_list, sizeof(Token) * cap);
+            if (ctx->token_list == NULL) error(ctx, ERR_SYSTEM, "メモリを確保できません");
+        }
+        ctx->token_list[ctx->token_count++] = ctx->current_token;
+    } while (ctx->current_token.type != TK_EOF);
+}
+
+// offset から end_offset までのトークンを *list に追加していく
+static int lexRange(JpcContext *ctx, int offset, int end_offset, int line, Token **list) {
+    int cap = 64, n = 0;
+    *list = malloc(sizeof(Token) * cap);
+    if (*list == NULL) error(ctx, ERR_SYSTEM, "メモリを確保できません");
+    const unsigned char *region_end = ctx->src_begin + end_offset;
+    ctx->src_cur = ctx->src_begin + offset;
+    ctx->current_line = line;
+    while (ctx->src_cur < region_end) {
+        lexToken(ctx);
+        if (ctx->current_token.type == TK_EOF) break;
+        if (n == cap) {
+            cap *= 2;
+            Token *grown = realloc(*list, sizeof(Token) * cap);
+            if (grown == NULL) error(ctx, ERR_SYSTEM, "メモリを確保できません");
+            *list = grown;
+        }
+        (*list)[n++] = ctx->current_token;
+    }
+    return n;
+}
+
+// ソースの offset から end_offset までを字句解析し、トークン配列を返す (line は offset の行番号)
+// 字句解析エラーの場合、または範囲の終端がトークンの境界と一致しない場合は NULL を返す
+Token *lexRegion(JpcContext *ctx, int offset, int end_offset, int line, int *count) {
+    jmp_buf env;
+    jmp_buf *prev = ctx->error_jmp;
+    Token *list = NULL;
+    ctx->error_jmp = &env;
+    if (setjmp(env) != 0) {
+        ctx->error_jmp = prev;
+        free(list);
+        return NULL;
+    }
+    int n = lexRange(ctx, offset, end_offset, line, &list);
+    ctx->error_jmp = prev;
+    if (ctx->src_cur != ctx->src_begin + end_offset) {
+        free(list);
+        return NULL;
+    }
+    *count = n;
+    return list;
+}
+
+// トークン列の読み出し位置を pos に移し、そのトークンを current_token に読み込む
+void seekToken(JpcContext *ctx, int pos) {
+    ctx->token_pos = pos;
+    getNextToken(ctx);
+}
+
+// current_token のトークン列上の位置
+int tellToken(JpcContext *ctx) {
+    return ctx->token_pos > 0 && ctx->current_token.type != TK_EOF ? ctx->token_pos - 1 : ctx->token_count - 1;
+}
+
+// 次のトークンを current_token に読み込む (末尾では TK_EOF を返し続ける)
+// 事前に initLexer / initLexerBuffer でトークン列を作っておくこと
+void getNextToken(JpcContext *ctx) {
+    ctx->current_token = ctx->token_list[ctx->token_pos];
+    if (ctx->token_pos < ctx->token_count - 1) ctx->token_pos++;
+}
+
+// ソースから1トークンを読み、current_token に書き込む
+static void lexToken(JpcContext *ctx) {
     char charBuf[5];
     // 独立したboolフラグを使用
     bool has_space = false;
     bool has_newline = false;
+    const unsigned char *start;
 
     // 1. スキップループ
     while (1) {
-        int line_before = current_line;
+        int line_before = ctx->current_line;
 
-        if (!readUTF8Char(fp, charBuf)) {
-            current_token.type = TK_EOF;
-            current_token.has_space_before = has_space;
-            current_token.has_newline_before = has_newline;
-            return;
-        }
-
-        // 全角空白
-        if (strcmp(charBuf, "　") == 0) { 
-            has_space = true; 
-            continue; 
-        }
-        // 改行
-        if (strcmp(charBuf, "\n") == 0) { 
-            has_newline = true; 
-            continue; 
-        }
-        // 半角空白・タブ
-        if (charBuf[0] == ' ' || charBuf[0] == '\t') { 
-            has_space = true; 
-            continue; 
-        }
+        skipBlanks(ctx, &has_space, &has_newline);
 
         // コメント判定
-        unsigned char u0 = (unsigned char)charBuf[0];
-        if (u0 == 0xEF) {
-            for (int i = strlen(charBuf) - 1; i >= 0; i--) ungetCh((unsigned char)charBuf[i]);
-            int c = getCh(fp);
-            
-            if (checkCommentOut(fp, c)) {
-                // コメントは空白扱い
-                has_space = true;
-                // コメント内で行が進んでいれば改行扱い
-                if (current_line > line_before) {
-                    has_newline = true;
-                }
-                continue;
-            }
-            ungetCh(c); 
-            if (!readUTF8Char(fp, charBuf)) {
-                current_token.type = TK_EOF;
-                current_token.has_space_before = has_space;
-                current_token.has_newline_before = has_newline;
-                return;
+        if (checkCommentOut(ctx)) {
+            // コメントは空白扱い
+            has_space = true;
+            // コメント内で行が進んでいれば改行扱い
+            if (ctx->current_line > line_before) {
+                has_newline = true;
             }
+            continue;
         }
         
         break;
     }
 
-    // 2. トークンの確定
-    current_token.line = current_line;
-    current_token.has_space_before = has_space;
-    current_token.has_newline_before = has_newline;
-    strcpy(current_token.str, charBuf);
+    start = ctx->src_cur;
+    if (!readUTF8Char(ctx, charBuf)) {
+        ctx->current_token.type = TK_EOF;
+        ctx->current_token.line = ctx->current_line;
+        ctx->current_token.flags = (has_space ? TKF_SPACE_BEFORE : 0) | (has_newline ? TKF_NEWLINE_BEFORE : 0);
+        ctx->current_token.offset = (int)(ctx->src_cur - ctx->src_begin);
+        ctx->current_token.len = 0;
+        return;
+    }
 
+    // 2. トークンの確定
+    // トークン文字列はソースバッファへのスライスとして持つ（コピーしない）
+    ctx->current_token.line = ctx->current_line;
+    ctx->current_token.flags = (has_space ? TKF_SPACE_BEFORE : 0) | (has_newline ? TKF_NEWLINE_BEFORE : 0);
+    ctx->current_token.offset = (int)(start - ctx->src_begin);
+    // 字句解析エラーは先頭の1文字を指す
+    ctx->current_token.len = (int)(ctx->src_cur - start);
     // --- 記号・助詞・キーワード判定 ---
-    if (strcmp(charBuf, "（") == 0) { current_token.type = TK_LPAR; return; }
-    if (strcmp(charBuf, "）") == 0) { current_token.type = TK_RPAR; return; }
-    if (strcmp(charBuf, "｛") == 0) { current_token.type = TK_LBRACE; return; }
-    if (strcmp(charBuf, "｝") == 0) { current_token.type = TK_RBRACE; return; }
-    if (strcmp(charBuf, "。") == 0) { current_token.type = TK_PERIOD; return; }
-    if (strcmp(charBuf, "に") == 0) { current_token.type = TK_NI; return; }
-    if (strcmp(charBuf, "が") == 0) { current_token.type = TK_GA; return; }
-    
-    if (strcmp(charBuf, "メ") == 0) { 
-        if (checkKeyword(fp, "イン")) { current_token.type = TK_MAIN; return; }
-        error(ERR_LEXER, "「メ」で始まる不明なキーワードです -> %s", charBuf);
-    }
-    if (strcmp(charBuf, "で") == 0) {
-        if (checkKeyword(fp, "宣言する")) { current_token.type = TK_DECLARE; return; }
-        if (checkKeyword(fp, "わる"))     { current_token.type = TK_DIV; return; }
-        if (checkKeyword(fp, "は")) { 
-            if (checkKeyword(fp, "なく")) { current_token.type = TK_ELSEIF; return; }
-            if (checkKeyword(fp, "ない")) { current_token.type = TK_ELSE; return; }
-            error(ERR_LEXER, "「で」で始まる不明なキーワードです -> %s", charBuf);
-        }
-        error(ERR_LEXER, "「で」で始まる不明なキーワードです -> %s", charBuf);
-    }
-    if (strcmp(charBuf, "を") == 0) {
-        if (checkKeyword(fp, "代入する")) { current_token.type = TK_ASSIGN; return; }
-        if (checkKeyword(fp, "たす"))     { current_token.type = TK_ADD; return; }
-        if (checkKeyword(fp, "かける"))   { current_token.type = TK_MUL; return; }
-        if (checkKeyword(fp, "ひく"))     { current_token.type = TK_SUB; return; }
-        current_token.type = TK_WO; return; 
-    }
-    if (strcmp(charBuf, "か") == 0) {
-        if (checkKeyword(fp, "ら")) { current_token.type = TK_KARA; return; }
-        if (checkKeyword(fp, "つ")) { current_token.type = TK_AND; return; }
-        error(ERR_LEXER, "「か」で始まる不明なキーワードです -> %s", charBuf);
-    }
-    if (strcmp(charBuf, "ル") == 0) { 
-        if (checkKeyword(fp, "ープ")) { current_token.type = TK_LOOP; return; }
-        error(ERR_LEXER, "「ル」で始まる不明なキーワードです -> %s", charBuf);
-    }
-    if (strcmp(charBuf, "も") == 0) { 
-        if (checkKeyword(fp, "し")) { current_token.type = TK_IF; return; }
-        error(ERR_LEXER, "「も」で始まる不明なキーワードです -> %s", charBuf);
-    }
-    if (strcmp(charBuf, "入") == 0) { 
-        if (checkKeyword(fp, "力する")) { current_token.type = TK_INPUT; return; }
-        error(ERR_LEXER, "「入」で始まる不明なキーワードです -> %s", charBuf);
-    }
-    if (strcmp(charBuf, "と") == 0) { 
-        if (checkKeyword(fp, "出力する")) { current_token.type = TK_OUTPUT; return; }
-        if (checkKeyword(fp, "一緒か"))   { current_token.type = TK_OP_EQ; return; }
-        if (checkKeyword(fp, "違うか"))   { current_token.type = TK_OP_NE; return; }
-        error(ERR_LEXER, "「と」で始まる不明なキーワードです -> %s", charBuf);
-    }
-    if (strcmp(charBuf, "ま") == 0) { 
-        if (checkKeyword(fp, "たは")) { current_token.type = TK_OR; return; }
-        error(ERR_LEXER, "「ま」で始まる不明なキーワードです -> %s", charBuf);
-    }
-    if (strcmp(charBuf, "以") == 0) {
-        if (checkKeyword(fp, "上か")) { current_token.type = TK_OP_GE; return; }
-        if (checkKeyword(fp, "下か")) { current_token.type = TK_OP_LE; return; }
-        error(ERR_LEXER, "「以」で始まる不明なキーワードです -> %s", charBuf);
-    }
-    if (strcmp(charBuf, "よ") == 0) { 
-        if (checkKeyword(fp, "り")) { 
-            if (checkKeyword(fp, "大きいか")) { current_token.type = TK_OP_GT; return; }
-            if (checkKeyword(fp, "小さいか")) { current_token.type = TK_OP_LT; return; }
-            error(ERR_LEXER, "「より」で始まる不明なキーワードです -> %s", charBuf);
-        }
-        error(ERR_LEXER, "「よ」で始まる不明なキーワードです -> %s", charBuf);
+    int kw = scanKeyword(ctx, start);
+    if (kw >= 0) {
+        ctx->current_token.type = kw;
+        ctx->current_token.len = (int)(ctx->src_cur - start);
+        return;
     }
 
     // --- 変数 ---
+    // ”...” の中身をスライスとして持つ（変数名内部は空白スキップしない）
     if (strcmp(charBuf, "”") == 0) {
-        current_token.type = TK_VARIABLE;
-        current_token.str[0] = '\0';
+        const unsigned char *name = ctx->src_cur;
         while (1) {
-            char tmpBuf[5];
-            int c = getCh(fp);
-            if (c == EOF) error(ERR_LEXER, "変数名の途中でファイルが終了しました");
-            ungetCh(c);
-            
-            // 変数名内部は空白スキップしない (readUTF8Charのロジック)
-            int first = getCh(fp);
-            char utf8Buf[5];
-            int len = 1;
-            unsigned char uc = (unsigned char)first;
-            if ((uc & 0xE0) == 0xC0) len = 2;
-            else if ((uc & 0xF0) == 0xE0) len = 3;
-            else if ((uc & 0xF8) == 0xF0) len = 4;
-            utf8Buf[0] = (char)first;
-            for(int i=1; i<len; i++) utf8Buf[i] = (char)getCh(fp);
-            utf8Buf[len] = '\0';
-            strcpy(tmpBuf, utf8Buf);
-
-            if (strcmp(tmpBuf, "\n") == 0 || strcmp(tmpBuf, "\r") == 0) {
-                error(ERR_LEXER, "変数名の引用符（”）が閉じられていません");
+            int c = getCh(ctx);
+            if (c == EOF) error(ctx, ERR_LEXER, "変数名の途中でファイルが終了しました");
+            if (c == '\n') error(ctx, ERR_LEXER, "変数名の引用符（”）が閉じられていません");
+            // 「”」(E2 80 9D) で終了
+            if (c == 0xE2 && ctx->src_end - ctx->src_cur >= 2 && ctx->src_cur[0] == 0x80 && ctx->src_cur[1] == 0x9D) {
+                ctx->current_token.type = TK_VARIABLE;
+                ctx->current_token.offset = (int)(name - ctx->src_begin);
+                ctx->current_token.len = (int)(ctx->src_cur - 1 - name);
+                ctx->src_cur += 2;
+                return;
             }
-            if (strcmp(tmpBuf, "”") == 0) break;
-            strcat(current_token.str, tmpBuf);
         }
-        return;
     }
 
     // --- リテラル ---
+    // 中身をスライスとして持ち、数値として読めるかどうかだけを1パスで判定する
     if (strcmp(charBuf, "「") == 0) {
-        char rawStr[1024] = ""; 
-        char numStr[1024] = ""; 
+        const unsigned char *content = ctx->src_cur;
+        const unsigned char *content_end;
         int is_pure_number = 1;
         int dot_count = 0; 
+        int num_len = 0;
+        char num_first = 0, num_last = 0;
 
         while (1) {
             char tmpBuf[5];
-            int first = getCh(fp);
-            if (first == EOF) error(ERR_LEXER, "文字列リテラルの途中でEOF");
-            
+            const unsigned char *char_start = ctx->src_cur;
             // リテラル内は空白スキップしない
-            char utf8Buf[5];
-            int len = 1;
-            unsigned char uc = (unsigned char)first;
-            if ((uc & 0xE0) == 0xC0) len = 2;
-            else if ((uc & 0xF0) == 0xE0) len = 3;
-            else if ((uc & 0xF8) == 0xF0) len = 4;
-            utf8Buf[0] = (char)first;
-            for(int i=1; i<len; i++) utf8Buf[i] = (char)getCh(fp);
-            utf8Buf[len] = '\0';
-            strcpy(tmpBuf, utf8Buf);
-
-            if (strcmp(tmpBuf, "\n") == 0 || strcmp(tmpBuf, "\r") == 0) {
-                error(ERR_LEXER, "文字列リテラルの引用符（「）が閉じられていません");
-            }
-            if (strcmp(tmpBuf, "」") == 0) break;
+            if (!readUTF8Char(ctx, tmpBuf)) error(ctx, ERR_LEXER, "文字列リテラルの途中でEOF");
 
-            if (strlen(rawStr) >= 1000) error(ERR_LEXER, "文字列リテラルが長すぎます");
-            strcat(rawStr, tmpBuf);
+            if (tmpBuf[0] == '\n') {
+                error(ctx, ERR_LEXER, "文字列リテラルの引用符（「）が閉じられていません");
+            }
+            if (strcmp(tmpBuf, "」") == 0) { content_end = char_start; break; }
 
-            char converted;
-            if (isdigit(tmpBuf[0])) strncat(numStr, tmpBuf, 1);
-            else if (tmpBuf[0] == '.') { strncat(numStr, tmpBuf, 1); dot_count++; }
-            else if (convertZenkakuNum(tmpBuf, &converted)) strncat(numStr, &converted, 1);
-            else if (convertZenkakuDot(tmpBuf, &converted)) { strncat(numStr, &converted, 1); dot_count++; }
+            char converted = 0;
+            if (isdigit((unsigned char)tmpBuf[0])) converted = tmpBuf[0];
+            else if (tmpBuf[0] == '.') { converted = '.'; dot_count++; }
+            else if (convertZenkakuNum(tmpBuf, &converted)) {}
+            else if (convertZenkakuDot(tmpBuf, &converted)) { dot_count++; }
             // マイナス記号（半角/全角）の処理（先頭のみ許可）
-            else if (strlen(numStr) == 0 && (tmpBuf[0] == '-' || convertZenkakuMinus(tmpBuf, &converted))) { strcat(numStr, "-"); }
+            else if (num_len == 0 && (tmpBuf[0] == '-' || convertZenkakuMinus(tmpBuf, &converted))) { converted = '-'; }
             else is_pure_number = 0;
+
+            if (converted) {
+                if (num_len == 0) num_first = converted;
+                num_last = converted;
+                num_len++;
+            }
         }
         
-        if (is_pure_number && dot_count <= 1 && strlen(numStr) > 0 && numStr[0] != '.' && numStr[strlen(numStr)-1] != '.') {
-            current_token.type = TK_LITERAL;
-            strcpy(current_token.str, numStr);
+        if (is_pure_number && dot_count <= 1 && num_len > 0 && num_first != '.' && num_last != '.') {
+            ctx->current_token.type = TK_LITERAL;
         } else {
-            current_token.type = TK_PRINT_LIT;
-            strcpy(current_token.str, rawStr);
+            ctx->current_token.type = TK_PRINT_LIT;
         }
+        ctx->current_token.offset = (int)(content - ctx->src_begin);
+        ctx->current_token.len = (int)(content_end - content);
         return;
     }
 
-    error(ERR_LEXER, "不明なトークンです: %s", charBuf);
+    error(ctx, ERR_LEXER, "不明なトークンです: %s", charBuf);
 }
\ No newline at end of file
@@ -41,17 +41,37 @@ typedef enum {
     TK_OR           // または
 } TokenType;
 
+// トークンフラグ
+#define TKF_SPACE_BEFORE   0x01 // 直前に空白（コメントを含む）がある
+#define TKF_NEWLINE_BEFORE 0x02 // 直前に改行がある
+
+// トークン (16バイト)
+// 文字列はソースバッファ内の位置 (offset, len) で表し、コピーは持たない
 typedef struct {
-    TokenType type;
-    char str[1024];
+    unsigned char type;  // TokenType
+    unsigned char flags; // TKF_*
     int line;
-    bool has_space_before;
-    bool has_newline_before;
+    int offset;          // ソース先頭からのバイトオフセット
+    int len;             // バイト長
 } Token;
 
-extern Token current_token;
+// 字句解析器の状態は文脈 (context.h) に持つ
+typedef struct JpcContext JpcContext;
 
 const char* getTokenName(TokenType type);
-void getNextToken(FILE *fp);
+bool initLexer(JpcContext *ctx, FILE *fp);
+bool loadLexerSource(JpcContext *ctx, FILE *fp);
+bool tokenizeSource(JpcContext *ctx);
+bool initLexerBuffer(JpcContext *ctx, const char *buf, size_t len);
+void setLexerSource(JpcContext *ctx, const char *buf, size_t len);
+void closeLexer(JpcContext *ctx);
+Token *lexRegion(JpcContext *ctx, int offset, int end_offset, int line, int *count);
+void seekToken(JpcContext *ctx, int pos);
+int tellToken(JpcContext *ctx);
+const char *getTokenText(JpcContext *ctx, const Token *tok);
+const char *internToken(JpcContext *ctx, const Token *tok);
+const char *internString(JpcContext *ctx, const char *s, int len);
+double getTokenValue(JpcContext *ctx, const Token *tok);
+void getNextToken(JpcContext *ctx);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bench-util.h"
+
+// ループの多い入力を最大の最適化レベルで、ループの最適化なしとありでコンパイルし、生成した実行ファイルの速さを比べる。
+// 定数の伝播や整数の変数などほかの最適化はどちらにも入るので、差はループの最適化だけの効果になる
+
+// 値の変わらない宣言・代入、2 のべき乗のわり算、帰納変数のかけ算を含むループを生成する
+static void generate_input(FILE *fp, long iterations) {
+    fprintf(fp, "メイン｛\n");
+    fprintf(fp, "　　”平均”を「０」で宣言する。\n");
+    fprintf(fp, "　　”係数”を「０」で宣言する。\n");
+    fprintf(fp, "　　”i”を「０」で宣言する。\n");
+    fprintf(fp, "　　ループ（”i”が「%ld」より小さいか）｛\n", iterations);
+    fprintf(fp, "　　　　”重み”を「８」で宣言する。\n");
+    fprintf(fp, "　　　　”係数”に「３」を代入する。\n");
+    fprintf(fp, "　　　　”位置”を”i”で宣言する。\n");
+    fprintf(fp, "　　　　”位置”に「６」をかける。\n");
+    fprintf(fp, "　　　　”平均”を「２」でわる。\n");
+    fprintf(fp, "　　　　”平均”に”位置”をたす。\n");
+    fprintf(fp, "　　　　”平均”から”重み”をひく。\n");
+    fprintf(fp, "　　　　”平均”から”係数”をひく。\n");
+    fprintf(fp, "　　　　”i”に「１」をたす。\n");
+    fprintf(fp, "　　｝\n");
+    fprintf(fp, "　　「平均は”平均”、係数は”係数”です」と出力する。\n");
+    fprintf(fp, "｝\n");
+}
+
+int main(int argc, char *argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 30000000;
+    char dir[] = "/tmp/jpc-loop-bench-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        fprintf(stderr, "Error: Cannot create temporary directory\n");
+        return 1;
+    }
+    char src[4096 + 16];
+    snprintf(src, sizeof(src), "%s/loop.jpc", dir);
+    if (!bench_write_source(src, generate_input, iterations)) {
+        fprintf(stderr, "Error: Cannot write %s\n", src);
+        return 1;
+    }
+
+    DriverOptions variants[2] = {
+        { OPT_LEVEL_MAX, false, CODEGEN_DEFAULTS, BUILD_DEFAULTS, true },
+        { OPT_LEVEL_MAX, false, CODEGEN_DEFAULTS, BUILD_DEFAULTS, false },
+    };
+    char before[64], after[64];
+    snprintf(before, sizeof(before), "before (-O%d, ループの最適化なし)", OPT_LEVEL_MAX);
+    snprintf(after, sizeof(after), "after  (-O%d)", OPT_LEVEL_MAX);
+    const char *const names[2] = { before, after };
+    printf("=== Loop Bench: %ld iterations ===\n", iterations);
+    bool same = bench_compare(src, NULL, variants, names, 3);
+
+    unlink(src);
+    rmdir(dir);
+    return same ? 0 : 1;
+}
@@ -0,0 +1,1386 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <setjmp.h>
+#include "optimize.h"
+#include "error.h"
+#include "context.h"
+
+// --- 定数の伝播と畳み込み ---
+// 文を実行順にたどり、値が分かっている変数 (known) を覚えておく。
+// 変数の読み出しは定数に置き換え、定数どうしの演算・比較・かつ／または は結果の定数にする。
+// 分岐では両方の枝を別々に調べ、枝の後で値が一致する変数だけを残す。
+// 分岐の後に状態を戻せるよう、変数の状態の変更はすべて記録 (log) しておく。
+
+typedef struct {
+    uint32_t var;
+    bool known;     // 変更前の状態
+    double value;
+} Fact;
+
+typedef struct {
+    JpcContext *ctx;
+    Ast *ast;
+    uint32_t nvars;
+    bool *known;    // 変数ID -> 値が分かっているか
+    double *value;  // 変数ID -> 分かっている値
+    uint32_t *stamp; // 枝の合流で使う印
+    uint32_t stamp_gen;
+    Fact *log;
+    uint32_t log_len, log_cap;
+} ConstProp;
+
+static void *alloc_array(JpcContext *ctx, size_t n, size_t elem) {
+    void *p = calloc(n ? n : 1, elem);
+    if (p == NULL) error(ctx, ERR_SYSTEM, "メモリを確保できません");
+    return p;
+}
+
+static void set_fact(ConstProp *cp, uint32_t var, bool known, double value) {
+    if (cp->known[var] == known && (!known || memcmp(&cp->value[var], &value, sizeof(value)) == 0)) return;
+    if (cp->log_len == cp->log_cap) {
+        uint32_t cap = cp->log_cap ? cp->log_cap * 2 : 256;
+        Fact *log = realloc(cp->log, sizeof(Fact) * cap);
+        if (log == NULL) error(cp->ctx, ERR_SYSTEM, "メモリを確保できません");
+        cp->log = log;
+        cp->log_cap = cap;
+    }
+    cp->log[cp->log_len++] = (Fact){ var, cp->known[var], cp->value[var] };
+    cp->known[var] = known;
+    cp->value[var] = value;
+}
+
+// 記録を mark まで巻き戻す
+static void undo_to(ConstProp *cp, uint32_t mark) {
+    while (cp->log_len > mark) {
+        Fact *f = &cp->log[--cp->log_len];
+        cp->known[f->var] = f->known;
+        cp->value[f->var] = f->value;
+    }
+}
+
+static bool same_fact(bool known1, double value1, bool known2, double value2) {
+    if (known1 != known2) return false;
+    return !known1 || memcmp(&value1, &value2, sizeof(double)) == 0;
+}
+
+static void set_literal(ANode *n, double val) {
+    uint64_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    n->kind = ND_LITERAL;
+    n->a = (uint32_t)bits;
+    n->b = (uint32_t)(bits >> 32);
+    n->c = 0;
+}
+
+// 値 (変数または数値) を読む位置。分かっている変数なら数値に置き換える
+static void fold_value(ConstProp *cp, uint32_t id) {
+    ANode *n = &cp->ast->nodes[id];
+    if (n->kind == ND_VAR && cp->known[n->a]) set_literal(n, cp->value[n->a]);
+}
+
+static bool is_literal(const Ast *ast, uint32_t id, double *val) {
+    const ANode *n = &ast->nodes[id];
+    if (n->kind != ND_LITERAL) return false;
+    *val = ast_num(n);
+    return true;
+}
+
+// 子ノードの中身を親の位置に移す (親の next は保つ)
+static void replace_with_child(Ast *ast, uint32_t id, uint32_t child) {
+    uint32_t next = ast->nodes[id].next;
+    ast->nodes[id] = ast->nodes[child];
+    ast->nodes[id].next = next;
+}
+
+// 条件式を畳み込む。比較・かつ／または の値は 0 か 1 になる
+static void fold_cond(ConstProp *cp, uint32_t id) {
+    Ast *ast = cp->ast;
+    ANode *n = &ast->nodes[id];
+    double l, r;
+    switch (n->kind) {
+    case ND_EQ: case ND_NE: case ND_LT: case ND_LE: case ND_GT: case ND_GE: {
+        fold_value(cp, n->a);
+        fold_value(cp, n->b);
+        if (!is_literal(ast, n->a, &l) || !is_literal(ast, n->b, &r)) return;
+        bool t;
+        switch (n->kind) {
+        case ND_EQ: t = l == r; break;
+        case ND_NE: t = l != r; break;
+        case ND_LT: t = l < r; break;
+        case ND_LE: t = l <= r; break;
+        case ND_GT: t = l > r; break;
+        default:    t = l >= r; break;
+        }
+        set_literal(n, t ? 1.0 : 0.0);
+        return;
+    }
+    case ND_AND:
+    case ND_OR: {
+        fold_cond(cp, n->a);
+        fold_cond(cp, n->b);
+        // 条件式に副作用はないので、どちら側の定数でも畳み込める
+        bool is_and = n->kind == ND_AND;
+        uint32_t a = n->a, b = n->b;
+        if (is_literal(ast, a, &l)) {
+            if ((l != 0) == is_and) replace_with_child(ast, id, b);
+            else set_literal(n, is_and ? 0.0 : 1.0);
+        } else if (is_literal(ast, b, &r)) {
+            if ((r != 0) == is_and) replace_with_child(ast, id, a);
+            else set_literal(n, is_and ? 0.0 : 1.0);
+        }
+        return;
+    }
+    default:
+        return;
+    }
+}
+
+static void prop_list(ConstProp *cp, uint32_t id);
+
+// ループの本体で書き換えられる変数を、値の分からないものにする
+static void kill_writes(ConstProp *cp, uint32_t id) {
+    const Ast *ast = cp->ast;
+    for (; id; id = ast->nodes[id].next) {
+        const ANode *n = &ast->nodes[id];
+        switch (n->kind) {
+        case ND_IF:
+        case ND_ELSEIF:
+            kill_writes(cp, n->b);
+            kill_writes(cp, n->c);
+            break;
+        case ND_LOOP:
+            kill_writes(cp, n->b);
+            break;
+        case ND_DECLARE: case ND_ASSIGN: case ND_INPUT:
+        case ND_ADD: case ND_SUB: case ND_MUL: case ND_DIV:
+            set_fact(cp, ast->nodes[n->a].a, false, 0);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// もし／ではなく の連なりを調べる。終わった時点の状態は両方の枝を合わせたもの
+static void prop_if(ConstProp *cp, uint32_t id) {
+    Ast *ast = cp->ast;
+    fold_cond(cp, ast->nodes[id].a);
+
+    // 実行ブロックを調べ、変わった変数とその値を控えてから元に戻す
+    uint32_t mark = cp->log_len;
+    prop_list(cp, ast->nodes[id].b);
+    uint32_t nthen = cp->log_len - mark;
+    Fact *then_facts = alloc_array(cp->ctx, nthen, sizeof(Fact));
+    uint32_t gen = ++cp->stamp_gen;
+    uint32_t n = 0;
+    for (uint32_t i = mark; i < cp->log_len; i++) {
+        uint32_t var = cp->log[i].var;
+        if (cp->stamp[var] == gen) continue;
+        cp->stamp[var] = gen;
+        then_facts[n++] = (Fact){ var, cp->known[var], cp->value[var] };
+    }
+    undo_to(cp, mark);
+
+    // else 側 (なければ何もしない枝)
+    uint32_t els = ast->nodes[id].c;
+    if (els && ast->nodes[els].kind == ND_ELSEIF) prop_if(cp, els);
+    else prop_list(cp, els);
+
+    // else 側でだけ変わった変数は、実行ブロック側では入口の値のまま
+    // (else 側の解析で印が上書きされているので、付け直す)
+    uint32_t then_gen = ++cp->stamp_gen;
+    for (uint32_t i = 0; i < n; i++) cp->stamp[then_facts[i].var] = then_gen;
+    uint32_t else_end = cp->log_len;
+    uint32_t else_gen = ++cp->stamp_gen;
+    for (uint32_t i = mark; i < else_end; i++) {
+        uint32_t var = cp->log[i].var;
+        if (cp->stamp[var] == then_gen || cp->stamp[var] == else_gen) continue;
+        cp->stamp[var] = else_gen;
+        // 最初の記録が入口の状態
+        if (!same_fact(cp->log[i].known, cp->log[i].value, cp->known[var], cp->value[var])) {
+            set_fact(cp, var, false, 0);
+        }
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        Fact *f = &then_facts[i];
+        if (!same_fact(f->known, f->value, cp->known[f->var], cp->value[f->var])) {
+            set_fact(cp, f->var, false, 0);
+        }
+    }
+    free(then_facts);
+}
+
+// 文の列を実行順に調べる
+static void prop_list(ConstProp *cp, uint32_t id) {
+    Ast *ast = cp->ast;
+    for (; id; id = ast->nodes[id].next) {
+        ANode *n = &ast->nodes[id];
+        switch (n->kind) {
+        case ND_PROGRAM:
+        case ND_BLOCK:
+            prop_list(cp, n->a);
+            break;
+        case ND_IF:
+            prop_if(cp, id);
+            break;
+        case ND_LOOP: {
+            // 本体は何回実行されるか分からないので、本体で書き換える変数は入口から分からないものとする
+            kill_writes(cp, n->b);
+            uint32_t mark = cp->log_len;
+            fold_cond(cp, n->a);
+            prop_list(cp, n->b);
+            undo_to(cp, mark);
+            break;
+        }
+        case ND_DECLARE:
+        case ND_ASSIGN: {
+            double v;
+            fold_value(cp, n->b);
+            uint32_t var = ast->nodes[n->a].a;
+            if (is_literal(ast, n->b, &v)) set_fact(cp, var, true, v);
+            else set_fact(cp, var, false, 0);
+            break;
+        }
+        case ND_ADD:
+        case ND_SUB:
+        case ND_MUL:
+        case ND_DIV: {
+            double v;
+            fold_value(cp, n->b);
+            uint32_t var = ast->nodes[n->a].a;
+            if (!cp->known[var] || !is_literal(ast, n->b, &v)) {
+                set_fact(cp, var, false, 0);
+                break;
+            }
+            double x = cp->value[var];
+            switch (n->kind) {
+            case ND_ADD: x += v; break;
+            case ND_SUB: x -= v; break;
+            case ND_MUL: x *= v; break;
+            default:     x /= v; break;
+            }
+            // 無限大や NaN になる演算は実行時に任せる
+            if (!isfinite(x)) {
+                set_fact(cp, var, false, 0);
+                break;
+            }
+            n->kind = ND_ASSIGN;
+            set_literal(&ast->nodes[n->b], x);
+            set_fact(cp, var, true, x);
+            break;
+        }
+        case ND_INPUT:
+            set_fact(cp, ast->nodes[n->a].a, false, 0);
+            break;
+        case ND_OUTPUT:
+            fold_value(cp, n->a);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static void propagate_constants(JpcContext *ctx, Ast *ast) {
+    ConstProp cp = { .ctx = ctx, .ast = ast };
+    cp.nvars = ast_var_count(ast);
+    cp.known = alloc_array(ctx, cp.nvars, sizeof(bool));
+    cp.value = alloc_array(ctx, cp.nvars, sizeof(double));
+    cp.stamp = alloc_array(ctx, cp.nvars, sizeof(uint32_t));
+    prop_list(&cp, ast->root);
+    free(cp.known);
+    free(cp.value);
+    free(cp.stamp);
+    free(cp.log);
+}
+
+// --- 到達しない分岐と使われない代入の削除 ---
+// 条件が定数になった もし／ではなく は、実行される枝だけを残す (偽の ループ は丸ごと消す)。
+// 出力・条件式から (代入を通じて間接的にも) 読まれない変数への書き込みは消す。
+// ただし入力する変数は、入力を読み進める副作用があるので残す。
+// 枝や文を消すと読まれなくなる変数が増えるので、消すものがなくなるまで繰り返す。
+
+typedef struct {
+    JpcContext *ctx;
+    Ast *ast;
+    uint32_t nvars;
+    bool *keep;     // 変数ID -> 書き込みを残すか
+    bool changed;
+    OptStats stats;
+} Elim;
+
+// ノードとその子孫の数 (文の列は next をたどる)
+static uint32_t count_nodes(const Ast *ast, uint32_t id) {
+    uint32_t total = 0;
+    for (; id; id = ast->nodes[id].next) {
+        const ANode *n = &ast->nodes[id];
+        total++;
+        switch (n->kind) {
+        case ND_VAR:
+        case ND_LITERAL:
+        case ND_STR_LIT:
+            break;
+        default:
+            total += count_nodes(ast, n->a) + count_nodes(ast, n->b);
+            if (n->kind == ND_IF || n->kind == ND_ELSEIF) total += count_nodes(ast, n->c);
+            break;
+        }
+    }
+    return total;
+}
+
+static void mark_read(Elim *el, uint32_t id) {
+    const ANode *n = &el->ast->nodes[id];
+    if (n->kind == ND_VAR && !el->keep[n->a]) {
+        el->keep[n->a] = true;
+        el->changed = true;
+    }
+}
+
+// 条件式で読まれる変数
+static void mark_cond(Elim *el, uint32_t id) {
+    const ANode *n = &el->ast->nodes[id];
+    switch (n->kind) {
+    case ND_AND: case ND_OR:
+    case ND_EQ: case ND_NE: case ND_LT: case ND_LE: case ND_GT: case ND_GE:
+        if (n->kind == ND_AND || n->kind == ND_OR) {
+            mark_cond(el, n->a);
+            mark_cond(el, n->b);
+        } else {
+            mark_read(el, n->a);
+            mark_read(el, n->b);
+        }
+        break;
+    default:
+        mark_read(el, id);
+        break;
+    }
+}
+
+// 残す変数に印を付ける。代入元は、代入先を残すときだけ残す
+static void mark_live(Elim *el, uint32_t id) {
+    const Ast *ast = el->ast;
+    for (; id; id = ast->nodes[id].next) {
+        const ANode *n = &ast->nodes[id];
+        switch (n->kind) {
+        case ND_PROGRAM:
+        case ND_BLOCK:
+            mark_live(el, n->a);
+            break;
+        case ND_IF:
+        case ND_ELSEIF:
+            mark_cond(el, n->a);
+            mark_live(el, n->b);
+            mark_live(el, n->c);
+            break;
+        case ND_LOOP:
+            mark_cond(el, n->a);
+            mark_live(el, n->b);
+            break;
+        case ND_INPUT:
+            mark_read(el, n->a);
+            break;
+        case ND_OUTPUT:
+            if (ast->nodes[n->a].kind == ND_STR_LIT) {
+                const ANode *str = &ast->nodes[n->a];
+                for (uint32_t i = 0; i < str->c; i++) {
+                    uint32_t var = (uint32_t)ast->ids[str->b + i];
+                    if (!el->keep[var]) {
+                        el->keep[var] = true;
+                        el->changed = true;
+                    }
+                }
+            } else {
+                mark_read(el, n->a);
+            }
+            break;
+        case ND_DECLARE: case ND_ASSIGN: case ND_ADD: case ND_SUB: case ND_MUL: case ND_DIV:
+            if (el->keep[ast->nodes[n->a].a]) mark_read(el, n->b);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static bool literal_truth(const Ast *ast, uint32_t id, bool *truth) {
+    const ANode *n = &ast->nodes[id];
+    if (n->kind != ND_LITERAL) return false;
+    *truth = ast_num(n) != 0;
+    return true;
+}
+
+static void drop(Elim *el, uint32_t id, uint32_t *counter) {
+    el->stats.removed_nodes += count_nodes(el->ast, id);
+    (*counter)++;
+    el->changed = true;
+}
+
+static uint32_t elim_list(Elim *el, uint32_t id);
+
+// もし／ではなく の連なり。代わりに置く文の列を返す (消えれば 0)
+static uint32_t elim_if(Elim *el, uint32_t id) {
+    Ast *ast = el->ast;
+    ANode *n = &ast->nodes[id];
+    bool truth;
+    if (literal_truth(ast, n->a, &truth)) {
+        uint32_t keep = truth ? n->b : n->c;
+        uint32_t gone = truth ? n->c : n->b;
+        el->stats.removed_nodes += 1 + count_nodes(ast, n->a) + count_nodes(ast, gone);
+        el->stats.removed_branches++;
+        el->changed = true;
+        if (keep && ast->nodes[keep].kind == ND_ELSEIF) {
+            // 次の ではなく がこの位置の もし／ではなく になる
+            ast->nodes[keep].kind = n->kind;
+            return elim_if(el, keep);
+        }
+        return elim_list(el, keep);
+    }
+    n->b = elim_list(el, n->b);
+    if (n->c && ast->nodes[n->c].kind == ND_ELSEIF) n->c = elim_if(el, n->c);
+    else n->c = elim_list(el, n->c);
+    // 何もしない枝だけになった分岐は、条件式に副作用がないので消せる
+    if (!n->b && !n->c) {
+        drop(el, id, &el->stats.removed_branches);
+        return 0;
+    }
+    return id;
+}
+
+// 文の列を書き換え、新しい先頭を返す
+static uint32_t elim_list(Elim *el, uint32_t id) {
+    Ast *ast = el->ast;
+    uint32_t head = 0;
+    uint32_t *link = &head;
+    while (id) {
+        ANode *n = &ast->nodes[id];
+        uint32_t next = n->next;
+        n->next = 0;
+        uint32_t repl = id;
+        bool truth;
+        switch (n->kind) {
+        case ND_PROGRAM:
+        case ND_BLOCK:
+            n->a = elim_list(el, n->a);
+            break;
+        case ND_IF:
+            repl = elim_if(el, id);
+            break;
+        case ND_LOOP:
+            if (literal_truth(ast, n->a, &truth) && !truth) {
+                drop(el, id, &el->stats.removed_loops);
+                repl = 0;
+            } else {
+                n->b = elim_list(el, n->b);
+            }
+            break;
+        case ND_DECLARE: case ND_ASSIGN: case ND_ADD: case ND_SUB: case ND_MUL: case ND_DIV:
+            if (!el->keep[ast->nodes[n->a].a]) {
+                drop(el, id, &el->stats.removed_stores);
+                repl = 0;
+            }
+            break;
+        default:
+            break;
+        }
+        // 置き換えた列を繋ぎ、その末尾へ進む
+        *link = repl;
+        while (*link) link = &ast->nodes[*link].next;
+        id = next;
+    }
+    return head;
+}
+
+static void eliminate_dead_code(JpcContext *ctx, Ast *ast, OptStats *stats) {
+    Elim el = { .ctx = ctx, .ast = ast };
+    el.nvars = ast_var_count(ast);
+    el.keep = alloc_array(ctx, el.nvars, sizeof(bool));
+    do {
+        memset(el.keep, 0, el.nvars * sizeof(bool));
+        do {
+            el.changed = false;
+            mark_live(&el, ast->root);
+        } while (el.changed);
+        elim_list(&el, ast->root);
+    } while (el.changed);
+    free(el.keep);
+    if (stats) *stats = el.stats;
+}
+
+// --- 整数型の推論 ---
+// 整数の値しか持たない変数を int64_t で出力する。double と同じ結果になることを保証するため、
+//   - 書き込みが整数の定数・整数の変数による 宣言／代入／たす／ひく／かける だけ (でわる・入力する がない)
+//   - 取りうる値の範囲が ±2^53 に収まる (この範囲の整数なら double でも誤差なく計算される)
+//   - -0 にならない (double の -0 は「-0.000000」と表示されるが、整数では区別できない)
+// をすべて満たす変数だけを選び、少しでも不確かなら double のままにする。
+// 値の範囲は区間で追跡する。ループでは先頭の区間が変わらなくなるまで本体を繰り返し調べ
+// (数回で収まらなければプログラム中の定数を目安に広げ (widening)、その後に狭め直す)、
+// 条件式で区間を絞り込む。
+
+#define EXACT_INT_LIMIT 9007199254740992.0 // 2^53
+#define INFER_STEP_LIMIT 20000000         // 調べる文の数の上限 (超えたら推論をあきらめる)
+#define WIDEN_AFTER 3
+
+typedef struct {
+    double lo, hi;
+    bool negz;      // -0 になりうるか
+} Range;
+
+typedef struct {
+    uint32_t var;
+    Range old;      // 変更前の区間
+} RangeFact;
+
+typedef struct {
+    JpcContext *ctx;
+    Ast *ast;
+    uint32_t nvars;
+    bool *cand;     // 変数ID -> 整数の候補か
+    Range *cur;     // 変数ID -> 現在の区間
+    Range *seen;    // 変数ID -> これまでに書き込まれた値すべてを含む区間
+    double *bounds; // 広げるときの目安 (プログラム中の定数と ±2^53 を昇順に並べたもの)
+    uint32_t nbounds;
+    bool *written;
+    uint32_t *stamp;
+    uint32_t stamp_gen;
+    RangeFact *log;
+    uint32_t log_len, log_cap;
+    long steps;
+} IntInfer;
+
+static bool is_exact_int(double v) {
+    return fabs(v) <= EXACT_INT_LIMIT && (double)(long long)v == v;
+}
+
+// c 以下の最大の整数 (c が大きすぎる・無限大ならそのまま)
+static double floor_int(double c) {
+    if (!(fabs(c) < 4.5e15)) return c;
+    double t = (double)(long long)c;
+    return t > c ? t - 1 : t;
+}
+
+static double ceil_int(double c) {
+    if (!(fabs(c) < 4.5e15)) return c;
+    double t = (double)(long long)c;
+    return t < c ? t + 1 : t;
+}
+
+static double min_num(double a, double b) { return b < a ? b : a; }
+static double max_num(double a, double b) { return b > a ? b : a; }
+
+static Range range_of(double v) {
+    return (Range){ v, v, v == 0 && signbit(v) };
+}
+
+static Range range_join(Range a, Range b) {
+    return (Range){ min_num(a.lo, b.lo), max_num(a.hi, b.hi), a.negz || b.negz };
+}
+
+static bool range_eq(Range a, Range b) {
+    return a.lo == b.lo && a.hi == b.hi && a.negz == b.negz;
+}
+
+static bool range_has_zero(Range r) {
+    return r.lo <= 0 && r.hi >= 0;
+}
+
+// 区間の積 (inf * 0 のように NaN になる組み合わせは全体とする)
+static Range range_mul(Range a, Range b) {
+    double p[4] = { a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi };
+    Range r = { p[0], p[0], false };
+    for (int i = 0; i < 4; i++) {
+        if (isnan(p[i])) return (Range){ -INFINITY, INFINITY, true };
+        r.lo = min_num(r.lo, p[i]);
+        r.hi = max_num(r.hi, p[i]);
+    }
+    // 0 (または -0) と負の数の積は -0 になりうる
+    bool zero = range_has_zero(a) || a.negz || range_has_zero(b) || b.negz;
+    bool neg = a.lo < 0 || b.lo < 0 || a.negz || b.negz;
+    r.negz = zero && neg;
+    return r;
+}
+
+static void set_range(IntInfer *ii, uint32_t var, Range r) {
+    if (range_eq(ii->cur[var], r)) return;
+    if (ii->log_len == ii->log_cap) {
+        uint32_t cap = ii->log_cap ? ii->log_cap * 2 : 256;
+        RangeFact *log = realloc(ii->log, sizeof(RangeFact) * cap);
+        if (log == NULL) error(ii->ctx, ERR_SYSTEM, "メモリを確保できません");
+        ii->log = log;
+        ii->log_cap = cap;
+    }
+    ii->log[ii->log_len++] = (RangeFact){ var, ii->cur[var] };
+    ii->cur[var] = r;
+}
+
+static void undo_ranges(IntInfer *ii, uint32_t mark) {
+    while (ii->log_len > mark) {
+        RangeFact *f = &ii->log[--ii->log_len];
+        ii->cur[f->var] = f->old;
+    }
+}
+
+// 変数への書き込み。書き込まれた値は seen にも加える
+static void write_range(IntInfer *ii, uint32_t var, Range r) {
+    ii->seen[var] = ii->written[var] ? range_join(ii->seen[var], r) : r;
+    ii->written[var] = true;
+    set_range(ii, var, r);
+}
+
+// 値 (変数または数値) の区間。候補でない変数は何でもありうる
+static Range operand_range(IntInfer *ii, uint32_t id) {
+    const ANode *n = &ii->ast->nodes[id];
+    if (n->kind == ND_LITERAL) return range_of(ast_num(n));
+    if (n->kind == ND_VAR && ii->cand[n->a]) return ii->cur[n->a];
+    return (Range){ -INFINITY, INFINITY, true };
+}
+
+// 候補の変数 x について「x op (other の区間)」が成り立つとして区間を絞る
+static void refine_var(IntInfer *ii, uint32_t x, NodeKind op, Range other) {
+    Range r = ii->cur[x];
+    switch (op) {
+    case ND_LT: r.hi = min_num(r.hi, ceil_int(other.hi) - 1); break;
+    case ND_LE: r.hi = min_num(r.hi, floor_int(other.hi)); break;
+    case ND_GT: r.lo = max_num(r.lo, floor_int(other.lo) + 1); break;
+    case ND_GE: r.lo = max_num(r.lo, ceil_int(other.lo)); break;
+    case ND_EQ:
+        r.lo = max_num(r.lo, ceil_int(other.lo));
+        r.hi = min_num(r.hi, floor_int(other.hi));
+        break;
+    default:
+        return;
+    }
+    // 空になる場合は到達しない枝なので、絞らずにおく
+    if (r.lo > r.hi) return;
+    set_range(ii, x, r);
+}
+
+static NodeKind mirror_op(NodeKind op) {
+    switch (op) {
+    case ND_LT: return ND_GT;
+    case ND_LE: return ND_GE;
+    case ND_GT: return ND_LT;
+    case ND_GE: return ND_LE;
+    default:    return op;
+    }
+}
+
+static NodeKind negate_op(NodeKind op) {
+    switch (op) {
+    case ND_LT: return ND_GE;
+    case ND_LE: return ND_GT;
+    case ND_GT: return ND_LE;
+    case ND_GE: return ND_LT;
+    case ND_EQ: return ND_NE;
+    default:    return ND_EQ;
+    }
+}
+
+// 条件式 id が truth のときに成り立つ範囲に絞る
+static void refine_cond(IntInfer *ii, uint32_t id, bool truth) {
+    const Ast *ast = ii->ast;
+    const ANode *n = &ast->nodes[id];
+    switch (n->kind) {
+    case ND_AND:
+    case ND_OR:
+        // 「かつ」が真、「または」が偽のときだけ両辺に分けられる
+        if ((n->kind == ND_AND) == truth) {
+            refine_cond(ii, n->a, truth);
+            refine_cond(ii, n->b, truth);
+        }
+        return;
+    case ND_EQ: case ND_NE: case ND_LT: case ND_LE: case ND_GT: case ND_GE: {
+        NodeKind op = truth ? (NodeKind)n->kind : negate_op(n->kind);
+        // 候補でない変数は NaN もありうるので、比較の否定からは何も言えない
+        Range l = operand_range(ii, n->a), r = operand_range(ii, n->b);
+        if (isinf(l.lo) && isinf(l.hi) && l.negz) return;
+        if (isinf(r.lo) && isinf(r.hi) && r.negz) return;
+        const ANode *ln = &ast->nodes[n->a], *rn = &ast->nodes[n->b];
+        if (ln->kind == ND_VAR && ii->cand[ln->a]) refine_var(ii, ln->a, op, r);
+        if (rn->kind == ND_VAR && ii->cand[rn->a]) refine_var(ii, rn->a, mirror_op(op), l);
+        return;
+    }
+    default:
+        return;
+    }
+}
+
+static void infer_list(IntInfer *ii, uint32_t id);
+
+// v 以下で最大の目安 (なければ -inf)
+static double widen_lo(IntInfer *ii, double v) {
+    uint32_t lo = 0, hi = ii->nbounds;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (ii->bounds[mid] <= v) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo ? ii->bounds[lo - 1] : -INFINITY;
+}
+
+// v 以上で最小の目安 (なければ +inf)
+static double widen_hi(IntInfer *ii, double v) {
+    uint32_t lo = 0, hi = ii->nbounds;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (ii->bounds[mid] < v) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < ii->nbounds ? ii->bounds[lo] : INFINITY;
+}
+
+static int compare_num(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// 本体で書き換えられる候補の変数を vars に集める
+static void collect_writes(IntInfer *ii, uint32_t id, uint32_t **vars, uint32_t *n, uint32_t *cap, uint32_t gen) {
+    const Ast *ast = ii->ast;
+    for (; id; id = ast->nodes[id].next) {
+        const ANode *s = &ast->nodes[id];
+        switch (s->kind) {
+        case ND_IF:
+        case ND_ELSEIF:
+            collect_writes(ii, s->b, vars, n, cap, gen);
+            collect_writes(ii, s->c, vars, n, cap, gen);
+            break;
+        case ND_LOOP:
+            collect_writes(ii, s->b, vars, n, cap, gen);
+            break;
+        case ND_DECLARE: case ND_ASSIGN: case ND_ADD: case ND_SUB: case ND_MUL: {
+            uint32_t var = ast->nodes[s->a].a;
+            if (!ii->cand[var] || ii->stamp[var] == gen) break;
+            ii->stamp[var] = gen;
+            if (*n == *cap) {
+                *cap = *cap ? *cap * 2 : 16;
+                uint32_t *grown = realloc(*vars, sizeof(uint32_t) * *cap);
+                if (grown == NULL) error(ii->ctx, ERR_SYSTEM, "メモリを確保できません");
+                *vars = grown;
+            }
+            (*vars)[(*n)++] = var;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+// ループ本体を1回調べ、書き換えられる変数の出口の区間を out に入れる (状態は元に戻す)
+static void infer_loop_body(IntInfer *ii, const ANode *loop, const uint32_t *vars, uint32_t n, Range *out) {
+    uint32_t mark = ii->log_len;
+    refine_cond(ii, loop->a, true);
+    infer_list(ii, loop->b);
+    for (uint32_t i = 0; i < n; i++) out[i] = ii->cur[vars[i]];
+    undo_ranges(ii, mark);
+}
+
+static void infer_loop(IntInfer *ii, uint32_t id) {
+    const ANode *loop = &ii->ast->nodes[id];
+    uint32_t *vars = NULL, n = 0, cap = 0;
+    collect_writes(ii, loop->b, &vars, &n, &cap, ++ii->stamp_gen);
+    Range *entry = alloc_array(ii->ctx, n * 2, sizeof(Range));
+    Range *out = entry + n;
+    for (uint32_t i = 0; i < n; i++) entry[i] = ii->cur[vars[i]];
+
+    // 先頭の区間が変わらなくなるまで広げる
+    for (int iter = 0; ; iter++) {
+        infer_loop_body(ii, loop, vars, n, out);
+        bool changed = false;
+        for (uint32_t i = 0; i < n; i++) {
+            Range head = ii->cur[vars[i]];
+            Range r = range_join(head, out[i]);
+            if (range_eq(r, head)) continue;
+            if (iter >= WIDEN_AFTER) {
+                if (r.lo < head.lo) r.lo = widen_lo(ii, r.lo);
+                if (r.hi > head.hi) r.hi = widen_hi(ii, r.hi);
+            }
+            set_range(ii, vars[i], r);
+            changed = true;
+        }
+        if (!changed || ii->steps > INFER_STEP_LIMIT) break;
+    }
+    // 広げすぎた区間を、入口の区間と本体の出口の区間の和で狭め直す
+    for (int iter = 0; iter < 2; iter++) {
+        infer_loop_body(ii, loop, vars, n, out);
+        for (uint32_t i = 0; i < n; i++) set_range(ii, vars[i], range_join(entry[i], out[i]));
+    }
+    free(entry);
+    free(vars);
+}
+
+// もし／ではなく の連なり。終わった時点の区間は両方の枝の区間の和
+static void infer_if(IntInfer *ii, uint32_t id) {
+    const ANode *n = &ii->ast->nodes[id];
+    uint32_t mark = ii->log_len;
+    refine_cond(ii, n->a, true);
+    infer_list(ii, n->b);
+    uint32_t nthen = ii->log_len - mark;
+    RangeFact *then_facts = alloc_array(ii->ctx, nthen, sizeof(RangeFact));
+    uint32_t gen = ++ii->stamp_gen;
+    uint32_t count = 0;
+    for (uint32_t i = mark; i < ii->log_len; i++) {
+        uint32_t var = ii->log[i].var;
+        if (ii->stamp[var] == gen) continue;
+        ii->stamp[var] = gen;
+        then_facts[count++] = (RangeFact){ var, ii->cur[var] };
+    }
+    undo_ranges(ii, mark);
+
+    refine_cond(ii, n->a, false);
+    if (n->c && ii->ast->nodes[n->c].kind == ND_ELSEIF) infer_if(ii, n->c);
+    else infer_list(ii, n->c);
+
+    uint32_t then_gen = ++ii->stamp_gen;
+    for (uint32_t i = 0; i < count; i++) ii->stamp[then_facts[i].var] = then_gen;
+    uint32_t else_end = ii->log_len;
+    uint32_t else_gen = ++ii->stamp_gen;
+    for (uint32_t i = mark; i < else_end; i++) {
+        uint32_t var = ii->log[i].var;
+        if (ii->stamp[var] == then_gen || ii->stamp[var] == else_gen) continue;
+        ii->stamp[var] = else_gen;
+        set_range(ii, var, range_join(ii->log[i].old, ii->cur[var]));
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        RangeFact *f = &then_facts[i];
+        set_range(ii, f->var, range_join(f->old, ii->cur[f->var]));
+    }
+    free(then_facts);
+}
+
+static void infer_list(IntInfer *ii, uint32_t id) {
+    const Ast *ast = ii->ast;
+    for (; id; id = ast->nodes[id].next) {
+        // 大きすぎる入力では推論をあきらめる (候補は後ですべて外す)
+        if (++ii->steps > INFER_STEP_LIMIT) return;
+        const ANode *n = &ast->nodes[id];
+        switch (n->kind) {
+        case ND_PROGRAM:
+        case ND_BLOCK:
+            infer_list(ii, n->a);
+            break;
+        case ND_IF:
+            infer_if(ii, id);
+            break;
+        case ND_LOOP:
+            infer_loop(ii, id);
+            break;
+        case ND_DECLARE: case ND_ASSIGN: case ND_ADD: case ND_SUB: case ND_MUL: {
+            uint32_t var = ast->nodes[n->a].a;
+            if (!ii->cand[var]) break;
+            Range x = ii->cur[var], v = operand_range(ii, n->b), r;
+            switch (n->kind) {
+            case ND_ADD: r = (Range){ x.lo + v.lo, x.hi + v.hi, x.negz && v.negz }; break;
+            case ND_SUB: r = (Range){ x.lo - v.hi, x.hi - v.lo, x.negz && (range_has_zero(v) || v.negz) }; break;
+            case ND_MUL: r = range_mul(x, v); break;
+            default:     r = v; break;
+            }
+            if (isnan(r.lo) || isnan(r.hi)) r = (Range){ -INFINITY, INFINITY, true };
+            write_range(ii, var, r);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+// 書き込みが整数の値だけの変数を候補にする (代入元の変数も候補でなければ外す)
+static void find_int_candidates(IntInfer *ii, uint32_t id, bool *changed) {
+    const Ast *ast = ii->ast;
+    for (; id; id = ast->nodes[id].next) {
+        const ANode *n = &ast->nodes[id];
+        switch (n->kind) {
+        case ND_PROGRAM:
+        case ND_BLOCK:
+            find_int_candidates(ii, n->a, changed);
+            break;
+        case ND_IF:
+        case ND_ELSEIF:
+            find_int_candidates(ii, n->b, changed);
+            find_int_candidates(ii, n->c, changed);
+            break;
+        case ND_LOOP:
+            find_int_candidates(ii, n->b, changed);
+            break;
+        case ND_DECLARE: case ND_ASSIGN: case ND_ADD: case ND_SUB: case ND_MUL:
+        case ND_DIV: case ND_INPUT: {
+            uint32_t var = ast->nodes[n->a].a;
+            if (!ii->cand[var]) break;
+            bool ok = n->kind != ND_DIV && n->kind != ND_INPUT;
+            if (ok) {
+                const ANode *v = &ast->nodes[n->b];
+                if (v->kind == ND_LITERAL) ok = is_exact_int(ast_num(v));
+                else ok = v->kind == ND_VAR && ii->cand[v->a];
+            }
+            if (!ok) {
+                ii->cand[var] = false;
+                *changed = true;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+static void infer_int_vars(JpcContext *ctx, Ast *ast) {
+    IntInfer ii = { .ctx = ctx, .ast = ast };
+    ii.nvars = ast_var_count(ast);
+    ii.cand = alloc_array(ctx, ii.nvars, sizeof(bool));
+    ii.cur = alloc_array(ctx, ii.nvars, sizeof(Range));
+    ii.seen = alloc_array(ctx, ii.nvars, sizeof(Range));
+    ii.written = alloc_array(ctx, ii.nvars, sizeof(bool));
+    ii.stamp = alloc_array(ctx, ii.nvars, sizeof(uint32_t));
+    for (uint32_t v = 0; v < ii.nvars; v++) ii.cand[v] = true;
+
+    ii.bounds = alloc_array(ctx, ast->count + 2, sizeof(double));
+    ii.bounds[ii.nbounds++] = -EXACT_INT_LIMIT;
+    ii.bounds[ii.nbounds++] = EXACT_INT_LIMIT;
+    for (uint32_t id = 1; id < ast->count; id++) {
+        if (ast->nodes[id].kind != ND_LITERAL) continue;
+        double v = ast_num(&ast->nodes[id]);
+        if (!isnan(v)) ii.bounds[ii.nbounds++] = v;
+    }
+    qsort(ii.bounds, ii.nbounds, sizeof(double), compare_num);
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        find_int_candidates(&ii, ast->root, &changed);
+    }
+    infer_list(&ii, ast->root);
+
+    free(ast->int_vars);
+    ast->int_vars = alloc_array(ctx, ii.nvars, sizeof(bool));
+    ast->int_vars_len = ii.nvars;
+    if (ii.steps <= INFER_STEP_LIMIT) {
+        for (uint32_t v = 0; v < ii.nvars; v++) {
+            Range r = ii.seen[v];
+            ast->int_vars[v] = ii.cand[v] && ii.written[v] && !r.negz
+                && r.lo >= -EXACT_INT_LIMIT && r.hi <= EXACT_INT_LIMIT;
+        }
+    }
+    free(ii.cand);
+    free(ii.cur);
+    free(ii.seen);
+    free(ii.written);
+    free(ii.stamp);
+    free(ii.bounds);
+    free(ii.log);
+}
+
+// --- ループの最適化 ---
+// ループの本体で値の変わらない宣言・代入を、ループの前に移す。
+//   - 宣言した変数は本体の中でしか見えないので、そのまま前に移せる (ループが一度も回らなくても害がない)
+//   - 代入はループが一度も回らないと結果が変わるので、ループと同じ条件の もし で囲んでから前に移す
+// 移せるのは本体の先頭の並びにある (毎回必ず実行される) 文で、代入先の変数は
+// ループの中でほかに書き込まれず、代入より前 (条件式を含む) で読まれないものに限る。
+// また、2 のべき乗で わる は、結果が必ず一致する 逆数をかける に変える。
+// -O2 では整数の変数どうしの「t を i で宣言し、t に定数をかける」(i は本体で一定数ずつ増える) を、
+// ループの前で1回だけかけ、本体の最後で増分の定数倍を たす ものに変える (帰納変数の強さの軽減)。
+
+#define INDUCTION_MUL_LIMIT 1024.0 // かける定数の上限 (|i| <= 2^53 なので積が int64_t に収まる)
+
+typedef struct {
+    JpcContext *ctx;
+    Ast *ast;
+    uint32_t nvars;
+    uint32_t *writes;    // 変数ID -> 今調べているループの中で書き込む文の数
+    uint32_t *write_gen; // writes が今のループのものである印
+    uint32_t *read_gen;  // 今のループで既に読まれた変数の印
+    uint32_t gen;
+    OptStats *stats;
+} LoopOpt;
+
+static uint32_t loop_writes(LoopOpt *lo, uint32_t var) {
+    return lo->write_gen[var] == lo->gen ? lo->writes[var] : 0;
+}
+
+// 本体の中の書き込みを数える
+static void count_loop_writes(LoopOpt *lo, uint32_t id) {
+    const Ast *ast = lo->ast;
+    for (; id; id = ast->nodes[id].next) {
+        const ANode *n = &ast->nodes[id];
+        switch (n->kind) {
+        case ND_BLOCK:
+            count_loop_writes(lo, n->a);
+            break;
+        case ND_IF:
+        case ND_ELSEIF:
+            count_loop_writes(lo, n->b);
+            count_loop_writes(lo, n->c);
+            break;
+        case ND_LOOP:
+            count_loop_writes(lo, n->b);
+            break;
+        case ND_DECLARE: case ND_ASSIGN: case ND_INPUT:
+        case ND_ADD: case ND_SUB: case ND_MUL: case ND_DIV: {
+            uint32_t var = ast->nodes[n->a].a;
+            if (lo->write_gen[var] != lo->gen) {
+                lo->write_gen[var] = lo->gen;
+                lo->writes[var] = 0;
+            }
+            lo->writes[var]++;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+// 式で読む変数に印を付ける
+static void mark_expr_reads(LoopOpt *lo, uint32_t id) {
+    const ANode *n = &lo->ast->nodes[id];
+    switch (n->kind) {
+    case ND_VAR:
+        lo->read_gen[n->a] = lo->gen;
+        break;
+    case ND_EQ: case ND_NE: case ND_LT: case ND_LE: case ND_GT: case ND_GE:
+    case ND_AND: case ND_OR:
+        mark_expr_reads(lo, n->a);
+        mark_expr_reads(lo, n->b);
+        break;
+    default:
+        break;
+    }
+}
+
+// 文 (の列) で読む変数に印を付ける
+static void mark_stmt_reads(LoopOpt *lo, uint32_t id, bool list) {
+    const Ast *ast = lo->ast;
+    for (; id; id = list ? ast->nodes[id].next : 0) {
+        const ANode *n = &ast->nodes[id];
+        switch (n->kind) {
+        case ND_BLOCK:
+            mark_stmt_reads(lo, n->a, true);
+            break;
+        case ND_IF:
+        case ND_ELSEIF:
+            mark_expr_reads(lo, n->a);
+            mark_stmt_reads(lo, n->b, true);
+            mark_stmt_reads(lo, n->c, true);
+            break;
+        case ND_LOOP:
+            mark_expr_reads(lo, n->a);
+            mark_stmt_reads(lo, n->b, true);
+            break;
+        case ND_ADD: case ND_SUB: case ND_MUL: case ND_DIV:
+            mark_expr_reads(lo, n->a);
+            mark_expr_reads(lo, n->b);
+            break;
+        case ND_DECLARE: case ND_ASSIGN:
+            mark_expr_reads(lo, n->b);
+            break;
+        case ND_OUTPUT:
+            if (ast->nodes[n->a].kind == ND_STR_LIT) {
+                const ANode *str = &ast->nodes[n->a];
+                for (uint32_t i = 0; i < str->c; i++) lo->read_gen[ast->ids[str->b + i]] = lo->gen;
+            } else {
+                mark_expr_reads(lo, n->a);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static bool is_loop_invariant(LoopOpt *lo, uint32_t id) {
+    const ANode *n = &lo->ast->nodes[id];
+    return n->kind == ND_LITERAL || (n->kind == ND_VAR && loop_writes(lo, n->a) == 0);
+}
+
+// 条件式を複製する (もし で囲むときに使う)
+static uint32_t copy_expr(LoopOpt *lo, uint32_t id) {
+    Ast *ast = lo->ast;
+    uint32_t copy = ast_new_node(lo->ctx, ast, ast->nodes[id].kind);
+    ast->nodes[copy] = ast->nodes[id];
+    switch (ast->nodes[id].kind) {
+    case ND_EQ: case ND_NE: case ND_LT: case ND_LE: case ND_GT: case ND_GE:
+    case ND_AND: case ND_OR: {
+        uint32_t a = copy_expr(lo, ast->nodes[id].a);
+        uint32_t b = copy_expr(lo, ast->nodes[id].b);
+        ast->nodes[copy].a = a;
+        ast->nodes[copy].b = b;
+        break;
+    }
+    default:
+        break;
+    }
+    return copy;
+}
+
+// 2 のべき乗 (2^-1022 .. 2^1023、符号は問わない) か。逆数も正確に表せる
+static bool is_power_of_two(double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    uint32_t exp = (uint32_t)(bits >> 52) & 0x7FF;
+    return (bits & 0xFFFFFFFFFFFFFull) == 0 && exp != 0 && exp != 0x7FF;
+}
+
+// 列の末尾の文
+static uint32_t list_tail(const Ast *ast, uint32_t id) {
+    while (id && ast->nodes[id].next) id = ast->nodes[id].next;
+    return id;
+}
+
+static uint32_t opt_loops(LoopOpt *lo, uint32_t id);
+
+// ループ1つ。代わりに置く文の列 (前に移した文 + ループ、または それらを囲む もし) を返す
+static uint32_t opt_loop(LoopOpt *lo, uint32_t id) {
+    Ast *ast = lo->ast;
+    // 内側のループを先に (内側から移した文がさらに外へ移せることがある)
+    uint32_t body = opt_loops(lo, ast->nodes[id].b);
+    ast->nodes[id].b = body;
+
+    lo->gen++;
+    count_loop_writes(lo, body);
+    mark_expr_reads(lo, ast->nodes[id].a);
+
+    uint32_t hoisted = 0, hoisted_tail = 0;
+    bool guard = false;
+    uint32_t prev = 0;
+    for (uint32_t s = body; s; ) {
+        ANode *n = &ast->nodes[s];
+        uint32_t next = n->next;
+        bool move = false;
+        if ((n->kind == ND_DECLARE || n->kind == ND_ASSIGN) && is_loop_invariant(lo, n->b)) {
+            uint32_t var = ast->nodes[n->a].a;
+            if (loop_writes(lo, var) == 1) {
+                if (n->kind == ND_DECLARE) {
+                    move = true;
+                } else if (lo->read_gen[var] != lo->gen) {
+                    move = guard = true;
+                }
+                // 移した後は、この変数もループの中で変わらない
+                if (move) lo->writes[var] = 0;
+            }
+        }
+        if (move) {
+            if (prev) ast->nodes[prev].next = next;
+            else ast->nodes[id].b = next;
+            n->next = 0;
+            if (hoisted_tail) ast->nodes[hoisted_tail].next = s;
+            else hoisted = s;
+            hoisted_tail = s;
+            if (lo->stats) lo->stats->hoisted_stmts++;
+        } else {
+            mark_stmt_reads(lo, s, false);
+            prev = s;
+        }
+        s = next;
+    }
+    if (!hoisted) return id;
+    ast->nodes[hoisted_tail].next = id;
+    if (!guard) return hoisted;
+
+    uint32_t cond = copy_expr(lo, ast->nodes[id].a);
+    uint32_t g = ast_new_node(lo->ctx, ast, ND_IF);
+    ast->nodes[g].a = cond;
+    ast->nodes[g].b = hoisted;
+    return g;
+}
+
+// 文の列をたどってループを最適化し、新しい先頭を返す
+static uint32_t opt_loops(LoopOpt *lo, uint32_t id) {
+    Ast *ast = lo->ast;
+    uint32_t head = 0, tail = 0;
+    while (id) {
+        uint32_t next = ast->nodes[id].next;
+        ast->nodes[id].next = 0;
+        uint32_t repl = id;
+        switch (ast->nodes[id].kind) {
+        case ND_PROGRAM:
+        case ND_BLOCK: {
+            uint32_t a = opt_loops(lo, ast->nodes[id].a);
+            ast->nodes[id].a = a;
+            break;
+        }
+        case ND_IF:
+        case ND_ELSEIF: {
+            uint32_t b = opt_loops(lo, ast->nodes[id].b);
+            uint32_t c = ast->nodes[id].c;
+            if (c && ast->nodes[c].kind != ND_ELSEIF) c = opt_loops(lo, c);
+            else if (c) opt_loops(lo, c);
+            ast->nodes[id].b = b;
+            ast->nodes[id].c = c;
+            break;
+        }
+        case ND_LOOP:
+            repl = opt_loop(lo, id);
+            break;
+        case ND_DIV: {
+            ANode *v = &ast->nodes[ast->nodes[id].b];
+            if (v->kind == ND_LITERAL && is_power_of_two(ast_num(v))) {
+                ast->nodes[id].kind = ND_MUL;
+                set_literal(v, 1.0 / ast_num(v));
+                if (lo->stats) lo->stats->reduced_ops++;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        if (tail) ast->nodes[tail].next = repl;
+        else head = repl;
+        tail = list_tail(ast, repl);
+        id = next;
+    }
+    return head;
+}
+
+// 帰納変数の強さの軽減 (整数の変数が決まった後に行う)。ループ id の前に置く文の列を返す
+static uint32_t reduce_loop(LoopOpt *lo, uint32_t id) {
+    Ast *ast = lo->ast;
+    lo->gen++;
+    count_loop_writes(lo, ast->nodes[id].b);
+
+    uint32_t hoisted = 0, hoisted_tail = 0;
+    uint32_t prev = 0;
+    for (uint32_t s = ast->nodes[id].b; s; ) {
+        const ANode *n = &ast->nodes[s];
+        uint32_t m = n->next;
+        // t を i で宣言する。 t に c をかける。 … i に d をたす／から d をひく。
+        uint32_t t = ast->nodes[n->a].a;
+        const ANode *src = &ast->nodes[n->b];
+        if (n->kind != ND_DECLARE || src->kind != ND_VAR || !m || ast->nodes[m].kind != ND_MUL
+            || ast->nodes[ast->nodes[m].a].a != t || ast->nodes[ast->nodes[m].b].kind != ND_LITERAL
+            || !ast_is_int_var(ast, t) || !ast_is_int_var(ast, src->a)
+            || loop_writes(lo, t) != 2 || loop_writes(lo, src->a) != 1) {
+            prev = s;
+            s = m;
+            continue;
+        }
+        uint32_t i = src->a;
+        double c = ast_num(&ast->nodes[ast->nodes[m].b]);
+        double step = 0;
+        bool found = false;
+        for (uint32_t u = ast->nodes[m].next; u; u = ast->nodes[u].next) {
+            const ANode *w = &ast->nodes[u];
+            if ((w->kind == ND_ADD || w->kind == ND_SUB) && ast->nodes[w->a].a == i) {
+                if (ast->nodes[w->b].kind == ND_LITERAL) {
+                    step = ast_num(&ast->nodes[w->b]);
+                    if (w->kind == ND_SUB) step = -step;
+                    found = true;
+                }
+                break;
+            }
+        }
+        double delta = step * c;
+        if (!found || !is_exact_int(c) || fabs(c) >= INDUCTION_MUL_LIMIT || !is_exact_int(delta)) {
+            prev = s;
+            s = m;
+            continue;
+        }
+
+        // 宣言とかけ算をループの前へ移す (t は本体でしか見えないので、ループの後には影響しない)
+        uint32_t next = ast->nodes[m].next;
+        if (prev) ast->nodes[prev].next = next;
+        else ast->nodes[id].b = next;
+        ast->nodes[m].next = 0;
+        if (hoisted_tail) ast->nodes[hoisted_tail].next = s;
+        else hoisted = s;
+        hoisted_tail = m;
+
+        // 本体の最後で t に i の増分の c 倍をたす
+        uint32_t var = ast_new_node(lo->ctx, ast, ND_VAR);
+        ast->nodes[var].a = t;
+        uint32_t lit = ast_new_node(lo->ctx, ast, ND_LITERAL);
+        set_literal(&ast->nodes[lit], delta);
+        uint32_t add = ast_new_node(lo->ctx, ast, ND_ADD);
+        ast->nodes[add].a = var;
+        ast->nodes[add].b = lit;
+        uint32_t tail = list_tail(ast, ast->nodes[id].b);
+        if (tail) ast->nodes[tail].next = add;
+        else ast->nodes[id].b = add;
+        if (lo->stats) lo->stats->reduced_ops++;
+        s = next;
+    }
+    return hoisted;
+}
+
+static uint32_t reduce_loops(LoopOpt *lo, uint32_t id) {
+    Ast *ast = lo->ast;
+    uint32_t head = 0, tail = 0;
+    while (id) {
+        uint32_t next = ast->nodes[id].next;
+        ast->nodes[id].next = 0;
+        uint32_t repl = id;
+        switch (ast->nodes[id].kind) {
+        case ND_PROGRAM:
+        case ND_BLOCK: {
+            uint32_t a = reduce_loops(lo, ast->nodes[id].a);
+            ast->nodes[id].a = a;
+            break;
+        }
+        case ND_IF:
+        case ND_ELSEIF: {
+            uint32_t b = reduce_loops(lo, ast->nodes[id].b);
+            uint32_t c = ast->nodes[id].c;
+            if (c && ast->nodes[c].kind != ND_ELSEIF) c = reduce_loops(lo, c);
+            else if (c) reduce_loops(lo, c);
+            ast->nodes[id].b = b;
+            ast->nodes[id].c = c;
+            break;
+        }
+        case ND_LOOP: {
+            uint32_t body = reduce_loops(lo, ast->nodes[id].b);
+            ast->nodes[id].b = body;
+            uint32_t hoisted = reduce_loop(lo, id);
+            if (hoisted) {
+                ast->nodes[list_tail(ast, hoisted)].next = id;
+                repl = hoisted;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        if (tail) ast->nodes[tail].next = repl;
+        else head = repl;
+        tail = list_tail(ast, repl);
+        id = next;
+    }
+    return head;
+}
+
+static void optimize_loops(JpcContext *ctx, Ast *ast, bool reduce, OptStats *stats) {
+    LoopOpt lo = { .ctx = ctx, .ast = ast, .stats = stats };
+    lo.nvars = ast_var_count(ast);
+    lo.writes = alloc_array(ctx, lo.nvars, sizeof(uint32_t));
+    lo.write_gen = alloc_array(ctx, lo.nvars, sizeof(uint32_t));
+    lo.read_gen = alloc_array(ctx, lo.nvars, sizeof(uint32_t));
+    if (reduce) reduce_loops(&lo, ast->root);
+    else opt_loops(&lo, ast->root);
+    free(lo.writes);
+    free(lo.write_gen);
+    free(lo.read_gen);
+}
+
+// --- エントリーポイント ---
+
+bool optimize_ast(JpcContext *ctx, Ast *ast, int level, bool loops, OptStats *stats) {
+    if (stats) *stats = (OptStats){ 0 };
+    if (level <= 0) return true;
+    jmp_buf env;
+    jmp_buf *prev = ctx->error_jmp;
+    ctx->error_jmp = &env;
+    if (setjmp(env) != 0) {
+        ctx->error_jmp = prev;
+        return false;
+    }
+    propagate_constants(ctx, ast);
+    eliminate_dead_code(ctx, ast, stats);
+    if (loops) optimize_loops(ctx, ast, false, stats);
+    if (level >= 2) {
+        infer_int_vars(ctx, ast);
+        if (loops) optimize_loops(ctx, ast, true, stats);
+    }
+    ctx->error_jmp = prev;
+    return true;
+}
@@ -0,0 +1,32 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include <stdbool.h>
+#include "ast.h"
+
+// --- AST の最適化 ---
+// コード生成の直前に、コンパクトな AST をその場で書き換える。
+// 最適化レベル (jpc -O):
+//   0: 何もしない
+//   1: 定数の伝播と畳み込み、到達しない分岐と使われない代入の削除、
+//      ループで変わらない文の移動、2 のべき乗のわり算のかけ算化 (既定)
+//   2: 1 に加えて、整数の値しか持たない変数を int64_t で出力し、帰納変数のかけ算をたし算にする
+#define OPT_LEVEL_DEFAULT 1
+#define OPT_LEVEL_MAX 2
+
+// 最適化で消したものの数
+typedef struct {
+    uint32_t removed_nodes;     // 消したノードの総数
+    uint32_t removed_branches;  // 消した もし／ではなく
+    uint32_t removed_loops;     // 一度も実行されないので消した ループ
+    uint32_t removed_stores;    // 読まれない変数への書き込み
+    uint32_t hoisted_stmts;     // ループの前に移した文
+    uint32_t reduced_ops;       // かけ算にした わる と、たし算にした かける
+} OptStats;
+
+// loops が false なら、ループの最適化 (文の移動と、わる・かける の置き換え) だけを行わない。
+// stats が NULL でなければ、消したものの数を書き込む。
+// エラーの場合は ctx にエラーを記録して false を返す
+bool optimize_ast(JpcContext *ctx, Ast *ast, int level, bool loops, OptStats *stats);
+
+#endif
@@ -0,0 +1,47 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bench-util.h"
+
+// 出力の多い入力を、printf を直接呼ぶコード (--stdio) とランタイムを埋め込んだコードにして、生成した実行ファイルの速さを比べる
+
+// 小数と整数を埋め込んだ行を lines 行出力する入力を生成する
+static void generate_input(FILE *fp, long lines) {
+    fprintf(fp, "メイン｛\n");
+    fprintf(fp, "　　”i”を「０」で宣言する。\n");
+    fprintf(fp, "　　”x”を「０」で宣言する。\n");
+    fprintf(fp, "　　ループ（”i”が「%ld」より小さいか）｛\n", lines);
+    fprintf(fp, "　　　　”x”に「０．３７５」をたす。\n");
+    fprintf(fp, "　　　　「”i”行目：値は”x”、１００％」と出力する。\n");
+    fprintf(fp, "　　　　”i”に「１」をたす。\n");
+    fprintf(fp, "　　｝\n");
+    fprintf(fp, "　　「１２３４５６７」と出力する。\n");
+    fprintf(fp, "｝\n");
+}
+
+int main(int argc, char *argv[]) {
+    long lines = argc > 1 ? atol(argv[1]) : 5000000;
+    char dir[] = "/tmp/jpc-output-bench-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        fprintf(stderr, "Error: Cannot create temporary directory\n");
+        return 1;
+    }
+    char src[4096 + 16];
+    snprintf(src, sizeof(src), "%s/output.jpc", dir);
+    if (!bench_write_source(src, generate_input, lines)) {
+        fprintf(stderr, "Error: Cannot write %s\n", src);
+        return 1;
+    }
+
+    DriverOptions variants[2] = {
+        { OPT_LEVEL_DEFAULT, false, { .use_runtime = false }, BUILD_DEFAULTS, false },
+        { OPT_LEVEL_DEFAULT, false, { .use_runtime = true }, BUILD_DEFAULTS, false },
+    };
+    const char *const names[2] = { "printf  (--stdio)", "runtime (default)" };
+    printf("=== Output Bench: %ld lines ===\n", lines);
+    bool same = bench_compare(src, NULL, variants, names, 3);
+
+    unlink(src);
+    rmdir(dir);
+    return same ? 0 : 1;
+}
@@ -2,62 +2,79 @@
 #include <stdlib.h>
 #include "lexer.h"
 #include "parser.h"
+#include "context.h"
+#include "ast.h"
 
-// ASTを再帰的に表示するデバッグ関数
-void print_ast(Node *node, int depth) {
-    if (node == NULL) return;
-
+static void print_label(int depth, const char *label) {
     for (int i = 0; i < depth; i++) printf("  ");
+    printf("%s:\n", label);
+}
 
-    switch (node->kind) {
-        case ND_PROGRAM: printf("PROGRAM\n"); break;
-        case ND_BLOCK:   printf("BLOCK\n"); break;
-        case ND_IF:      printf("IF\n"); break;
-        case ND_ELSEIF:  printf("ELSE IF\n"); break;
-        case ND_LOOP:    printf("LOOP\n"); break;
-        case ND_DECLARE: printf("DECLARE\n"); break;
-        case ND_ASSIGN:  printf("ASSIGN\n"); break;
-        case ND_ADD:     printf("ADD\n"); break;
-        case ND_SUB:     printf("SUB\n"); break;
-        case ND_MUL:     printf("MUL\n"); break;
-        case ND_DIV:     printf("DIV\n"); break;
-        case ND_INPUT:   printf("INPUT\n"); break;
-        case ND_OUTPUT:  printf("OUTPUT\n"); break;
-        case ND_VAR:     printf("VAR: %s\n", node->name); break;
-        case ND_LITERAL: printf("NUM: %f\n", node->val); break;
-        case ND_STR_LIT: printf("STR: %s\n", node->strVal); break;
-        case ND_EQ:      printf("EQ (==)\n"); break;
-        case ND_NE:      printf("NE (!=)\n"); break;
-        case ND_LT:      printf("LT (<)\n"); break;
-        case ND_LE:      printf("LE (<=)\n"); break;
-        case ND_GT:      printf("GT (>)\n"); break;
-        case ND_GE:      printf("GE (>=)\n"); break;
-        case ND_AND:     printf("AND\n"); break;
-        case ND_OR:      printf("OR\n"); break;
-        default:         printf("UNKNOWN NODE (%d)\n", node->kind); break;
-    }
+// コンパクトな AST を再帰的に表示するデバッグ関数 (id から始まる文の列を表示する)
+void print_ast(const Ast *ast, uint32_t id, int depth) {
+    for (; id; id = ast->nodes[id].next) {
+        const ANode *node = &ast->nodes[id];
 
-    // 子ノードや次の文を表示
-    if (node->cond) {
-        for (int i = 0; i < depth+1; i++) printf("  ");
-        printf("[cond]:\n");
-        print_ast(node->cond, depth + 2);
-    }
-    if (node->then) {
-        for (int i = 0; i < depth+1; i++) printf("  ");
-        printf("[then]:\n");
-        print_ast(node->then, depth + 2);
-    }
-    if (node->els) {
-        for (int i = 0; i < depth+1; i++) printf("  ");
-        printf("[else]:\n");
-        print_ast(node->els, depth + 2);
+        for (int i = 0; i < depth; i++) printf("  ");
+
+        switch (node->kind) {
+            case ND_PROGRAM: printf("PROGRAM\n"); break;
+            case ND_BLOCK:   printf("BLOCK\n"); break;
+            case ND_IF:      printf("IF\n"); break;
+            case ND_ELSEIF:  printf("ELSE IF\n"); break;
+            case ND_LOOP:    printf("LOOP\n"); break;
+            case ND_DECLARE: printf("DECLARE\n"); break;
+            case ND_ASSIGN:  printf("ASSIGN\n"); break;
+            case ND_ADD:     printf("ADD\n"); break;
+            case ND_SUB:     printf("SUB\n"); break;
+            case ND_MUL:     printf("MUL\n"); break;
+            case ND_DIV:     printf("DIV\n"); break;
+            case ND_INPUT:   printf("INPUT\n"); break;
+            case ND_OUTPUT:  printf("OUTPUT\n"); break;
+            case ND_VAR:     printf("VAR: %s\n", ast->names[node->a]); break;
+            case ND_LITERAL: printf("NUM: %f\n", ast_num(node)); break;
+            case ND_STR_LIT: printf("STR: %s\n", ast_str(ast, node)); break;
+            case ND_EQ:      printf("EQ (==)\n"); break;
+            case ND_NE:      printf("NE (!=)\n"); break;
+            case ND_LT:      printf("LT (<)\n"); break;
+            case ND_LE:      printf("LE (<=)\n"); break;
+            case ND_GT:      printf("GT (>)\n"); break;
+            case ND_GE:      printf("GE (>=)\n"); break;
+            case ND_AND:     printf("AND\n"); break;
+            case ND_OR:      printf("OR\n"); break;
+            default:         printf("UNKNOWN NODE (%u)\n", node->kind); break;
+        }
+
+        // 子ノードを表示 (文の列は同じインデントで)
+        switch (node->kind) {
+            case ND_PROGRAM:
+            case ND_BLOCK:
+                print_ast(ast, node->a, depth);
+                break;
+            case ND_IF:
+            case ND_ELSEIF:
+            case ND_LOOP:
+                print_label(depth + 1, "[cond]");
+                print_ast(ast, node->a, depth + 2);
+                if (node->b) {
+                    print_label(depth + 1, "[then]");
+                    print_ast(ast, node->b, depth + 2);
+                }
+                if (node->c) {
+                    print_label(depth + 1, "[else]");
+                    print_ast(ast, node->c, depth + 2);
+                }
+                break;
+            case ND_VAR:
+            case ND_LITERAL:
+            case ND_STR_LIT:
+                break;
+            default:
+                print_ast(ast, node->a, depth + 1);
+                print_ast(ast, node->b, depth + 1);
+                break;
+        }
     }
-    
-    if (node->lhs) print_ast(node->lhs, depth + 1);
-    if (node->rhs) print_ast(node->rhs, depth + 1);
-    
-    if (node->next) print_ast(node->next, depth); // 兄弟ノードは同じインデントで
 }
 
 int main(int argc, char *argv[]) {
@@ -73,17 +90,32 @@ int main(int argc, char *argv[]) {
     }
 
     // 1. Lexer初期化 (先読み)
-    getNextToken(fp);
+    JpcContext *ctx = new_context();
+    if (!initLexer(ctx, fp)) {
+        print_errors(ctx, stderr);
+        return 1;
+    }
+    getNextToken(ctx);
 
     // 2. Parser実行 (AST構築)
     printf("=== Parser Start ===\n");
-    Node *root = parse_program(fp);
+    Node *root = parse_program(ctx);
+    if (root == NULL) {
+        print_errors(ctx, stderr);
+        return 1;
+    }
     printf("=== Parser End ===\n");
 
     // 3. AST表示 (デバッグ)
+    const Ast *ast = build_ast(ctx, root);
+    if (ast == NULL) {
+        print_errors(ctx, stderr);
+        return 1;
+    }
     printf("=== AST Dump ===\n");
-    print_ast(root, 0);
+    print_ast(ast, ast->root, 0);
 
+    free_context(ctx);
     fclose(fp);
     return 0;
 }
\ No newline at end of file
@@ -2,101 +2,285 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <setjmp.h>
 #include "parser.h"
 #include "lexer.h"
 #include "error.h"
+#include "context.h"
 
 // --- スコープ・変数管理 ---
+// 宣言済みの変数は LVar のリスト (新しい順) に積む。リストは書き換えないので、
+// 先頭を覚えておけばその時点のスコープのスナップショットになる (save_scope / restore_scope)。
+// 名前からの検索には、インターン済みの名前ポインタをキーにした開番地法のハッシュ表を使う。
+// 表の各項目は同じ名前の束縛を新しい順に並べ、束縛ごとに宣言されたスコープの番号を持つ。
+// スコープを抜けるときは番号に閉じた印を付けるだけで、閉じたスコープの束縛は検索時に取り除く。
 typedef struct LVar LVar;
 struct LVar {
     LVar *next;
-    char *name;
+    const char *name;
     int id;
 };
-LVar *locals = NULL;
-int var_counter = 0;
 
-LVar *find_lvar(char *name) {
-    for (LVar *v = locals; v; v = v->next) {
-        if (strcmp(v->name, name) == 0) return v;
+typedef struct Binding Binding;
+struct Binding {
+    LVar *var;
+    int scope;       // 宣言されたスコープの番号
+    Binding *shadow; // 同じ名前の古い束縛
+};
+
+struct SymbolSlot {
+    const char *name; // インターン済みの名前 (NULL なら空き)
+    Binding *head;
+};
+
+struct ScopeInfo {
+    int parent;
+    bool closed;
+};
+
+static unsigned int hash_name(const char *name) {
+    uintptr_t p = (uintptr_t)name;
+    return (unsigned int)((p >> 3) * 2654435761u);
+}
+
+static void grow_symbol_table(JpcContext *ctx) {
+    int new_cap = ctx->sym_cap ? ctx->sym_cap * 2 : 256;
+    SymbolSlot *table = calloc(new_cap, sizeof(SymbolSlot));
+    if (table == NULL) error(ctx, ERR_SYSTEM, "メモリを確保できません");
+    for (int i = 0; i < ctx->sym_cap; i++) {
+        if (ctx->sym_table[i].name == NULL) continue;
+        int j = hash_name(ctx->sym_table[i].name) & (new_cap - 1);
+        while (table[j].name) j = (j + 1) & (new_cap - 1);
+        table[j] = ctx->sym_table[i];
     }
-    return NULL;
+    free(ctx->sym_table);
+    ctx->sym_table = table;
+    ctx->sym_cap = new_cap;
 }
 
-int register_lvar(char *name) {
-    for (LVar *v = locals; v; v = v->next) {
-        if (strcmp(v->name, name) == 0) {
-            error(ERR_SEMANTIC, "変数「%s」は既に宣言されています", name);
-        }
+// name の項目を探す。create が真なら無ければ作る (無くて作らない場合は NULL)
+static SymbolSlot *find_slot(JpcContext *ctx, const char *name, bool create) {
+    if (create && ctx->sym_used * 2 >= ctx->sym_cap) grow_symbol_table(ctx);
+    if (ctx->sym_cap == 0) return NULL;
+    int i = hash_name(name) & (ctx->sym_cap - 1);
+    while (ctx->sym_table[i].name) {
+        if (ctx->sym_table[i].name == name) return &ctx->sym_table[i];
+        i = (i + 1) & (ctx->sym_cap - 1);
+    }
+    if (!create) return NULL;
+    ctx->sym_table[i].name = name;
+    ctx->sym_used++;
+    return &ctx->sym_table[i];
+}
+
+// 閉じたスコープの束縛を先頭から取り除き、見えている束縛を返す
+static Binding *visible_binding(JpcContext *ctx, SymbolSlot *slot) {
+    while (slot->head && ctx->scopes[slot->head->scope].closed) slot->head = slot->head->shadow;
+    return slot->head;
+}
+
+static void bind_lvar(JpcContext *ctx, SymbolSlot *slot, LVar *v) {
+    Binding *b = context_alloc(ctx, sizeof(Binding));
+    b->var = v;
+    b->scope = ctx->current_scope;
+    b->shadow = slot->head;
+    slot->head = b;
+}
+
+// スコープ番号 0 は最も外側のスコープ
+static void ensure_root_scope(JpcContext *ctx) {
+    if (ctx->scope_count > 0) return;
+    ctx->scopes = malloc(sizeof(ScopeInfo) * 64);
+    if (ctx->scopes == NULL) error(ctx, ERR_SYSTEM, "メモリを確保できません");
+    ctx->scope_cap = 64;
+    ctx->scopes[0].parent = 0;
+    ctx->scopes[0].closed = false;
+    ctx->scope_count = 1;
+    ctx->current_scope = 0;
+}
+
+// 新しいスコープを開く
+static void open_scope(JpcContext *ctx) {
+    ensure_root_scope(ctx);
+    if (ctx->scope_count == ctx->scope_cap) {
+        ScopeInfo *scopes = realloc(ctx->scopes, sizeof(ScopeInfo) * ctx->scope_cap * 2);
+        if (scopes == NULL) error(ctx, ERR_SYSTEM, "メモリを確保できません");
+        ctx->scopes = scopes;
+        ctx->scope_cap *= 2;
+    }
+    int id = ctx->scope_count++;
+    ctx->scopes[id].parent = ctx->current_scope;
+    ctx->scopes[id].closed = false;
+    ctx->current_scope = id;
+}
+
+static void close_scope(JpcContext *ctx) {
+    ctx->scopes[ctx->current_scope].closed = true;
+    ctx->current_scope = ctx->scopes[ctx->current_scope].parent;
+}
+
+// name はインターン済みの文字列を渡す
+LVar *find_lvar(JpcContext *ctx, const char *name) {
+    SymbolSlot *slot = find_slot(ctx, name, false);
+    if (slot == NULL) return NULL;
+    Binding *b = visible_binding(ctx, slot);
+    return b ? b->var : NULL;
+}
+
+// 外側のスコープを含め、見えている変数と同じ名前は宣言できない (エラーは変数のトークン tok を指す)
+int register_lvar(JpcContext *ctx, const Token *tok, const char *name) {
+    ensure_root_scope(ctx);
+    SymbolSlot *slot = find_slot(ctx, name, true);
+    if (visible_binding(ctx, slot)) {
+        error_at(ctx, tok, ERR_SEMANTIC, "変数「%s」は既に宣言されています", name);
     }
-    LVar *v = calloc(1, sizeof(LVar));
-    v->name = strdup(name);
-    v->id = ++var_counter;
-    v->next = locals;
-    locals = v;
+    LVar *v = context_alloc(ctx, sizeof(LVar));
+    v->name = name;
+    v->id = ++ctx->var_counter;
+    v->next = ctx->locals;
+    ctx->locals = v;
+    bind_lvar(ctx, slot, v);
     return v->id;
 }
 
+// 変数表を空にする (アリーナを解放する前に呼ぶ)
+void reset_scope(JpcContext *ctx) {
+    free(ctx->sym_table);
+    ctx->sym_table = NULL;
+    ctx->sym_cap = ctx->sym_used = 0;
+    ctx->scope_count = 0;
+    ctx->current_scope = 0;
+    ctx->locals = NULL;
+}
+
+LVar *save_scope(JpcContext *ctx) {
+    return ctx->locals;
+}
+
+// スコープをスナップショットの時点に戻す。
+// 現在のスコープと同じなら何もしない。それ以外 (診断サーバが別の文の直前に戻る場合) は、
+// 新しいスコープを開き、スナップショットの変数を登録し直す
+void restore_scope(JpcContext *ctx, LVar *scope) {
+    if (scope == ctx->locals) return;
+    for (int i = 0; i < ctx->scope_count; i++) ctx->scopes[i].closed = true;
+    open_scope(ctx);
+    for (LVar *v = scope; v; v = v->next) {
+        bind_lvar(ctx, find_slot(ctx, v->name, true), v);
+    }
+    ctx->locals = scope;
+}
+
 // --- ノード生成 ---
-Node *new_node(NodeKind kind) {
-    Node *node = calloc(1, sizeof(Node));
+// ノードは文脈のアリーナから確保し、個別には解放しない
+Node *new_node(JpcContext *ctx, NodeKind kind) {
+    Node *node = context_alloc(ctx, sizeof(Node));
     node->kind = kind;
     return node;
 }
-Node *new_binary(NodeKind kind, Node *lhs, Node *rhs) {
-    Node *node = new_node(kind);
+Node *new_binary(JpcContext *ctx, NodeKind kind, Node *lhs, Node *rhs) {
+    Node *node = new_node(ctx, kind);
     node->lhs = lhs;
     node->rhs = rhs;
     return node;
 }
-Node *new_num(double val) {
-    Node *node = new_node(ND_LITERAL);
+Node *new_num(JpcContext *ctx, double val) {
+    Node *node = new_node(ctx, ND_LITERAL);
     node->val = val;
     return node;
 }
-Node *new_var_node(char *name) {
-    LVar *lvar = find_lvar(name);
-    if (!lvar) error(ERR_SEMANTIC, "未定義の変数「%s」が参照されています", name);
-    Node *node = new_node(ND_VAR);
-    node->name = strdup(name);
+// name はインターン済みの文字列 (internToken) を渡す。エラーは変数のトークン tok を指す
+Node *new_var_node(JpcContext *ctx, const Token *tok, const char *name) {
+    LVar *lvar = find_lvar(ctx, name);
+    if (!lvar) error_at(ctx, tok, ERR_SEMANTIC, "未定義の変数「%s」が参照されています", name);
+    Node *node = new_node(ctx, ND_VAR);
+    node->name = name;
     node->var_id = lvar->id;
     return node;
 }
-Node *new_str_lit_node(char *content) {
-    Node *node = new_node(ND_STR_LIT);
-    char fmt[2048] = {0};
-    int *ids = calloc(128, sizeof(int));
+// 書式文字列を組み立てるための伸長バッファ (領域は文脈のアリーナから取る)
+typedef struct {
+    char *buf;
+    int len;
+    int cap;
+} FmtBuf;
+
+// n バイト追記できるだけの容量を確保する (足りなければ倍々に伸ばす)
+static void fmt_reserve(JpcContext *ctx, FmtBuf *b, int n) {
+    if (b->len + n <= b->cap) return;
+    int cap = b->cap * 2;
+    while (cap < b->len + n) cap *= 2;
+    char *buf = context_alloc(ctx, cap);
+    memcpy(buf, b->buf, b->len);
+    b->buf = buf;
+    b->cap = cap;
+}
+
+static void fmt_append(JpcContext *ctx, FmtBuf *b, const char *s, int n) {
+    fmt_reserve(ctx, b, n);
+    memcpy(b->buf + b->len, s, n);
+    b->len += n;
+}
+
+// 出力文字列リテラルのトークン tok を printf の書式と埋め込み変数の列に変換する。
+// 本体を先頭から1回だけ走査し、”変数名” はその場で閉じ引用符を探して解決する。
+Node *new_str_lit_node(JpcContext *ctx, const Token *tok) {
+    const char *content = getTokenText(ctx, tok);
+    int len = tok->len;
+    Node *node = new_node(ctx, ND_STR_LIT);
+    const char *p = content;
+    const char *end = content + len;
+    int no_newline = (len >= 3 && memcmp(end - 3, "：", 3) == 0);
+
+    // 大半のリテラルはエスケープが少ないので、本体長 + 末尾分で始めれば伸長はまれ
+    FmtBuf fmt = { context_alloc(ctx, len + 4), 0, len + 4 };
+    int ids_cap = 4;
+    int *ids = context_alloc(ctx, sizeof(int) * ids_cap);
     int argc = 0;
-    char *p = content;
-    int len = strlen(content);
-    int no_newline = 0;
-    if (len >= 3 && strcmp(content + len - 3, "：") == 0) no_newline = 1;
-
-    while (*p) {
-        if (strncmp(p, "”", 3) == 0) {
-            p += 3;
-            char *start = p;
-            char *end = strstr(start, "”");
-            if (end) {
-                int var_len = end - start;
-                char var_name[256] = {0};
-                strncpy(var_name, start, var_len);
-                LVar *lvar = find_lvar(var_name);
-                if (!lvar) error(ERR_SEMANTIC, "文字列内で未定義の変数「%s」が使われています", var_name);
-                ids[argc++] = lvar->id;
-                strcat(fmt, "%f");
-                p = end + 3;
-            } else {
-                strcat(fmt, "”");
+
+    while (p < end) {
+        if (end - p >= 3 && memcmp(p, "”", 3) == 0) {
+            const char *start = p + 3;
+            const char *close = start;
+            while (close + 3 <= end && memcmp(close, "”", 3) != 0) close++;
+            if (close + 3 > end) {
+                // 閉じ引用符がなければそのまま文字として出す
+                fmt_append(ctx, &fmt, p, 3);
+                p = start;
+                continue;
+            }
+            const char *var_name = internString(ctx, start, close - start);
+            LVar *lvar = find_lvar(ctx, var_name);
+            if (!lvar) {
+                // エラーはリテラルの中の変数名を指す
+                Token var_tok = { TK_VARIABLE, 0, tok->line, tok->offset + (int)(start - content), (int)(close - start) };
+                for (const char *c = content; c < start; c++) if (*c == '\n') var_tok.line++;
+                error_at(ctx, &var_tok, ERR_SEMANTIC, "文字列内で未定義の変数「%s」が使われています", var_name);
             }
-        } 
-        else if (*p == '"') { strcat(fmt, "\\\""); p++; }
-        else if (*p == '%') { strcat(fmt, "%%"); p++; }
-        else if (*p == '\\') { strcat(fmt, "\\\\"); p++; }
-        else { strncat(fmt, p, 1); p++; }
+            if (argc == ids_cap) {
+                int *grown = context_alloc(ctx, sizeof(int) * ids_cap * 2);
+                memcpy(grown, ids, sizeof(int) * argc);
+                ids = grown;
+                ids_cap *= 2;
+            }
+            ids[argc++] = lvar->id;
+            fmt_append(ctx, &fmt, "%f", 2);
+            p = close + 3;
+        }
+        else if (*p == '"') { fmt_append(ctx, &fmt, "\\\"", 2); p++; }
+        else if (*p == '%') { fmt_append(ctx, &fmt, "%%", 2); p++; }
+        else if (*p == '\\') { fmt_append(ctx, &fmt, "\\\\", 2); p++; }
+        else {
+            // 特別扱いする文字が現れるまでまとめて写す
+            const char *run = p + 1;
+            while (run < end && *run != '"' && *run != '%' && *run != '\\' && (unsigned char)*run != 0xE2) run++;
+            fmt_append(ctx, &fmt, p, run - p);
+            p = run;
+        }
     }
-    if (!no_newline) strcat(fmt, "\\n");
-    node->strVal = strdup(fmt);
+    if (!no_newline) fmt_append(ctx, &fmt, "\\n", 2);
+    fmt_append(ctx, &fmt, "", 1);
+    node->strVal = fmt.buf;
     node->args = ids;
     node->argc = argc;
     return node;
@@ -106,355 +290,370 @@ Node *new_str_lit_node(char *content) {
 
 // 直前の空白・改行禁止をチェックする関数
 // context: エラーメッセージ用の文脈（例: "「。」の前"）
-void check_no_space(const char *context) {
-    if (current_token.has_space_before || current_token.has_newline_before) {
-        error(ERR_SYNTAX, "%sには空白・改行を入れてはいけません (Token: %s)", context, current_token.str);
+void check_no_space(JpcContext *ctx, const char *context) {
+    if (ctx->current_token.flags & (TKF_SPACE_BEFORE | TKF_NEWLINE_BEFORE)) {
+        error(ctx, ERR_SYNTAX, "%sには空白・改行を入れてはいけません (Token: %.*s)", context, ctx->current_token.len, getTokenText(ctx, &ctx->current_token));
     }
 }
 
 // 直前の空白または改行必須をチェックする関数
 // context: エラーメッセージ用の文脈（例: "「かつ」の前"）
-void check_has_space(const char *context) {
-    if (!current_token.has_space_before && !current_token.has_newline_before) {
-        error(ERR_SYNTAX, "%sには空白または改行が必要です (Token: %s)", context, current_token.str);
+void check_has_space(JpcContext *ctx, const char *context) {
+    if (!(ctx->current_token.flags & (TKF_SPACE_BEFORE | TKF_NEWLINE_BEFORE))) {
+        error(ctx, ERR_SYNTAX, "%sには空白または改行が必要です (Token: %.*s)", context, ctx->current_token.len, getTokenText(ctx, &ctx->current_token));
     }
 }
 
 // 指定されたトークンであることを確認し、消費する
-void expect(TokenType type, FILE *fp) {
-    if (current_token.type == type) {
-        getNextToken(fp);
+void expect(JpcContext *ctx, TokenType type) {
+    if (ctx->current_token.type == type) {
+        getNextToken(ctx);
     } else {
-        error(ERR_SYNTAX, "「%s」が期待されていましたが、「%s」が代わりに発見されました (Token: %s)", getTokenName(type), getTokenName(current_token.type), current_token.str);
+        error(ctx, ERR_SYNTAX, "「%s」が期待されていましたが、「%s」が代わりに発見されました (Token: %.*s)", getTokenName(type), getTokenName(ctx->current_token.type), ctx->current_token.len, getTokenText(ctx, &ctx->current_token));
     }
 }
 
 
 // --- 構文解析関数 ---
 
-Node *parse_program(FILE *fp);
-Node *parse_statements_block(FILE *fp);
-Node *parse_statement(FILE *fp);
-Node *parse_simple_statement(FILE *fp);
-Node *parse_loop_or_if_statement(FILE *fp);
-Node *parse_conditional_block(FILE *fp, NodeKind kind);
-Node *parse_if_statement_block(FILE *fp);
-Node *parse_simple_statement_suffix(FILE *fp, char *name);
-Node *parse_simple_statement_suffix_wo(FILE *fp, char *name);
-Node *parse_simple_statement_suffix_ni(FILE *fp, char *name);
-Node *parse_simple_statement_suffix_kara(FILE *fp, char *name);
-Node *parse_condition_expression(FILE *fp);
-Node *parse_condition_term(FILE *fp);
-Node *parse_condition_factor(FILE *fp);
-Node *parse_simple_condition(FILE *fp);
-Node *parse_comparison_op(FILE *fp, Node *lhs, Node *rhs);
-Node *parse_value(FILE *fp);
-
-Node *parse_program(FILE *fp) {
-    expect(TK_MAIN, fp);
-    Node *node = new_node(ND_PROGRAM);
-    node->next = parse_statements_block(fp);
+Node *parse_program(JpcContext *ctx);
+Node *parse_statements_block(JpcContext *ctx);
+Node *parse_statement(JpcContext *ctx);
+Node *parse_simple_statement(JpcContext *ctx);
+Node *parse_loop_or_if_statement(JpcContext *ctx);
+Node *parse_conditional_block(JpcContext *ctx, NodeKind kind);
+Node *parse_if_statement_block(JpcContext *ctx);
+Node *parse_simple_statement_suffix(JpcContext *ctx, const Token *var_tok, const char *name);
+Node *parse_simple_statement_suffix_wo(JpcContext *ctx, const Token *var_tok, const char *name);
+Node *parse_simple_statement_suffix_ni(JpcContext *ctx, const Token *var_tok, const char *name);
+Node *parse_simple_statement_suffix_kara(JpcContext *ctx, const Token *var_tok, const char *name);
+Node *parse_condition_expression(JpcContext *ctx);
+Node *parse_condition_term(JpcContext *ctx);
+Node *parse_condition_factor(JpcContext *ctx);
+Node *parse_simple_condition(JpcContext *ctx);
+Node *parse_comparison_op(JpcContext *ctx, Node *lhs, Node *rhs);
+Node *parse_value(JpcContext *ctx);
+
+// プログラム全体を解析する。エラーの場合は ctx にエラーを記録して NULL を返す
+Node *parse_program(JpcContext *ctx) {
+    jmp_buf env;
+    jmp_buf *prev = ctx->error_jmp;
+    ctx->error_jmp = &env;
+    if (setjmp(env) != 0) {
+        ctx->error_jmp = prev;
+        return NULL;
+    }
+    expect(ctx, TK_MAIN);
+    Node *node = new_node(ctx, ND_PROGRAM);
+    node->next = parse_statements_block(ctx);
+    ctx->error_jmp = prev;
     return node;
 }
 
-Node *parse_statements_block(FILE *fp) {
-    LVar *scope_snapshot = locals;
-    expect(TK_LBRACE, fp);
+Node *parse_statements_block(JpcContext *ctx) {
+    LVar *scope_snapshot = ctx->locals;
+    expect(ctx, TK_LBRACE);
+    open_scope(ctx);
 
     Node head; head.next = NULL;
     Node *cur = &head;
 
     while (
-        current_token.type == TK_VARIABLE || 
-        current_token.type == TK_PRINT_LIT || 
-        current_token.type == TK_LITERAL ||
-        current_token.type == TK_LOOP || 
-        current_token.type == TK_IF
+        ctx->current_token.type == TK_VARIABLE || 
+        ctx->current_token.type == TK_PRINT_LIT || 
+        ctx->current_token.type == TK_LITERAL ||
+        ctx->current_token.type == TK_LOOP || 
+        ctx->current_token.type == TK_IF
     ) {
-        cur->next = parse_statement(fp);
+        cur->next = parse_statement(ctx);
         cur = cur->next;
     }
 
-    expect(TK_RBRACE, fp);
-    locals = scope_snapshot;
+    expect(ctx, TK_RBRACE);
+    close_scope(ctx);
+    ctx->locals = scope_snapshot;
     return head.next;
 }
 
-Node *parse_statement(FILE *fp) {
+Node *parse_statement(JpcContext *ctx) {
     Node *node;
-    if (current_token.type == TK_VARIABLE || current_token.type == TK_PRINT_LIT || current_token.type == TK_LITERAL) {
-        node = parse_simple_statement(fp);
+    if (ctx->current_token.type == TK_VARIABLE || ctx->current_token.type == TK_PRINT_LIT || ctx->current_token.type == TK_LITERAL) {
+        node = parse_simple_statement(ctx);
         
-        if (current_token.type == TK_PERIOD) {
-            check_no_space("文末の「。」の前");
+        if (ctx->current_token.type == TK_PERIOD) {
+            check_no_space(ctx, "文末の「。」の前");
         }
-        expect(TK_PERIOD, fp); 
-    } else if (current_token.type == TK_LOOP || current_token.type == TK_IF) {
-        node = parse_loop_or_if_statement(fp);
+        expect(ctx, TK_PERIOD); 
+    } else if (ctx->current_token.type == TK_LOOP || ctx->current_token.type == TK_IF) {
+        node = parse_loop_or_if_statement(ctx);
     } else {
-        error(ERR_SYNTAX, "文が期待されています (Token: %s)", current_token.str);
+        error(ctx, ERR_SYNTAX, "文が期待されています (Token: %.*s)", ctx->current_token.len, getTokenText(ctx, &ctx->current_token));
     }
     return node;
 }
 
-Node *parse_simple_statement(FILE *fp) {
+Node *parse_simple_statement(JpcContext *ctx) {
     Node *node;
 
-    if (current_token.type == TK_VARIABLE) {
-        char *name = strdup(current_token.str);
-        getNextToken(fp);
+    if (ctx->current_token.type == TK_VARIABLE) {
+        // 未定義・二重定義のエラーで変数を指せるように、読み進める前のトークンを取っておく
+        Token var_tok = ctx->current_token;
+        const char *name = internToken(ctx, &var_tok);
+        getNextToken(ctx);
         // 変数直後の空白チェックは各suffix関数内で行う
-        node = parse_simple_statement_suffix(fp, name);
+        node = parse_simple_statement_suffix(ctx, &var_tok, name);
     } 
-    else if (current_token.type == TK_PRINT_LIT || current_token.type == TK_LITERAL) {
+    else if (ctx->current_token.type == TK_PRINT_LIT || ctx->current_token.type == TK_LITERAL) {
         Node *val;
-        if (current_token.type == TK_LITERAL) val = new_num(atof(current_token.str));
-        else val = new_str_lit_node(current_token.str);
-        getNextToken(fp);
+        if (ctx->current_token.type == TK_LITERAL) val = new_num(ctx, getTokenValue(ctx, &ctx->current_token));
+        else {
+            val = new_str_lit_node(ctx, &ctx->current_token);
+        }
+        getNextToken(ctx);
         
-        if (current_token.type == TK_OUTPUT) {
-            check_no_space("「と出力する」の前");
+        if (ctx->current_token.type == TK_OUTPUT) {
+            check_no_space(ctx, "「と出力する」の前");
         }
-        expect(TK_OUTPUT, fp);
+        expect(ctx, TK_OUTPUT);
         
-        node = new_node(ND_OUTPUT);
+        node = new_node(ctx, ND_OUTPUT);
         node->lhs = val;
     } 
     else {
-        error(ERR_SYNTAX, "不明な単文です");
+        error(ctx, ERR_SYNTAX, "不明な単文です");
     }
     return node;
 }
 
-Node *parse_loop_or_if_statement(FILE *fp) {
+Node *parse_loop_or_if_statement(JpcContext *ctx) {
     Node *node;
-    if (current_token.type == TK_LOOP) {
-        getNextToken(fp);
-        node = parse_conditional_block(fp, ND_LOOP);
-    } else if (current_token.type == TK_IF) {
-        getNextToken(fp);
-        node = parse_if_statement_block(fp);
+    if (ctx->current_token.type == TK_LOOP) {
+        getNextToken(ctx);
+        node = parse_conditional_block(ctx, ND_LOOP);
+    } else if (ctx->current_token.type == TK_IF) {
+        getNextToken(ctx);
+        node = parse_if_statement_block(ctx);
     } else {
-        error(ERR_SYNTAX, "不明なブロック文です");
+        error(ctx, ERR_SYNTAX, "不明なブロック文です");
     }
     return node;
 }
 
-Node *parse_conditional_block(FILE *fp, NodeKind kind) {
-    expect(TK_LPAR, fp);
-    Node *cond = parse_condition_expression(fp);
-    expect(TK_RPAR, fp);
+Node *parse_conditional_block(JpcContext *ctx, NodeKind kind) {
+    expect(ctx, TK_LPAR);
+    Node *cond = parse_condition_expression(ctx);
+    expect(ctx, TK_RPAR);
     
-    Node *body = parse_statements_block(fp);
+    Node *body = parse_statements_block(ctx);
 
-    Node *node = new_node(kind);
+    Node *node = new_node(ctx, kind);
     node->cond = cond;
     node->then = body;
     return node;
 }
 
-Node *parse_if_statement_block(FILE *fp) {
-    Node *node = parse_conditional_block(fp, ND_IF);
+Node *parse_if_statement_block(JpcContext *ctx) {
+    Node *node = parse_conditional_block(ctx, ND_IF);
     Node *curr = node;
 
-    while (current_token.type == TK_ELSEIF) {
-        getNextToken(fp);
-        Node *elif_node = parse_conditional_block(fp, ND_ELSEIF);
+    while (ctx->current_token.type == TK_ELSEIF) {
+        getNextToken(ctx);
+        Node *elif_node = parse_conditional_block(ctx, ND_ELSEIF);
         curr->els = elif_node;
         curr = elif_node;
     }
     
-    if (current_token.type == TK_ELSE) {
-        getNextToken(fp);
-        curr->els = parse_statements_block(fp);
+    if (ctx->current_token.type == TK_ELSE) {
+        getNextToken(ctx);
+        curr->els = parse_statements_block(ctx);
     }
 
     return node;
 }
 
-Node *parse_simple_statement_suffix(FILE *fp, char *name) {
-    if (current_token.type == TK_WO) {
-        check_no_space("助詞「を」の前");
-        getNextToken(fp);
-        check_no_space("助詞「を」の後");
-        return parse_simple_statement_suffix_wo(fp, name);
-    } else if (current_token.type == TK_NI) {
-        check_no_space("助詞「に」の前");
-        getNextToken(fp);
-        check_no_space("助詞「に」の後");
-        return parse_simple_statement_suffix_ni(fp, name);
-    } else if (current_token.type == TK_KARA) {
-        check_no_space("助詞「から」の前");
-        getNextToken(fp);
-        check_no_space("助詞「から」の後");
-        return parse_simple_statement_suffix_kara(fp, name);
+Node *parse_simple_statement_suffix(JpcContext *ctx, const Token *var_tok, const char *name) {
+    if (ctx->current_token.type == TK_WO) {
+        check_no_space(ctx, "助詞「を」の前");
+        getNextToken(ctx);
+        check_no_space(ctx, "助詞「を」の後");
+        return parse_simple_statement_suffix_wo(ctx, var_tok, name);
+    } else if (ctx->current_token.type == TK_NI) {
+        check_no_space(ctx, "助詞「に」の前");
+        getNextToken(ctx);
+        check_no_space(ctx, "助詞「に」の後");
+        return parse_simple_statement_suffix_ni(ctx, var_tok, name);
+    } else if (ctx->current_token.type == TK_KARA) {
+        check_no_space(ctx, "助詞「から」の前");
+        getNextToken(ctx);
+        check_no_space(ctx, "助詞「から」の後");
+        return parse_simple_statement_suffix_kara(ctx, var_tok, name);
     } else {
-        error(ERR_SYNTAX, "「を」「に」「から」が期待されています");
+        error(ctx, ERR_SYNTAX, "「を」「に」「から」が期待されています");
     }
     return NULL;
 }
 
-Node *parse_simple_statement_suffix_wo(FILE *fp, char *name) {
-    Node *val = parse_value(fp);
+Node *parse_simple_statement_suffix_wo(JpcContext *ctx, const Token *var_tok, const char *name) {
+    Node *val = parse_value(ctx);
     
-    if (current_token.type == TK_DECLARE) {
-        check_no_space("「で宣言する」の前");
-        getNextToken(fp);
-        int id = register_lvar(name);
-        Node *target = new_node(ND_VAR);
+    if (ctx->current_token.type == TK_DECLARE) {
+        check_no_space(ctx, "「で宣言する」の前");
+        getNextToken(ctx);
+        int id = register_lvar(ctx, var_tok, name);
+        Node *target = new_node(ctx, ND_VAR);
         target->name = name;
         target->var_id = id;
-        return new_binary(ND_DECLARE, target, val);
-    } else if (current_token.type == TK_DIV) {
-        check_no_space("「でわる」の前");
-        getNextToken(fp);
-        Node *target = new_var_node(name);
-        return new_binary(ND_DIV, target, val);
+        return new_binary(ctx, ND_DECLARE, target, val);
+    } else if (ctx->current_token.type == TK_DIV) {
+        check_no_space(ctx, "「でわる」の前");
+        getNextToken(ctx);
+        Node *target = new_var_node(ctx, var_tok, name);
+        return new_binary(ctx, ND_DIV, target, val);
     } else {
-        error(ERR_SYNTAX, "「で宣言する」または「でわる」が期待されています");
+        error(ctx, ERR_SYNTAX, "「で宣言する」または「でわる」が期待されています");
     }
     return NULL;
 }
 
-Node *parse_simple_statement_suffix_ni(FILE *fp, char *name) {
-    Node *target = new_var_node(name);
+Node *parse_simple_statement_suffix_ni(JpcContext *ctx, const Token *var_tok, const char *name) {
+    Node *target = new_var_node(ctx, var_tok, name);
 
-    if (current_token.type == TK_INPUT) {
-        getNextToken(fp);
-        Node *node = new_node(ND_INPUT);
+    if (ctx->current_token.type == TK_INPUT) {
+        getNextToken(ctx);
+        Node *node = new_node(ctx, ND_INPUT);
         node->lhs = target;
         return node;
     } 
     
-    Node *val = parse_value(fp);
+    Node *val = parse_value(ctx);
     
-    if (current_token.type == TK_ASSIGN) {
-        check_no_space("「を代入する」の前");
-        getNextToken(fp);
-        return new_binary(ND_ASSIGN, target, val);
-    } else if (current_token.type == TK_ADD) {
-        check_no_space("「をたす」の前");
-        getNextToken(fp);
-        return new_binary(ND_ADD, target, val);
-    } else if (current_token.type == TK_MUL) {
-        check_no_space("「をかける」の前");
-        getNextToken(fp);
-        return new_binary(ND_MUL, target, val);
+    if (ctx->current_token.type == TK_ASSIGN) {
+        check_no_space(ctx, "「を代入する」の前");
+        getNextToken(ctx);
+        return new_binary(ctx, ND_ASSIGN, target, val);
+    } else if (ctx->current_token.type == TK_ADD) {
+        check_no_space(ctx, "「をたす」の前");
+        getNextToken(ctx);
+        return new_binary(ctx, ND_ADD, target, val);
+    } else if (ctx->current_token.type == TK_MUL) {
+        check_no_space(ctx, "「をかける」の前");
+        getNextToken(ctx);
+        return new_binary(ctx, ND_MUL, target, val);
     } else {
-        error(ERR_SYNTAX, "「入力する」「を代入する」「をたす」「をかける」が期待されています");
+        error(ctx, ERR_SYNTAX, "「入力する」「を代入する」「をたす」「をかける」が期待されています");
     }
     return NULL;
 }
 
-Node *parse_simple_statement_suffix_kara(FILE *fp, char *name) {
-    Node *target = new_var_node(name);
-    Node *val = parse_value(fp);
+Node *parse_simple_statement_suffix_kara(JpcContext *ctx, const Token *var_tok, const char *name) {
+    Node *target = new_var_node(ctx, var_tok, name);
+    Node *val = parse_value(ctx);
     
-    if (current_token.type == TK_SUB) {
-        check_no_space("「をひく」の前");
+    if (ctx->current_token.type == TK_SUB) {
+        check_no_space(ctx, "「をひく」の前");
     }
-    expect(TK_SUB, fp); 
-    return new_binary(ND_SUB, target, val);
+    expect(ctx, TK_SUB); 
+    return new_binary(ctx, ND_SUB, target, val);
 }
 
-Node *parse_condition_expression(FILE *fp) {
-    Node *node = parse_condition_term(fp);
+Node *parse_condition_expression(JpcContext *ctx) {
+    Node *node = parse_condition_term(ctx);
 
-    while (current_token.type == TK_OR) {
-        check_has_space("「または」の前");
-        getNextToken(fp);
-        check_has_space("「または」の後");
+    while (ctx->current_token.type == TK_OR) {
+        check_has_space(ctx, "「または」の前");
+        getNextToken(ctx);
+        check_has_space(ctx, "「または」の後");
         
-        node = new_binary(ND_OR, node, parse_condition_term(fp));
+        node = new_binary(ctx, ND_OR, node, parse_condition_term(ctx));
     }
     return node;
 }
 
-Node *parse_condition_term(FILE *fp) {
-    Node *node = parse_condition_factor(fp);
+Node *parse_condition_term(JpcContext *ctx) {
+    Node *node = parse_condition_factor(ctx);
 
-    while (current_token.type == TK_AND) {
-        check_has_space("「かつ」の前");
-        getNextToken(fp);
-        check_has_space("「かつ」の後");
+    while (ctx->current_token.type == TK_AND) {
+        check_has_space(ctx, "「かつ」の前");
+        getNextToken(ctx);
+        check_has_space(ctx, "「かつ」の後");
         
-        node = new_binary(ND_AND, node, parse_condition_factor(fp));
+        node = new_binary(ctx, ND_AND, node, parse_condition_factor(ctx));
     }
     return node;
 }
 
-Node *parse_condition_factor(FILE *fp) {
+Node *parse_condition_factor(JpcContext *ctx) {
     Node *node;
-    if (current_token.type == TK_LPAR) {
-        getNextToken(fp);
-        node = parse_condition_expression(fp);
-        expect(TK_RPAR, fp);
+    if (ctx->current_token.type == TK_LPAR) {
+        getNextToken(ctx);
+        node = parse_condition_expression(ctx);
+        expect(ctx, TK_RPAR);
     } 
-    else if (current_token.type == TK_LITERAL || current_token.type == TK_VARIABLE) {
-        node = parse_simple_condition(fp);
+    else if (ctx->current_token.type == TK_LITERAL || ctx->current_token.type == TK_VARIABLE) {
+        node = parse_simple_condition(ctx);
     } 
     else {
-        error(ERR_SYNTAX, "条件式または「（」が期待されています (Token: %s)", current_token.str);
+        error(ctx, ERR_SYNTAX, "条件式または「（」が期待されています (Token: %.*s)", ctx->current_token.len, getTokenText(ctx, &ctx->current_token));
     }
     return node;
 }
 
-Node *parse_simple_condition(FILE *fp) {
-    Node *lhs = parse_value(fp);
+Node *parse_simple_condition(JpcContext *ctx) {
+    Node *lhs = parse_value(ctx);
     
-    if (current_token.type == TK_GA) {
-        check_no_space("「が」の前");
+    if (ctx->current_token.type == TK_GA) {
+        check_no_space(ctx, "「が」の前");
     }
-    expect(TK_GA, fp);
-    check_no_space("「が」の後");
+    expect(ctx, TK_GA);
+    check_no_space(ctx, "「が」の後");
 
-    Node *rhs = parse_value(fp);
+    Node *rhs = parse_value(ctx);
     
     // 比較演算子の前は空白禁止 (詳細はparse_comparison_op内でチェック)
-    return parse_comparison_op(fp, lhs, rhs);
+    return parse_comparison_op(ctx, lhs, rhs);
 }
 
-Node *parse_comparison_op(FILE *fp, Node *lhs, Node *rhs) {
-    if (current_token.type == TK_OP_GE) { 
-        check_no_space("「以上か」の前");
-        getNextToken(fp); return new_binary(ND_GE, lhs, rhs); 
+Node *parse_comparison_op(JpcContext *ctx, Node *lhs, Node *rhs) {
+    if (ctx->current_token.type == TK_OP_GE) { 
+        check_no_space(ctx, "「以上か」の前");
+        getNextToken(ctx); return new_binary(ctx, ND_GE, lhs, rhs); 
     }
-    if (current_token.type == TK_OP_LE) { 
-        check_no_space("「以下か」の前");
-        getNextToken(fp); return new_binary(ND_LE, lhs, rhs); 
+    if (ctx->current_token.type == TK_OP_LE) { 
+        check_no_space(ctx, "「以下か」の前");
+        getNextToken(ctx); return new_binary(ctx, ND_LE, lhs, rhs); 
     }
-    if (current_token.type == TK_OP_GT) { 
-        check_no_space("「より大きいか」の前");
-        getNextToken(fp); return new_binary(ND_GT, lhs, rhs); 
+    if (ctx->current_token.type == TK_OP_GT) { 
+        check_no_space(ctx, "「より大きいか」の前");
+        getNextToken(ctx); return new_binary(ctx, ND_GT, lhs, rhs); 
     }
-    if (current_token.type == TK_OP_LT) { 
-        check_no_space("「より小さいか」の前");
-        getNextToken(fp); return new_binary(ND_LT, lhs, rhs); 
+    if (ctx->current_token.type == TK_OP_LT) { 
+        check_no_space(ctx, "「より小さいか」の前");
+        getNextToken(ctx); return new_binary(ctx, ND_LT, lhs, rhs); 
     }
-    if (current_token.type == TK_OP_EQ) { 
-        check_no_space("「と一緒か」の前");
-        getNextToken(fp); return new_binary(ND_EQ, lhs, rhs); 
+    if (ctx->current_token.type == TK_OP_EQ) { 
+        check_no_space(ctx, "「と一緒か」の前");
+        getNextToken(ctx); return new_binary(ctx, ND_EQ, lhs, rhs); 
     }
-    if (current_token.type == TK_OP_NE) { 
-        check_no_space("「と違うか」の前");
-        getNextToken(fp); return new_binary(ND_NE, lhs, rhs); 
+    if (ctx->current_token.type == TK_OP_NE) { 
+        check_no_space(ctx, "「と違うか」の前");
+        getNextToken(ctx); return new_binary(ctx, ND_NE, lhs, rhs); 
     }
     
-    error(ERR_SYNTAX, "比較演算子（「以上か」など）が期待されています");
+    error(ctx, ERR_SYNTAX, "比較演算子（「以上か」など）が期待されています");
     return NULL;
 }
 
-Node *parse_value(FILE *fp) {
-    if (current_token.type == TK_LITERAL) {
-        Node *node = new_num(atof(current_token.str));
-        getNextToken(fp);
+Node *parse_value(JpcContext *ctx) {
+    if (ctx->current_token.type == TK_LITERAL) {
+        Node *node = new_num(ctx, getTokenValue(ctx, &ctx->current_token));
+        getNextToken(ctx);
         return node;
-    } else if (current_token.type == TK_VARIABLE) {
-        Node *node = new_var_node(current_token.str);
-        getNextToken(fp);
+    } else if (ctx->current_token.type == TK_VARIABLE) {
+        Node *node = new_var_node(ctx, &ctx->current_token, internToken(ctx, &ctx->current_token));
+        getNextToken(ctx);
         return node;
     } else {
-        error(ERR_SYNTAX, "数値または変数が期待されています");
+        error(ctx, ERR_SYNTAX, "数値または変数が期待されています");
     }
     return NULL;
 }
\ No newline at end of file
@@ -52,7 +52,7 @@ struct Node {
     Node *els;      // elseブロック
 
     // 値・名前用
-    char *name;   // 変数名
+    const char *name; // 変数名 (インターン済み)
     int var_id;   // 変数ID (jpc_var_X)
 
     char *strVal; // 文字列リテラル (printfのフォーマット文字列に変換済)
@@ -62,7 +62,19 @@ struct Node {
     double val;
 };
 
+typedef struct JpcContext JpcContext;
+
 // 関数プロトタイプ宣言
-Node *parse_program(FILE *fp);
+// 呼び出し前に getNextToken で最初のトークンを読んでおく。エラーの場合は NULL を返す
+Node *parse_program(JpcContext *ctx);
+
+// --- 文単位の解析 (診断サーバの差分解析用) ---
+// 変数スコープは宣言済み変数のリスト。保存したスコープに戻せば、その後の宣言は見えなくなる
+typedef struct LVar LVar;
+LVar *save_scope(JpcContext *ctx);
+void restore_scope(JpcContext *ctx, LVar *scope);
+void reset_scope(JpcContext *ctx);
+// エラーは ctx->error_jmp へ脱出するので、呼び出し側で脱出先を設定しておく
+Node *parse_statement(JpcContext *ctx);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench-util.h"
+
+// sample.jpc のように入力で回数の決まるループと条件分岐を含むプログラムを、
+// gcc の最適化なし (これまでの -o)、--cc-opt 2、--cc-opt 2 --pgo で実行ファイルにして速さを比べる
+
+// 回数を入力し、偏りのある もし／ではなく／ではない を繰り返す入力を生成する
+static void generate_input(FILE *fp) {
+    fprintf(fp, "メイン｛\n");
+    fprintf(fp, "　　”回数”を「０」で宣言する。\n");
+    fprintf(fp, "　　”回数”に入力する。\n");
+    fprintf(fp, "　　”合計値”を「０」で宣言する。\n");
+    fprintf(fp, "　　”段階”を「０」で宣言する。\n");
+    fprintf(fp, "　　”i”を「０」で宣言する。\n");
+    fprintf(fp, "　　ループ（”i”が”回数”より小さいか）｛\n");
+    fprintf(fp, "　　　　”段階”に「１」をたす。\n");
+    fprintf(fp, "　　　　もし（”段階”が「１０」以上か）｛\n");
+    fprintf(fp, "　　　　　　”段階”に「０」を代入する。\n");
+    fprintf(fp, "　　　　　　”合計値”から「３」をひく。\n");
+    fprintf(fp, "　　　　｝\n");
+    fprintf(fp, "　　　　ではなく（”段階”が「７」と一緒か　かつ　”合計値”が「０」より大きいか）｛\n");
+    fprintf(fp, "　　　　　　”合計値”に「２」をかける。\n");
+    fprintf(fp, "　　　　　　”合計値”を「３」でわる。\n");
+    fprintf(fp, "　　　　｝\n");
+    fprintf(fp, "　　　　ではない｛\n");
+    fprintf(fp, "　　　　　　”合計値”に”i”をたす。\n");
+    fprintf(fp, "　　　　｝\n");
+    fprintf(fp, "　　　　”i”に「１」をたす。\n");
+    fprintf(fp, "　　｝\n");
+    fprintf(fp, "　　「合計値は”合計値”です」と出力する。\n");
+    fprintf(fp, "｝\n");
+}
+
+int main(int argc, char *argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 100000000;
+    int runs = 3;
+    const char *names[3] = { "gcc (none)      ", "--cc-opt 2      ", "--cc-opt 2 --pgo" };
+
+    char dir[] = "/tmp/jpc-pgo-bench-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        fprintf(stderr, "Error: Cannot create temporary directory\n");
+        return 1;
+    }
+    // プロファイルは一時ディレクトリに置き、毎回計測から行う
+    char cache[4096 + 16];
+    snprintf(cache, sizeof(cache), "%s/cache", dir);
+    setenv("JPC_CACHE_DIR", cache, 1);
+
+    // 学習用の入力は本番の 1/10 の回数にする
+    char src[4096 + 16], input[4096 + 16], train[4096 + 16], exe[3][4096 + 16], out[3][4096 + 16], cmd[4096 + 16];
+    snprintf(src, sizeof(src), "%s/prog.jpc", dir);
+    snprintf(input, sizeof(input), "%s/input.txt", dir);
+    snprintf(train, sizeof(train), "%s/train.txt", dir);
+    FILE *fp = fopen(src, "w");
+    FILE *in = fopen(input, "w");
+    FILE *tr = fopen(train, "w");
+    if (fp == NULL || in == NULL || tr == NULL) {
+        fprintf(stderr, "Error: Cannot create input files\n");
+        return 1;
+    }
+    generate_input(fp);
+    fprintf(in, "%ld\n", iterations);
+    fprintf(tr, "%ld\n", iterations / 10);
+    fclose(fp);
+    fclose(in);
+    fclose(tr);
+
+    // 既定の最適化レベルで C を生成する (jpc -o と同じ)
+    DriverOptions driver = { OPT_LEVEL_DEFAULT, false, CODEGEN_DEFAULTS, BUILD_DEFAULTS, false };
+    char *code = NULL;
+    size_t code_len = 0;
+    if (!bench_compile(src, &driver, NULL, &code, &code_len)) return 1;
+
+    // gcc を動かす時間を測るので、実行ファイルのキャッシュは使わない
+    BuildOptions opts[3] = { BUILD_DEFAULTS, BUILD_DEFAULTS, BUILD_DEFAULTS };
+    for (int i = 0; i < 3; i++) opts[i].use_cache = false;
+    opts[1].cc_opt = "2";
+    opts[2].cc_opt = "2";
+    opts[2].pgo_input = train;
+
+    double build_time[3], best[3];
+    for (int i = 0; i < 3; i++) {
+        snprintf(exe[i], sizeof(exe[i]), "%s/prog%d", dir, i);
+        snprintf(out[i], sizeof(out[i]), "%s/prog%d.out", dir, i);
+        build_time[i] = bench_build(&opts[i], code, code_len, exe[i]);
+        if (build_time[i] < 0) return 1;
+        best[i] = bench_run(exe[i], input, out[i], runs);
+        if (best[i] < 0) {
+            fprintf(stderr, "Error: %s failed\n", exe[i]);
+            return 1;
+        }
+    }
+    bool same = bench_same_file(out[0], out[1]) && bench_same_file(out[0], out[2]);
+
+    printf("=== PGO Bench: %ld iterations (training: %ld) ===\n", iterations, iterations / 10);
+    for (int i = 0; i < 3; i++) {
+        printf("%s: build %.1f ms, run best of %d: %.3f ms (%.2fx)\n",
+               names[i], build_time[i] * 1e3, runs, best[i] * 1e3, best[0] / best[i]);
+    }
+    printf("pgo vs --cc-opt 2: %.2fx\n", best[1] / best[2]);
+    printf("output: %s\n", same ? "identical" : "DIFFERENT");
+
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    if (system(cmd) != 0) fprintf(stderr, "Error: Cannot remove %s\n", dir);
+    free(code);
+    return same ? 0 : 1;
+}
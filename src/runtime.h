@@ -0,0 +1,526 @@
+// --- jpc ランタイム ---
+// 生成する C コードの先頭にそのまま埋め込む (コンパイラ自身はこのファイルを #include しない)。
+// Makefile が C の文字列リテラルに変換した src/runtime.inc を codegen.c が読み込む。
+// 出力は大きなバッファにためて、あふれたとき・終了時・端末から入力する前にまとめて書き出す。
+// 数値は printf("%f") と同じ文字列を、書式の解釈なしで作る。
+// 入力も標準入力を大きなブロックで読み、scanf("%lf") と同じ規則で数値を切り出して自前で変換する。
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#define JPC_OUT_SIZE (1 << 16)
+
+static char jpc_out[JPC_OUT_SIZE];
+static size_t jpc_out_len;
+
+static inline void jpc_flush(void) {
+    if (jpc_out_len == 0) return;
+    fwrite(jpc_out, 1, jpc_out_len, stdout);
+    fflush(stdout);
+    jpc_out_len = 0;
+}
+
+// 入力の前に、ためた出力 (入力を促す文など) を見せる。
+// 端末から読むときだけでよい (パイプから読むなら、まとめて書き出したほうが速い)
+static int jpc_interactive = -1;
+
+static inline void jpc_before_input(void) {
+    if (jpc_interactive < 0) jpc_interactive = isatty(0);
+    if (jpc_interactive) jpc_flush();
+}
+
+static inline void jpc_write(const char *s, size_t n) {
+    if (jpc_out_len + n > JPC_OUT_SIZE) {
+        jpc_flush();
+        if (n > JPC_OUT_SIZE) {
+            fwrite(s, 1, n, stdout);
+            return;
+        }
+    }
+    memcpy(jpc_out + jpc_out_len, s, n);
+    jpc_out_len += n;
+}
+
+// 文字列リテラル用 (長さはコンパイル時に決まる)
+#define JPC_WRITE(s) jpc_write(s, sizeof(s) - 1)
+
+// 整数部と小数部 6 桁を "I.FFFFFF" の形で書く
+static inline void jpc_put_fixed(int neg, uint64_t ipart, uint32_t frac) {
+    char buf[32];
+    char *p = buf + sizeof(buf);
+    for (int i = 0; i < 6; i++) {
+        *--p = (char)('0' + frac % 10);
+        frac /= 10;
+    }
+    *--p = '.';
+    do {
+        *--p = (char)('0' + ipart % 10);
+        ipart /= 10;
+    } while (ipart);
+    if (neg) *--p = '-';
+    jpc_write(p, buf + sizeof(buf) - p);
+}
+
+// printf("%f") と同じ表示。double の正確な値を 10^-6 の位で偶数丸めする
+// (|v| >= 2^64 や NaN・無限大はまれなので printf に任せる)
+static inline void jpc_put_f(double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    int neg = (int)(bits >> 63);
+    int biased = (int)(bits >> 52) & 0x7FF;
+    uint64_t mant = bits & 0xFFFFFFFFFFFFFull;
+    if (biased == 0x7FF || biased - 1075 > 11) {
+        char buf[400];
+        int n = snprintf(buf, sizeof(buf), "%f", v);
+        jpc_write(buf, (size_t)n);
+        return;
+    }
+    int e = biased ? biased - 1075 : -1074;
+    if (biased) mant |= 1ull << 52;
+
+    uint64_t ipart;
+    uint32_t frac = 0;
+    if (e >= 0) {
+        ipart = mant << e;
+    } else {
+        int k = -e;
+        ipart = k < 64 ? mant >> k : 0;
+        uint64_t low = k < 64 ? mant & ((1ull << k) - 1) : mant;
+        // low / 2^k の 10^6 倍 (low * 10^6 < 2^73 なので k >= 75 なら 0.5 未満)
+        if (k < 75) {
+            unsigned __int128 num = (unsigned __int128)low * 1000000u;
+            unsigned __int128 half = (unsigned __int128)1 << (k - 1);
+            uint64_t q = (uint64_t)(num >> k);
+            unsigned __int128 rem = num & ((half << 1) - 1);
+            if (rem > half || (rem == half && (q & 1))) q++;
+            if (q == 1000000) {
+                ipart++;
+                q = 0;
+            }
+            frac = (uint32_t)q;
+        }
+    }
+    jpc_put_fixed(neg, ipart, frac);
+}
+
+// 整数の変数 (int64_t) を printf("%f") と同じ形で書く
+static inline void jpc_put_i(int64_t v) {
+    jpc_put_fixed(v < 0, v < 0 ? -(uint64_t)v : (uint64_t)v, 0);
+}
+
+#define JPC_IN_SIZE (1 << 16)
+
+static char jpc_in[JPC_IN_SIZE];
+static size_t jpc_in_pos, jpc_in_len;
+static int jpc_in_eof;
+
+// 読みかけの数値の文字列 (長いものは伸ばす)
+static char jpc_tok_buf[128];
+static char *jpc_tok = jpc_tok_buf;
+static size_t jpc_tok_len, jpc_tok_cap = sizeof(jpc_tok_buf);
+
+static inline int jpc_in_fill(void) {
+    if (jpc_in_eof) return 0;
+    ssize_t n;
+    do {
+        n = read(0, jpc_in, JPC_IN_SIZE);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        jpc_in_eof = 1;
+        return 0;
+    }
+    jpc_in_pos = 0;
+    jpc_in_len = (size_t)n;
+    return 1;
+}
+
+// 次の 1 文字を読まずに返す (終わりなら EOF)
+static inline int jpc_in_peek(void) {
+    if (jpc_in_pos == jpc_in_len && !jpc_in_fill()) return EOF;
+    return (unsigned char)jpc_in[jpc_in_pos];
+}
+
+static inline void jpc_tok_push(char c) {
+    if (jpc_tok_len + 1 >= jpc_tok_cap) {
+        char *p = malloc(jpc_tok_cap * 2);
+        if (p == NULL) {
+            fputs("jpc: out of memory\n", stderr);
+            exit(1);
+        }
+        memcpy(p, jpc_tok, jpc_tok_len);
+        if (jpc_tok != jpc_tok_buf) free(jpc_tok);
+        jpc_tok = p;
+        jpc_tok_cap *= 2;
+    }
+    jpc_tok[jpc_tok_len++] = c;
+}
+
+// c を数値の文字列に加えて読み進め、次の文字を返す
+static inline int jpc_in_take(int c) {
+    jpc_tok_push((char)c);
+    jpc_in_pos++;
+    return jpc_in_peek();
+}
+
+static inline int jpc_lower(int c) {
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+static inline int jpc_is_digit(int c) {
+    return c >= '0' && c <= '9';
+}
+
+// "nan" や "infinity" の続きを大文字小文字を区別せずに読む。
+// 違う文字が来たら scanf と同じくその文字も読み捨てて 0
+static inline int jpc_in_expect(const char *s) {
+    for (; *s; s++) {
+        int c = jpc_in_peek();
+        if (jpc_lower(c) != *s) {
+            if (c != EOF) jpc_in_pos++;
+            return 0;
+        }
+        jpc_in_take(c);
+    }
+    return 1;
+}
+
+// m * 10^e10 を double にする。m と 10^|e10| がどちらも double で正確に表せれば、
+// 1 回のかけ算・わり算で正しく丸めた値になる (Clinger の方法)。できなければ 0
+static inline int jpc_to_double(uint64_t m, int e10, double *d) {
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    if (m == 0) {
+        *d = 0.0;
+        return 1;
+    }
+    if (m > (1ull << 53)) return 0;
+    if (e10 < 0) {
+        if (e10 < -22) return 0;
+        *d = (double)m / pow10[-e10];
+        return 1;
+    }
+    // 1.5e30 のように、仮数部に 10 をかけても 2^53 以下に収まるならその分を先にかける
+    for (; e10 > 22; e10--) {
+        m *= 10;
+        if (m > (1ull << 53)) return 0;
+    }
+    *d = (double)m * pow10[e10];
+    return 1;
+}
+
+// 5^q (JPC_POW5_MIN <= q <= JPC_POW5_MAX) を最上位ビットが立つように 128 ビットへ正規化した値。
+// 正の q は切り捨て、負の q は切り上げ。範囲外の指数はまれなので strtod に任せる
+#define JPC_POW5_MIN (-64)
+#define JPC_POW5_MAX 64
+
+static const uint64_t jpc_pow5[][2] = {
+    {0xa87fea27a539e9a5ull, 0x3f2398d747b36224ull},
+    {0xd29fe4b18e88640eull, 0x8eec7f0d19a03aadull},
+    {0x83a3eeeef9153e89ull, 0x1953cf68300424acull},
+    {0xa48ceaaab75a8e2bull, 0x5fa8c3423c052dd7ull},
+    {0xcdb02555653131b6ull, 0x3792f412cb06794dull},
+    {0x808e17555f3ebf11ull, 0xe2bbd88bbee40bd0ull},
+    {0xa0b19d2ab70e6ed6ull, 0x5b6aceaeae9d0ec4ull},
+    {0xc8de047564d20a8bull, 0xf245825a5a445275ull},
+    {0xfb158592be068d2eull, 0xeed6e2f0f0d56712ull},
+    {0x9ced737bb6c4183dull, 0x55464dd69685606bull},
+    {0xc428d05aa4751e4cull, 0xaa97e14c3c26b886ull},
+    {0xf53304714d9265dfull, 0xd53dd99f4b3066a8ull},
+    {0x993fe2c6d07b7fabull, 0xe546a8038efe4029ull},
+    {0xbf8fdb78849a5f96ull, 0xde98520472bdd033ull},
+    {0xef73d256a5c0f77cull, 0x963e66858f6d4440ull},
+    {0x95a8637627989aadull, 0xdde7001379a44aa8ull},
+    {0xbb127c53b17ec159ull, 0x5560c018580d5d52ull},
+    {0xe9d71b689dde71afull, 0xaab8f01e6e10b4a6ull},
+    {0x9226712162ab070dull, 0xcab3961304ca70e8ull},
+    {0xb6b00d69bb55c8d1ull, 0x3d607b97c5fd0d22ull},
+    {0xe45c10c42a2b3b05ull, 0x8cb89a7db77c506aull},
+    {0x8eb98a7a9a5b04e3ull, 0x77f3608e92adb242ull},
+    {0xb267ed1940f1c61cull, 0x55f038b237591ed3ull},
+    {0xdf01e85f912e37a3ull, 0x6b6c46dec52f6688ull},
+    {0x8b61313bbabce2c6ull, 0x2323ac4b3b3da015ull},
+    {0xae397d8aa96c1b77ull, 0xabec975e0a0d081aull},
+    {0xd9c7dced53c72255ull, 0x96e7bd358c904a21ull},
+    {0x881cea14545c7575ull, 0x7e50d64177da2e54ull},
+    {0xaa242499697392d2ull, 0xdde50bd1d5d0b9e9ull},
+    {0xd4ad2dbfc3d07787ull, 0x955e4ec64b44e864ull},
+    {0x84ec3c97da624ab4ull, 0xbd5af13bef0b113eull},
+    {0xa6274bbdd0fadd61ull, 0xecb1ad8aeacdd58eull},
+    {0xcfb11ead453994baull, 0x67de18eda5814af2ull},
+    {0x81ceb32c4b43fcf4ull, 0x80eacf948770ced7ull},
+    {0xa2425ff75e14fc31ull, 0xa1258379a94d028dull},
+    {0xcad2f7f5359a3b3eull, 0x096ee45813a04330ull},
+    {0xfd87b5f28300ca0dull, 0x8bca9d6e188853fcull},
+    {0x9e74d1b791e07e48ull, 0x775ea264cf55347eull},
+    {0xc612062576589ddaull, 0x95364afe032a819eull},
+    {0xf79687aed3eec551ull, 0x3a83ddbd83f52205ull},
+    {0x9abe14cd44753b52ull, 0xc4926a9672793543ull},
+    {0xc16d9a0095928a27ull, 0x75b7053c0f178294ull},
+    {0xf1c90080baf72cb1ull, 0x5324c68b12dd6339ull},
+    {0x971da05074da7beeull, 0xd3f6fc16ebca5e04ull},
+    {0xbce5086492111aeaull, 0x88f4bb1ca6bcf585ull},
+    {0xec1e4a7db69561a5ull, 0x2b31e9e3d06c32e6ull},
+    {0x9392ee8e921d5d07ull, 0x3aff322e62439fd0ull},
+    {0xb877aa3236a4b449ull, 0x09befeb9fad487c3ull},
+    {0xe69594bec44de15bull, 0x4c2ebe687989a9b4ull},
+    {0x901d7cf73ab0acd9ull, 0x0f9d37014bf60a11ull},
+    {0xb424dc35095cd80full, 0x538484c19ef38c95ull},
+    {0xe12e13424bb40e13ull, 0x2865a5f206b06fbaull},
+    {0x8cbccc096f5088cbull, 0xf93f87b7442e45d4ull},
+    {0xafebff0bcb24aafeull, 0xf78f69a51539d749ull},
+    {0xdbe6fecebdedd5beull, 0xb573440e5a884d1cull},
+    {0x89705f4136b4a597ull, 0x31680a88f8953031ull},
+    {0xabcc77118461cefcull, 0xfdc20d2b36ba7c3eull},
+    {0xd6bf94d5e57a42bcull, 0x3d32907604691b4dull},
+    {0x8637bd05af6c69b5ull, 0xa63f9a49c2c1b110ull},
+    {0xa7c5ac471b478423ull, 0x0fcf80dc33721d54ull},
+    {0xd1b71758e219652bull, 0xd3c36113404ea4a9ull},
+    {0x83126e978d4fdf3bull, 0x645a1cac083126eaull},
+    {0xa3d70a3d70a3d70aull, 0x3d70a3d70a3d70a4ull},
+    {0xccccccccccccccccull, 0xcccccccccccccccdull},
+    {0x8000000000000000ull, 0x0000000000000000ull},
+    {0xa000000000000000ull, 0x0000000000000000ull},
+    {0xc800000000000000ull, 0x0000000000000000ull},
+    {0xfa00000000000000ull, 0x0000000000000000ull},
+    {0x9c40000000000000ull, 0x0000000000000000ull},
+    {0xc350000000000000ull, 0x0000000000000000ull},
+    {0xf424000000000000ull, 0x0000000000000000ull},
+    {0x9896800000000000ull, 0x0000000000000000ull},
+    {0xbebc200000000000ull, 0x0000000000000000ull},
+    {0xee6b280000000000ull, 0x0000000000000000ull},
+    {0x9502f90000000000ull, 0x0000000000000000ull},
+    {0xba43b74000000000ull, 0x0000000000000000ull},
+    {0xe8d4a51000000000ull, 0x0000000000000000ull},
+    {0x9184e72a00000000ull, 0x0000000000000000ull},
+    {0xb5e620f480000000ull, 0x0000000000000000ull},
+    {0xe35fa931a0000000ull, 0x0000000000000000ull},
+    {0x8e1bc9bf04000000ull, 0x0000000000000000ull},
+    {0xb1a2bc2ec5000000ull, 0x0000000000000000ull},
+    {0xde0b6b3a76400000ull, 0x0000000000000000ull},
+    {0x8ac7230489e80000ull, 0x0000000000000000ull},
+    {0xad78ebc5ac620000ull, 0x0000000000000000ull},
+    {0xd8d726b7177a8000ull, 0x0000000000000000ull},
+    {0x878678326eac9000ull, 0x0000000000000000ull},
+    {0xa968163f0a57b400ull, 0x0000000000000000ull},
+    {0xd3c21bcecceda100ull, 0x0000000000000000ull},
+    {0x84595161401484a0ull, 0x0000000000000000ull},
+    {0xa56fa5b99019a5c8ull, 0x0000000000000000ull},
+    {0xcecb8f27f4200f3aull, 0x0000000000000000ull},
+    {0x813f3978f8940984ull, 0x4000000000000000ull},
+    {0xa18f07d736b90be5ull, 0x5000000000000000ull},
+    {0xc9f2c9cd04674edeull, 0xa400000000000000ull},
+    {0xfc6f7c4045812296ull, 0x4d00000000000000ull},
+    {0x9dc5ada82b70b59dull, 0xf020000000000000ull},
+    {0xc5371912364ce305ull, 0x6c28000000000000ull},
+    {0xf684df56c3e01bc6ull, 0xc732000000000000ull},
+    {0x9a130b963a6c115cull, 0x3c7f400000000000ull},
+    {0xc097ce7bc90715b3ull, 0x4b9f100000000000ull},
+    {0xf0bdc21abb48db20ull, 0x1e86d40000000000ull},
+    {0x96769950b50d88f4ull, 0x1314448000000000ull},
+    {0xbc143fa4e250eb31ull, 0x17d955a000000000ull},
+    {0xeb194f8e1ae525fdull, 0x5dcfab0800000000ull},
+    {0x92efd1b8d0cf37beull, 0x5aa1cae500000000ull},
+    {0xb7abc627050305adull, 0xf14a3d9e40000000ull},
+    {0xe596b7b0c643c719ull, 0x6d9ccd05d0000000ull},
+    {0x8f7e32ce7bea5c6full, 0xe4820023a2000000ull},
+    {0xb35dbf821ae4f38bull, 0xdda2802c8a800000ull},
+    {0xe0352f62a19e306eull, 0xd50b2037ad200000ull},
+    {0x8c213d9da502de45ull, 0x4526f422cc340000ull},
+    {0xaf298d050e4395d6ull, 0x9670b12b7f410000ull},
+    {0xdaf3f04651d47b4cull, 0x3c0cdd765f114000ull},
+    {0x88d8762bf324cd0full, 0xa5880a69fb6ac800ull},
+    {0xab0e93b6efee0053ull, 0x8eea0d047a457a00ull},
+    {0xd5d238a4abe98068ull, 0x72a4904598d6d880ull},
+    {0x85a36366eb71f041ull, 0x47a6da2b7f864750ull},
+    {0xa70c3c40a64e6c51ull, 0x999090b65f67d924ull},
+    {0xd0cf4b50cfe20765ull, 0xfff4b4e3f741cf6dull},
+    {0x82818f1281ed449full, 0xbff8f10e7a8921a4ull},
+    {0xa321f2d7226895c7ull, 0xaff72d52192b6a0dull},
+    {0xcbea6f8ceb02bb39ull, 0x9bf4f8a69f764490ull},
+    {0xfee50b7025c36a08ull, 0x02f236d04753d5b4ull},
+    {0x9f4f2726179a2245ull, 0x01d762422c946590ull},
+    {0xc722f0ef9d80aad6ull, 0x424d3ad2b7b97ef5ull},
+    {0xf8ebad2b84e0d58bull, 0xd2e0898765a7deb2ull},
+    {0x9b934c3b330c8577ull, 0x63cc55f49f88eb2full},
+    {0xc2781f49ffcfa6d5ull, 0x3cbf6b71c76b25fbull},
+};
+
+// m * 10^q を Eisel-Lemire の方法で double にする。
+// 128 ビットのかけ算で上位 54 ビットを求め、切り捨てた下位ビットのせいで丸めの向きが決まらないときと、
+// 指数が正規化数の範囲を出るときは 0 を返す
+static inline int jpc_eisel_lemire(uint64_t m, int q, double *d) {
+    if (m == 0) {
+        *d = 0.0;
+        return 1;
+    }
+    if (q < JPC_POW5_MIN || q > JPC_POW5_MAX) return 0;
+    const uint64_t *pow5 = jpc_pow5[q - JPC_POW5_MIN];
+    int lz = __builtin_clzll(m);
+    m <<= lz;
+    unsigned __int128 product = (unsigned __int128)m * pow5[0];
+    uint64_t upper = (uint64_t)(product >> 64), lower = (uint64_t)product;
+    if ((upper & 0x1FF) == 0x1FF && lower + m < lower) {
+        // 上位 64 ビットだけでは足りないので、5^q の下位 64 ビットとの積も足す
+        unsigned __int128 low_product = (unsigned __int128)m * pow5[1];
+        uint64_t middle = lower + (uint64_t)(low_product >> 64);
+        if (middle < lower) upper++;
+        if (middle + 1 == 0 && (upper & 0x1FF) == 0x1FF && (uint64_t)low_product + m < (uint64_t)low_product) return 0;
+        lower = middle;
+    }
+    uint64_t upperbit = upper >> 63;
+    uint64_t mantissa = upper >> (upperbit + 9);
+    lz += (int)(1 ^ upperbit);
+    // ちょうど 2 つの double の中間かもしれないときは、偶数丸めの向きが決まらない
+    if (lower == 0 && (upper & 0x1FF) == 0 && (mantissa & 3) == 1) return 0;
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (1ull << 53)) {
+        mantissa = 1ull << 52;
+        lz--;
+    }
+    mantissa &= ~(1ull << 52);
+    // floor(log2(10^q)) + 1024 + 63 - lz がバイアス付きの指数になる
+    int64_t exponent = ((((int64_t)152170 + 65536) * q) >> 16) + 1024 + 63 - lz;
+    if (exponent < 1 || exponent > 2046) return 0;
+    uint64_t bits = mantissa | (uint64_t)exponent << 52;
+    memcpy(d, &bits, sizeof(*d));
+    return 1;
+}
+
+// よくある 10 進の数値 (符号・数字・小数点・指数) をバッファの上で直接読む。
+// それ以外の形や、数値がバッファの終わりにかかっているときは何も読まずに 0
+static inline int jpc_read_fast(double *v) {
+    const char *start = jpc_in + jpc_in_pos, *end = jpc_in + jpc_in_len;
+    const char *p = start;
+    int neg = 0;
+    if (*p == '-' || *p == '+') neg = *p++ == '-';
+    if (p + 1 < end && p[0] == '0' && jpc_lower(p[1]) == 'x') return 0;
+
+    // 仮数部は先頭の 0 を除いて 19 桁まで。それより後ろの桁は切り捨てて、あとで丸めの向きを確かめる
+    uint64_t m = 0;
+    int digits = 0, e10 = 0, got_digit = 0;
+    for (; p < end && jpc_is_digit(*p); p++) {
+        got_digit = 1;
+        if (m == 0 && *p == '0') continue;
+        if (++digits <= 19) {
+            m = m * 10 + (uint64_t)(*p - '0');
+        } else {
+            e10++;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && jpc_is_digit(*p); p++) {
+            got_digit = 1;
+            if (m == 0 && *p == '0') {
+                e10--;
+                continue;
+            }
+            if (++digits <= 19) {
+                m = m * 10 + (uint64_t)(*p - '0');
+                e10--;
+            }
+        }
+    }
+    if (!got_digit) return 0;
+    if (p < end && jpc_lower(*p) == 'e') {
+        // "1e" や "1e+" のように指数の数字がなければ、scanf と同じくそこまで読んで指数は無視する
+        p++;
+        int eneg = 0;
+        if (p < end && (*p == '-' || *p == '+')) eneg = *p++ == '-';
+        int exp = 0;
+        for (; p < end && jpc_is_digit(*p); p++) {
+            if (exp < 10000) exp = exp * 10 + (*p - '0');
+        }
+        e10 += eneg ? -exp : exp;
+    }
+    if (p == end) return 0;
+
+    // 切り捨てた桁があれば、m と m + 1 が同じ double になるときだけ正しい
+    double d, d_up;
+    if (digits <= 19 ? jpc_to_double(m, e10, &d) || jpc_eisel_lemire(m, e10, &d)
+                     : jpc_eisel_lemire(m, e10, &d) && jpc_eisel_lemire(m + 1, e10, &d_up) && d == d_up) {
+        *v = neg ? -d : d;
+    } else {
+        jpc_tok_len = 0;
+        for (const char *q = start; q < p; q++) jpc_tok_push(*q);
+        jpc_tok[jpc_tok_len] = '\0';
+        *v = strtod(jpc_tok, NULL);
+    }
+    jpc_in_pos = (size_t)(p - jpc_in);
+    return 1;
+}
+
+// jpc_read_fast で読めない入力を、1 文字ずつ glibc の scanf と同じ規則で切り出して strtod で変換する
+static inline void jpc_read_slow(double *v) {
+    int c = jpc_in_peek();
+    jpc_tok_len = 0;
+    int got_sign = 0, hex = 0;
+    if (c == '-' || c == '+') {
+        got_sign = 1;
+        c = jpc_in_take(c);
+        if (c == EOF) return;
+    }
+    if (jpc_lower(c) == 'n') {
+        jpc_in_take(c);
+        if (!jpc_in_expect("an")) return;
+    } else if (jpc_lower(c) == 'i') {
+        jpc_in_take(c);
+        if (!jpc_in_expect("nf")) return;
+        c = jpc_in_peek();
+        if (jpc_lower(c) == 'i') {
+            jpc_in_take(c);
+            if (!jpc_in_expect("nity")) return;
+        }
+    } else {
+        int got_digit = 0, got_dot = 0, got_e = 0;
+        int exp_char = 'e';
+        if (c == '0') {
+            c = jpc_in_take(c);
+            if (jpc_lower(c) == 'x') {
+                c = jpc_in_take(c);
+                hex = 1;
+                exp_char = 'p';
+            } else {
+                got_digit = 1;
+            }
+        }
+        for (;;) {
+            if (jpc_is_digit(c) || (!got_e && hex && jpc_lower(c) >= 'a' && jpc_lower(c) <= 'f')) {
+                got_digit = 1;
+            } else if (got_e && jpc_tok[jpc_tok_len - 1] == exp_char && (c == '-' || c == '+')) {
+                // 指数の符号
+            } else if (got_digit && !got_e && jpc_lower(c) == exp_char) {
+                c = exp_char;
+                got_e = got_dot = 1;
+            } else if (!got_dot && c == '.') {
+                got_dot = 1;
+            } else {
+                break;
+            }
+            c = jpc_in_take(c);
+        }
+        if (jpc_tok_len == (size_t)got_sign || (hex && jpc_tok_len == (size_t)got_sign + 2)) return;
+    }
+    jpc_tok[jpc_tok_len] = '\0';
+    char *end;
+    double d = strtod(jpc_tok, &end);
+    if (end != jpc_tok) *v = d;
+}
+
+// scanf("%lf", v) と同じ。数値として読めなければ (入力の終わりを含む) *v は変えず、
+// 数値でない文字は読み捨てずに残す
+static inline void jpc_read_f(double *v) {
+    for (;;) {
+        const char *p = jpc_in + jpc_in_pos, *end = jpc_in + jpc_in_len;
+        while (p < end && (*p == ' ' || (*p >= '\t' && *p <= '\r'))) p++;
+        jpc_in_pos = (size_t)(p - jpc_in);
+        if (p < end) break;
+        if (!jpc_in_fill()) return;
+    }
+    if (!jpc_read_fast(v)) jpc_read_slow(v);
+}
@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <spawn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "bench-util.h"
+#include "json.h"
+
+extern char **environ;
+
+// jpc --server に LSP のメッセージを標準入力から流し込み、応答と診断の範囲を確かめる。
+// 初期化、意味エラーのある文書を開く、ループの ｛…｝ の中の編集 (差分解析)、ループの外の編集 (全体解析)、
+// id のない要求 (通知) には応答しないこと、shutdown と exit を順に確かめる。
+// 最後に、上限を超える Content-Length を受け取ったら本文を読まずにエラーで終わることを確かめる
+
+#define URI "file:///server-test.jpc"
+
+// 開く文書。”未定義” と ”ｄ” は宣言されておらず、”ａ” は二重に宣言している
+static const char document[] =
+    "メイン｛\\n"
+    "　　”未定義”に「１」をたす。\\n"
+    "　　”ａ”を「１」で宣言する。\\n"
+    "　　”ａ”を「２」で宣言する。\\n"
+    "　　ループ（”ａ”が「３」より小さいか）｛\\n"
+    "　　　　「値は”ｂ”です」と出力する。\\n"
+    "　　　　”ａ”に「１」をたす。\\n"
+    "　　｝\\n"
+    "　　”ｄ”から「１」をひく。\\n"
+    "｝\\n";
+
+// 1 つの診断の範囲 (0 始まりの行と、UTF-16 単位の文字位置)
+typedef struct {
+    int line, start, end;
+} Range;
+
+typedef struct {
+    const char *name;
+    const Range *ranges;    // 期待する診断の範囲 (順番どおり)
+    int count;
+    const char *log;        // 標準エラー出力に出るはずの解析の種類
+} Step;
+
+static void send_message(FILE *fp, const char *body) {
+    fprintf(fp, "Content-Length: %zu\r\n\r\n%s", strlen(body), body);
+}
+
+// 位置 (line, character) にある [start, end) の文字を text に置き換える差分の didChange
+static void send_change(FILE *fp, int line, int start, int end, const char *text) {
+    char body[1024];
+    snprintf(body, sizeof(body),
+             "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didChange\",\"params\":{\"textDocument\":{\"uri\":\"" URI "\",\"version\":2},"
+             "\"contentChanges\":[{\"range\":{\"start\":{\"line\":%d,\"character\":%d},\"end\":{\"line\":%d,\"character\":%d}},\"text\":\"%s\"}]}}",
+             line, start, line, end, text);
+    send_message(fp, body);
+}
+
+// サーバに流し込むメッセージを path に書く
+static bool write_requests(const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) return false;
+    send_message(fp, "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"initialize\",\"params\":{}}");
+    send_message(fp, "{\"jsonrpc\":\"2.0\",\"method\":\"initialized\",\"params\":{}}");
+    char body[2048];
+    snprintf(body, sizeof(body),
+             "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didOpen\",\"params\":{\"textDocument\":"
+             "{\"uri\":\"" URI "\",\"languageId\":\"jpc\",\"version\":1,\"text\":\"%s\"}}}", document);
+    send_message(fp, body);
+    // ループの中: 文字列の中の ”ｂ” を ”ａ” にする (行は変わらない)
+    send_change(fp, 5, 8, 9, "ａ");
+    // ループの中: 宣言を 1 行足す (後ろの文の診断の行がずれる)
+    send_change(fp, 6, 0, 0, "　　　　”ｃ”を「１」で宣言する。\\n");
+    // ループの外: ”ｄ” を宣言する行を足す
+    send_change(fp, 2, 0, 0, "　　”ｄ”を「０」で宣言する。\\n");
+    // id のない shutdown は通知なので応答しない。id のある要求には応答する
+    send_message(fp, "{\"jsonrpc\":\"2.0\",\"method\":\"shutdown\"}");
+    send_message(fp, "{\"jsonrpc\":\"2.0\",\"id\":\"x\",\"method\":\"unknown/method\"}");
+    send_message(fp, "{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"shutdown\"}");
+    send_message(fp, "{\"jsonrpc\":\"2.0\",\"method\":\"exit\"}");
+    return fclose(fp) == 0;
+}
+
+// 上限 (64 MiB) を超える Content-Length のヘッダだけを path に書く
+static bool write_oversized(const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) return false;
+    fprintf(fp, "Content-Length: %ld\r\n\r\n{}", (64L << 20) + 1);
+    return fclose(fp) == 0;
+}
+
+// jpc --server を標準入出力をつなぎ替えて動かし、終了コードを返す (起動できなければ -1)
+static int spawn_server(const char *jpc, const char *in, const char *out, const char *err) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 0, in, O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, 1, out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    posix_spawn_file_actions_addopen(&actions, 2, err, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    char *argv[] = { (char *)jpc, "--server", NULL };
+    pid_t pid;
+    int rc = posix_spawn(&pid, jpc, &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    int status;
+    if (rc != 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) return -1;
+    return WEXITSTATUS(status);
+}
+
+// 出力を Content-Length ごとにメッセージに分ける。読めたメッセージの数を返す
+static int read_responses(const char *text, size_t len, JsonValue **msgs, int max) {
+    int n = 0;
+    const char *p = text, *end = text + len;
+    while (n < max && p < end) {
+        const char *header = strstr(p, "Content-Length:");
+        const char *body = header != NULL ? strstr(header, "\r\n\r\n") : NULL;
+        if (body == NULL) break;
+        body += 4;
+        size_t body_len = (size_t)atol(header + 15);
+        if (body + body_len > end) break;
+        msgs[n++] = json_parse(body, body_len);
+        p = body + body_len;
+    }
+    return n;
+}
+
+// 診断の範囲が期待どおりか
+static bool check_diagnostics(const JsonValue *msg, const Step *step) {
+    const char *method = json_get_string(msg, "method");
+    if (method == NULL || strcmp(method, "textDocument/publishDiagnostics") != 0) {
+        printf("NG: %s: 診断が送られていません\n", step->name);
+        return false;
+    }
+    JsonValue *diags = json_get(json_get(msg, "params"), "diagnostics");
+    int count = diags != NULL && diags->type == JSON_ARRAY ? diags->count : -1;
+    if (count != step->count) {
+        printf("NG: %s: 診断が %d 個です (期待は %d 個)\n", step->name, count, step->count);
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        JsonValue *range = json_get(diags->items[i], "range");
+        JsonValue *start = json_get(range, "start"), *end = json_get(range, "end");
+        Range got = { (int)json_get_number(start, "line", -1), (int)json_get_number(start, "character", -1),
+                      (int)json_get_number(end, "character", -1) };
+        const Range *want = &step->ranges[i];
+        if (got.line != want->line || got.start != want->start || got.end != want->end ||
+            (int)json_get_number(end, "line", -1) != want->line) {
+            printf("NG: %s: 診断 %d の範囲が %d:%d-%d です (期待は %d:%d-%d)\n", step->name, i + 1,
+                   got.line, got.start, got.end, want->line, want->start, want->end);
+            return false;
+        }
+    }
+    return true;
+}
+
+// id と result (または error の code) が期待どおりの応答か
+static bool check_response(const JsonValue *msg, const char *name, const char *id, int error_code) {
+    JsonValue *v = json_get(msg, "id");
+    char got[32] = "";
+    if (v != NULL && v->type == JSON_NUMBER) snprintf(got, sizeof(got), "%.0f", v->number);
+    else if (v != NULL && v->type == JSON_STRING) snprintf(got, sizeof(got), "%s", v->str);
+    bool ok = strcmp(got, id) == 0;
+    if (ok && error_code != 0) ok = (int)json_get_number(json_get(msg, "error"), "code", 0) == error_code;
+    if (ok && error_code == 0) ok = json_get(msg, "result") != NULL && json_get(msg, "error") == NULL;
+    if (!ok) printf("NG: %s: id %s への応答がありません\n", name, id);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    const char *jpc = argc > 1 ? argv[1] : "./jpc";
+    char dir[] = "/tmp/jpc-server-test-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        fprintf(stderr, "Error: Cannot create temporary directory\n");
+        return 1;
+    }
+    char in[4096 + 16], out[4096 + 16], err[4096 + 16];
+    snprintf(in, sizeof(in), "%s/in", dir);
+    snprintf(out, sizeof(out), "%s/out", dir);
+    snprintf(err, sizeof(err), "%s/err", dir);
+    if (!write_requests(in)) {
+        fprintf(stderr, "Error: Cannot write %s\n", in);
+        return 1;
+    }
+
+    printf("=== Server Test: %s --server ===\n", jpc);
+    int status = spawn_server(jpc, in, out, err);
+    size_t out_len = 0, err_len = 0;
+    char *text = bench_read_file(out, &out_len);
+    char *log = bench_read_file(err, &err_len);
+    JsonValue *msgs[16];
+    int n = text != NULL ? read_responses(text, out_len, msgs, 16) : 0;
+
+    static const Range opened[] = { {1, 3, 6}, {3, 3, 4}, {5, 8, 9}, {8, 3, 4} };
+    static const Range renamed[] = { {1, 3, 6}, {3, 3, 4}, {8, 3, 4} };
+    static const Range inserted[] = { {1, 3, 6}, {3, 3, 4}, {9, 3, 4} };
+    static const Range declared[] = { {1, 3, 6}, {4, 3, 4} };
+    static const Step steps[] = {
+        { "didOpen", opened, 4, "全体解析" },
+        { "ループの中の編集", renamed, 3, "差分解析" },
+        { "ループの中の行の追加", inserted, 3, "差分解析" },
+        { "ループの外の編集", declared, 2, "全体解析" },
+    };
+    int nsteps = (int)(sizeof(steps) / sizeof(steps[0]));
+
+    // 応答は initialize、診断 4 つ、未知のメソッドのエラー、shutdown の順 (通知への応答はない)
+    bool ok = true;
+    if (status != 0) {
+        printf("NG: jpc --server の終了コードが %d です\n", status);
+        ok = false;
+    } else if (n != nsteps + 3) {
+        printf("NG: 応答が %d 個です (期待は %d 個)\n", n, nsteps + 3);
+        ok = false;
+    } else {
+        ok = check_response(msgs[0], "initialize", "1", 0) &&
+             json_get_number(json_get(json_get(json_get(msgs[0], "result"), "capabilities"), "textDocumentSync"), "change", 0) == 2;
+        if (!ok) printf("NG: initialize: 差分の同期 (change: 2) を返していません\n");
+        for (int i = 0; ok && i < nsteps; i++) ok = check_diagnostics(msgs[1 + i], &steps[i]);
+        ok = ok && check_response(msgs[nsteps + 1], "unknown/method", "x", -32601) &&
+             check_response(msgs[nsteps + 2], "shutdown", "2", 0);
+    }
+    // 解析の種類は標準エラー出力の記録で確かめる
+    const char *p = log != NULL ? log : "";
+    for (int i = 0; ok && i < nsteps; i++) {
+        p = strstr(p, "jpc-server: ");
+        const char *eol = p != NULL ? strchr(p, '\n') : NULL;
+        const char *kind = p != NULL ? strstr(p, steps[i].log) : NULL;
+        if (kind == NULL || (eol != NULL && kind > eol)) {
+            printf("NG: %s: %sしていません\n", steps[i].name, steps[i].log);
+            ok = false;
+        }
+        p = eol;
+    }
+
+    // 大きすぎるメッセージは確保せずに拒み、何も応答せずに終了コード 1 で終わる
+    if (ok) {
+        size_t big_len = 0;
+        char *big = NULL;
+        int big_status = write_oversized(in) ? spawn_server(jpc, in, out, err) : -1;
+        if (big_status == 1) big = bench_read_file(out, &big_len);
+        if (big_status != 1 || big == NULL || big_len != 0) {
+            printf("NG: 上限を超える Content-Length: 終了コードが %d です (期待は 1、応答なし)\n", big_status);
+            ok = false;
+        }
+        free(big);
+    }
+
+    for (int i = 0; i < n; i++) json_free(msgs[i]);
+    free(text);
+    free(log);
+    unlink(in);
+    unlink(out);
+    unlink(err);
+    rmdir(dir);
+    if (!ok) return 1;
+    printf("checked %d responses and %d diagnostics updates\n", n, nsteps);
+    printf("OK\n");
+    return 0;
+}
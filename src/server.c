@@ -0,0 +1,547 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <setjmp.h>
+#include "server.h"
+#include "lexer.h"
+#include "parser.h"
+#include "error.h"
+#include "json.h"
+#include "context.h"
+
+// --- 診断サーバ ---
+// LSP 形式 (Content-Length ヘッダ + JSON-RPC) で標準入出力からメッセージを受け取り、
+// 文書ごとにトークン列とトップレベルの文単位の AST を保持する。
+// 編集がトップレベルのループ／もし文の ｛…｝ 内に収まる場合は、その文だけを字句解析・構文解析し直す。
+// ループ／もし文の中の宣言は外に見えないので、後続の文の解析結果はそのまま使える。
+
+// トップレベルの文
+typedef struct {
+    int first, last;  // トークン列上の範囲 [first, last]
+    bool compound;    // ループ／もし文
+    LVar *scope;      // 文の直前の変数スコープ
+    Node *ast;        // 解析結果 (エラー時は NULL)
+    bool has_error;
+    JpcError diag;
+} Unit;
+
+// 文書ごとに文脈を持ち、トークン列・変数スコープ・インターン済み文字列はそこに置く
+typedef struct {
+    char *uri;
+    char *text;
+    size_t len;
+    JpcContext *ctx;
+    Unit *units;
+    int nunits;
+    bool has_error;   // 文単位に分けられないエラー (字句解析エラー、メイン｛…｝の不備)
+    JpcError diag;
+} Document;
+
+static Document *docs = NULL;
+static int ndocs = 0;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+// 文脈に記録された最後のエラーを取り出す
+static void take_error(JpcContext *ctx, JpcError *d) {
+    *d = ctx->errors[ctx->error_count - 1];
+    ctx->error_count = 0;
+}
+
+// トークン列を残したまま、文脈のソースを doc->text に切り替える
+static void set_source_keep_tokens(Document *doc) {
+    JpcContext *ctx = doc->ctx;
+    Token *tokens = ctx->token_list;
+    int ntok = ctx->token_count;
+    ctx->token_list = NULL;
+    setLexerSource(ctx, doc->text, doc->len);
+    ctx->token_list = tokens;
+    ctx->token_count = ntok;
+}
+
+// --- 文の切り分け ---
+
+// tokens[i] の （…）｛…｝ を読み飛ばし、最後のトークンの位置を返す
+static int skip_conditional_block(const Token *tokens, int ntok, int i) {
+    while (i < ntok && tokens[i].type != TK_LBRACE && tokens[i].type != TK_RBRACE &&
+           tokens[i].type != TK_PERIOD && tokens[i].type != TK_EOF) i++;
+    if (i >= ntok || tokens[i].type != TK_LBRACE) return i - 1;
+    int depth = 0;
+    for (; i < ntok && tokens[i].type != TK_EOF; i++) {
+        if (tokens[i].type == TK_LBRACE) depth++;
+        else if (tokens[i].type == TK_RBRACE && --depth == 0) return i;
+    }
+    return i - 1;
+}
+
+// tokens[i] から始まるトップレベルの文の最後のトークンの位置を返す
+static int find_unit_end(const Token *tokens, int ntok, int i, bool *compound) {
+    TokenType t = tokens[i].type;
+    if (t == TK_LOOP || t == TK_IF) {
+        *compound = true;
+        int end = skip_conditional_block(tokens, ntok, i + 1);
+        if (t == TK_IF) {
+            while (end + 1 < ntok && tokens[end + 1].type == TK_ELSEIF) {
+                end = skip_conditional_block(tokens, ntok, end + 2);
+            }
+            if (end + 1 < ntok && tokens[end + 1].type == TK_ELSE) {
+                end = skip_conditional_block(tokens, ntok, end + 2);
+            }
+        }
+        return end < i ? i : end;
+    }
+    // 単文は「。」まで。ブロックの区切りや次の制御文の手前で打ち切る
+    *compound = false;
+    int j = i;
+    while (j < ntok) {
+        t = tokens[j].type;
+        if (t == TK_PERIOD) return j;
+        if (t == TK_LBRACE || t == TK_RBRACE || t == TK_EOF || ((t == TK_LOOP || t == TK_IF) && j > i)) break;
+        j++;
+    }
+    return j > i ? j - 1 : i;
+}
+
+// --- 解析 ---
+
+static void parse_unit(Document *doc, Unit *u, LVar *scope) {
+    JpcContext *ctx = doc->ctx;
+    jmp_buf env;
+    u->scope = scope;
+    u->ast = NULL;
+    u->has_error = false;
+    restore_scope(ctx, scope);
+    ctx->error_jmp = &env;
+    if (setjmp(env) == 0) {
+        seekToken(ctx, u->first);
+        Node *node = parse_statement(ctx);
+        if (tellToken(ctx) != u->last + 1) {
+            error(ctx, ERR_SYNTAX, "文の区切りが正しくありません (Token: %.*s)", ctx->current_token.len, getTokenText(ctx, &ctx->current_token));
+        }
+        u->ast = node;
+    } else {
+        u->has_error = true;
+        take_error(ctx, &u->diag);
+    }
+    ctx->error_jmp = NULL;
+    // ループ／もし文の中の宣言は外に漏らさない
+    if (u->compound) restore_scope(ctx, scope);
+}
+
+static void free_analysis(Document *doc) {
+    closeLexer(doc->ctx);
+    // 差分解析で置き換えた文の AST もここでまとめて解放される
+    reset_scope(doc->ctx);
+    arena_release(&doc->ctx->arena);
+    free(doc->units);
+    doc->units = NULL;
+    doc->nunits = 0;
+    doc->has_error = false;
+}
+
+// 文書全体を字句解析・構文解析し直す
+static void analyze_full(Document *doc) {
+    JpcContext *ctx = doc->ctx;
+    free_analysis(doc);
+
+    ctx->current_line = 1;
+    if (!initLexerBuffer(ctx, doc->text, doc->len)) {
+        doc->has_error = true;
+        take_error(ctx, &doc->diag);
+        return;
+    }
+
+    Token *tokens = ctx->token_list;
+    int ntok = ctx->token_count;
+    if (ntok < 2 || tokens[0].type != TK_MAIN || tokens[1].type != TK_LBRACE) {
+        // 文に分けられないので、通常の構文解析でエラーを得る
+        restore_scope(ctx, NULL);
+        seekToken(ctx, 0);
+        if (parse_program(ctx) == NULL) {
+            doc->has_error = true;
+            take_error(ctx, &doc->diag);
+        }
+        return;
+    }
+
+    int cap = 16;
+    doc->units = malloc(sizeof(Unit) * cap);
+    LVar *scope = NULL;
+    int i = 2;
+    while (tokens[i].type != TK_RBRACE && tokens[i].type != TK_EOF) {
+        if (doc->nunits == cap) {
+            cap *= 2;
+            doc->units = realloc(doc->units, sizeof(Unit) * cap);
+        }
+        Unit *u = &doc->units[doc->nunits++];
+        u->first = i;
+        u->last = find_unit_end(tokens, ntok, i, &u->compound);
+        parse_unit(doc, u, scope);
+        scope = save_scope(ctx);
+        i = u->last + 1;
+    }
+    if (tokens[i].type != TK_RBRACE) {
+        doc->has_error = true;
+        doc->diag.type = ERR_SYNTAX;
+        doc->diag.line = tokens[i].line;
+        doc->diag.offset = tokens[i].offset;
+        doc->diag.len = tokens[i].len;
+        snprintf(doc->diag.message, sizeof(doc->diag.message),
+                 "「%s」が期待されていましたが、「%s」が代わりに発見されました",
+                 getTokenName(TK_RBRACE), getTokenName(tokens[i].type));
+    }
+}
+
+static int count_newlines(const char *s, size_t len) {
+    int n = 0;
+    for (size_t i = 0; i < len; i++) if (s[i] == '\n') n++;
+    return n;
+}
+
+// text[a, b) を repl で置き換える。可能ならその編集を含むループ／もし文だけを解析し直す
+// 差分解析できた場合は解析し直した文の番号、全体を解析し直した場合は -1 を返す
+static int apply_edit(Document *doc, size_t a, size_t b, const char *repl, size_t repl_len) {
+    JpcContext *ctx = doc->ctx;
+    // 編集を含むトップレベルのループ／もし文を探す
+    int k = -1;
+    if (!doc->has_error) {
+        for (int i = 0; i < doc->nunits; i++) {
+            Unit *u = &doc->units[i];
+            const Token *first = &ctx->token_list[u->first];
+            const Token *last = &ctx->token_list[u->last];
+            if (u->compound && (size_t)first->offset < a && b < (size_t)(last->offset + last->len)) {
+                k = i;
+                break;
+            }
+        }
+    }
+    int line_delta = count_newlines(repl, repl_len) - count_newlines(doc->text + a, b - a);
+    long delta = (long)repl_len - (long)(b - a);
+
+    // 文書の更新
+    size_t new_len = doc->len - (b - a) + repl_len;
+    char *text = malloc(new_len + 1);
+    memcpy(text, doc->text, a);
+    memcpy(text + a, repl, repl_len);
+    memcpy(text + a + repl_len, doc->text + b, doc->len - b);
+    text[new_len] = '\0';
+    free(doc->text);
+    doc->text = text;
+    doc->len = new_len;
+
+    if (k < 0) {
+        analyze_full(doc);
+        return -1;
+    }
+
+    // 編集された文の範囲だけを字句解析し直す
+    Unit *u = &doc->units[k];
+    Token first = ctx->token_list[u->first];
+    Token last = ctx->token_list[u->last];
+    int region_end = (int)(last.offset + last.len + delta);
+    int n = 0;
+    set_source_keep_tokens(doc);
+    Token *fresh = lexRegion(ctx, first.offset, region_end, first.line, &n);
+    ctx->error_count = 0;
+    if (fresh == NULL || n == 0 || fresh[0].type != first.type) {
+        free(fresh);
+        analyze_full(doc);
+        return -1;
+    }
+    // 先頭トークン直前の空白はこの範囲の外にある
+    fresh[0].flags = first.flags;
+
+    // トークン列をつなぎ替え、後続のトークンの位置と行番号をずらす
+    int old_n = u->last - u->first + 1;
+    int tail = ctx->token_count - (u->last + 1);
+    int ntok = ctx->token_count - old_n + n;
+    Token *tokens = malloc(sizeof(Token) * ntok);
+    memcpy(tokens, ctx->token_list, sizeof(Token) * u->first);
+    memcpy(tokens + u->first, fresh, sizeof(Token) * n);
+    memcpy(tokens + u->first + n, ctx->token_list + u->last + 1, sizeof(Token) * tail);
+    for (int i = u->first + n; i < ntok; i++) {
+        tokens[i].offset += delta;
+        tokens[i].line += line_delta;
+    }
+    free(fresh);
+
+    // 文の切れ目が変わっていないことを確認する
+    bool compound;
+    if (find_unit_end(tokens, ntok, u->first, &compound) != u->first + n - 1 || !compound) {
+        free(tokens);
+        analyze_full(doc);
+        return -1;
+    }
+    free(ctx->token_list);
+    ctx->token_list = tokens;
+    ctx->token_count = ntok;
+
+    int shift = n - old_n;
+    for (int i = k + 1; i < doc->nunits; i++) {
+        Unit *v = &doc->units[i];
+        v->first += shift;
+        v->last += shift;
+        if (v->has_error) {
+            v->diag.offset += delta;
+            v->diag.line += line_delta;
+        }
+    }
+    u->last += shift;
+
+    parse_unit(doc, u, u->scope);
+    return k;
+}
+
+// --- 位置の変換 ---
+
+// LSP の位置 (0始まりの行, UTF-16 単位の文字位置) をバイト位置に変換する
+static size_t position_to_offset(const Document *doc, int line, int character) {
+    size_t i = 0;
+    for (int l = 0; l < line && i < doc->len; i++) {
+        if (doc->text[i] == '\n') l++;
+    }
+    int units = 0;
+    while (i < doc->len && doc->text[i] != '\n' && units < character) {
+        unsigned char c = (unsigned char)doc->text[i];
+        int len = 1;
+        if ((c & 0xE0) == 0xC0) len = 2;
+        else if ((c & 0xF0) == 0xE0) len = 3;
+        else if ((c & 0xF8) == 0xF0) len = 4;
+        units += (len == 4) ? 2 : 1;
+        i += len;
+    }
+    return i > doc->len ? doc->len : i;
+}
+
+// バイト位置を、その行の先頭からの UTF-16 単位の文字位置に変換する
+static int offset_to_character(const Document *doc, size_t offset) {
+    if (offset > doc->len) offset = doc->len;
+    size_t start = offset;
+    while (start > 0 && doc->text[start - 1] != '\n') start--;
+    int units = 0;
+    for (size_t i = start; i < offset; i++) {
+        unsigned char c = (unsigned char)doc->text[i];
+        if ((c & 0xC0) != 0x80) units += ((c & 0xF8) == 0xF0) ? 2 : 1;
+    }
+    return units;
+}
+
+// --- メッセージ入出力 ---
+
+static void send_message(const char *body, size_t len) {
+    printf("Content-Length: %zu\r\n\r\n", len);
+    fwrite(body, 1, len, stdout);
+    fflush(stdout);
+}
+
+static void write_diagnostic(FILE *out, const Document *doc, const JpcError *d, bool *first) {
+    int line = d->line > 0 ? d->line - 1 : 0;
+    int start = offset_to_character(doc, (size_t)d->offset);
+    int end = offset_to_character(doc, (size_t)d->offset + d->len);
+    if (end < start) end = start;
+    char message[600];
+    snprintf(message, sizeof(message), "[%s] %s", get_error_label(d->type), d->message);
+    fprintf(out, "%s{\"range\":{\"start\":{\"line\":%d,\"character\":%d},\"end\":{\"line\":%d,\"character\":%d}},"
+                 "\"severity\":1,\"source\":\"jpc\",\"message\":",
+            *first ? "" : ",", line, start, line, end);
+    json_write_string(out, message, (int)strlen(message));
+    fputc('}', out);
+    *first = false;
+}
+
+static void publish_diagnostics(const Document *doc) {
+    char *body;
+    size_t len;
+    FILE *out = open_memstream(&body, &len);
+    fprintf(out, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":");
+    json_write_string(out, doc->uri, (int)strlen(doc->uri));
+    fprintf(out, ",\"diagnostics\":[");
+    bool first = true;
+    for (int i = 0; i < doc->nunits; i++) {
+        if (doc->units[i].has_error) write_diagnostic(out, doc, &doc->units[i].diag, &first);
+    }
+    if (doc->has_error) write_diagnostic(out, doc, &doc->diag, &first);
+    fprintf(out, "]}}");
+    fclose(out);
+    send_message(body, len);
+    free(body);
+}
+
+// id のない要求は通知なので、応答を返さない
+static void send_result(const JsonValue *id, const char *result) {
+    if (id == NULL) return;
+    char *body;
+    size_t len;
+    FILE *out = open_memstream(&body, &len);
+    fprintf(out, "{\"jsonrpc\":\"2.0\",\"id\":");
+    if (id->type == JSON_STRING) json_write_string(out, id->str, id->str_len);
+    else if (id->type == JSON_NUMBER) fprintf(out, "%.0f", id->number);
+    else fprintf(out, "null");
+    fprintf(out, ",%s}", result);
+    fclose(out);
+    send_message(body, len);
+    free(body);
+}
+
+// 1 つのメッセージの本文の上限。これより長い Content-Length は受け付けない
+#define MAX_MESSAGE_SIZE (64L << 20)
+
+// ヘッダを読み、本文を返す (入力終端なら NULL)。
+// Content-Length が上限を超える、または本文を置くメモリを確保できない場合は、
+// 標準エラー出力に書いて *failed を true にし、NULL を返す (続きのメッセージの区切りが分からないので読み進めない)
+static char *read_message(size_t *out_len, bool *failed) {
+    char line[256];
+    long length = -1;
+    *failed = false;
+    while (fgets(line, sizeof(line), stdin)) {
+        if (strcmp(line, "\r\n") == 0 || strcmp(line, "\n") == 0) {
+            if (length < 0) continue;
+            if (length > MAX_MESSAGE_SIZE) {
+                fprintf(stderr, "jpc-server: Content-Length %ld は上限 %ld を超えています\n", length, MAX_MESSAGE_SIZE);
+                *failed = true;
+                return NULL;
+            }
+            char *body = malloc((size_t)length + 1);
+            if (body == NULL) {
+                fprintf(stderr, "jpc-server: メモリを確保できません (%ld バイト)\n", length);
+                *failed = true;
+                return NULL;
+            }
+            if (fread(body, 1, (size_t)length, stdin) != (size_t)length) {
+                free(body);
+                return NULL;
+            }
+            body[length] = '\0';
+            *out_len = (size_t)length;
+            return body;
+        }
+        if (strncmp(line, "Content-Length:", 15) == 0) length = strtol(line + 15, NULL, 10);
+    }
+    return NULL;
+}
+
+static Document *find_document(const char *uri) {
+    for (int i = 0; i < ndocs; i++) {
+        if (strcmp(docs[i].uri, uri) == 0) return &docs[i];
+    }
+    return NULL;
+}
+
+static void handle_did_open(const JsonValue *params) {
+    JsonValue *td = json_get(params, "textDocument");
+    const char *uri = json_get_string(td, "uri");
+    JsonValue *text = json_get(td, "text");
+    if (uri == NULL || text == NULL || text->type != JSON_STRING) return;
+
+    Document *doc = find_document(uri);
+    if (doc == NULL) {
+        docs = realloc(docs, sizeof(Document) * (ndocs + 1));
+        doc = &docs[ndocs++];
+        memset(doc, 0, sizeof(Document));
+        doc->uri = strdup(uri);
+        doc->ctx = new_context();
+    }
+    free(doc->text);
+    doc->text = malloc((size_t)text->str_len + 1);
+    memcpy(doc->text, text->str, (size_t)text->str_len + 1);
+    doc->len = (size_t)text->str_len;
+
+    double start = now_ms();
+    analyze_full(doc);
+    fprintf(stderr, "jpc-server: %s 全体解析 %.3f ms\n", uri, now_ms() - start);
+    publish_diagnostics(doc);
+}
+
+static void handle_did_change(const JsonValue *params) {
+    const char *uri = json_get_string(json_get(params, "textDocument"), "uri");
+    JsonValue *changes = json_get(params, "contentChanges");
+    Document *doc = uri ? find_document(uri) : NULL;
+    if (doc == NULL || changes == NULL || changes->type != JSON_ARRAY) return;
+
+    double start = now_ms();
+    int reparsed = -1;
+    for (int i = 0; i < changes->count; i++) {
+        JsonValue *change = changes->items[i];
+        JsonValue *text = json_get(change, "text");
+        JsonValue *range = json_get(change, "range");
+        if (text == NULL || text->type != JSON_STRING) continue;
+        if (range == NULL) {
+            // 全文の置き換え
+            free(doc->text);
+            doc->text = malloc((size_t)text->str_len + 1);
+            memcpy(doc->text, text->str, (size_t)text->str_len + 1);
+            doc->len = (size_t)text->str_len;
+            analyze_full(doc);
+            reparsed = -1;
+            continue;
+        }
+        JsonValue *rs = json_get(range, "start");
+        JsonValue *re = json_get(range, "end");
+        size_t a = position_to_offset(doc, (int)json_get_number(rs, "line", 0), (int)json_get_number(rs, "character", 0));
+        size_t b = position_to_offset(doc, (int)json_get_number(re, "line", 0), (int)json_get_number(re, "character", 0));
+        if (b < a) b = a;
+        reparsed = apply_edit(doc, a, b, text->str, (size_t)text->str_len);
+    }
+    if (reparsed >= 0) {
+        fprintf(stderr, "jpc-server: %s 差分解析 (文 %d) %.3f ms\n", uri, reparsed + 1, now_ms() - start);
+    } else {
+        fprintf(stderr, "jpc-server: %s 全体解析 %.3f ms\n", uri, now_ms() - start);
+    }
+    publish_diagnostics(doc);
+}
+
+static void handle_did_close(const JsonValue *params) {
+    const char *uri = json_get_string(json_get(params, "textDocument"), "uri");
+    Document *doc = uri ? find_document(uri) : NULL;
+    if (doc == NULL) return;
+    free_analysis(doc);
+    free(doc->text);
+    doc->text = NULL;
+    doc->len = 0;
+    publish_diagnostics(doc);
+    free_context(doc->ctx);
+    free(doc->uri);
+    *doc = docs[--ndocs];
+}
+
+int run_server(void) {
+    size_t len;
+    char *body;
+    bool failed;
+    while ((body = read_message(&len, &failed)) != NULL) {
+        JsonValue *msg = json_parse(body, len);
+        free(body);
+        if (msg == NULL) continue;
+        const char *method = json_get_string(msg, "method");
+        JsonValue *id = json_get(msg, "id");
+        JsonValue *params = json_get(msg, "params");
+
+        if (method == NULL) {
+            // クライアントからの応答は無視する
+        } else if (strcmp(method, "initialize") == 0) {
+            send_result(id, "\"result\":{\"capabilities\":{\"textDocumentSync\":{\"openClose\":true,\"change\":2}},"
+                            "\"serverInfo\":{\"name\":\"jpc\"}}");
+        } else if (strcmp(method, "shutdown") == 0) {
+            send_result(id, "\"result\":null");
+        } else if (strcmp(method, "exit") == 0) {
+            json_free(msg);
+            return 0;
+        } else if (strcmp(method, "textDocument/didOpen") == 0) {
+            handle_did_open(params);
+        } else if (strcmp(method, "textDocument/didChange") == 0) {
+            handle_did_change(params);
+        } else if (strcmp(method, "textDocument/didClose") == 0) {
+            handle_did_close(params);
+        } else {
+            send_result(id, "\"error\":{\"code\":-32601,\"message\":\"Method not found\"}");
+        }
+        json_free(msg);
+    }
+    return failed ? 1 : 0;
+}
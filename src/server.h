@@ -0,0 +1,8 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+// 診断サーバ (jpc --server)
+// 標準入出力で LSP 形式のメッセージをやり取りし、編集のたびに診断結果を送る
+int run_server(void);
+
+#endif
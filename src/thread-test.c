@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "bench-util.h"
+#include "lexer.h"
+#include "parser.h"
+#include "codegen.h"
+#include "context.h"
+#include "optimize.h"
+
+// 複数スレッドで同時にコンパイルし、1スレッドで順にコンパイルした結果と一致することを確かめる
+
+#define THREADS 8
+#define ITERATIONS 200
+
+typedef struct {
+    const char *name;
+    char *src;
+    size_t len;
+    char *expected; // 1スレッドでの結果 (生成コード、またはエラー表示)
+} Source;
+
+typedef struct {
+    int id;
+    int mismatches;
+} Worker;
+
+static Source *sources;
+static int nsources;
+
+// ソースをコンパイルし、生成コードまたはエラー表示を文字列で返す
+static char *compile_source(const Source *s) {
+    char *out;
+    size_t out_len;
+    FILE *fp = open_memstream(&out, &out_len);
+    JpcContext *ctx = new_context();
+    const Ast *ast = NULL;
+    if (initLexerBuffer(ctx, s->src, s->len)) {
+        getNextToken(ctx);
+        Node *root = parse_program(ctx);
+        if (root != NULL) ast = build_ast(ctx, root);
+        if (ast != NULL && !optimize_ast(ctx, &ctx->ast, OPT_LEVEL_DEFAULT, true, NULL)) ast = NULL;
+    }
+    if (ast == NULL || !codegen(ctx, ast, NULL, fp)) print_errors(ctx, fp);
+    free_context(ctx);
+    fclose(fp);
+    return out;
+}
+
+static void *worker_main(void *arg) {
+    Worker *w = arg;
+    for (int i = 0; i < ITERATIONS; i++) {
+        const Source *s = &sources[(w->id + i) % nsources];
+        char *out = compile_source(s);
+        if (strcmp(out, s->expected) != 0) w->mismatches++;
+        free(out);
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: ./thread-test <filename.jpc>...\n");
+        return 1;
+    }
+
+    nsources = argc - 1;
+    sources = calloc(nsources, sizeof(Source));
+    for (int i = 0; i < nsources; i++) {
+        sources[i].name = argv[i + 1];
+        sources[i].src = bench_read_file(argv[i + 1], &sources[i].len);
+        if (sources[i].src == NULL) {
+            fprintf(stderr, "Error: Cannot open file %s\n", argv[i + 1]);
+            return 1;
+        }
+        sources[i].expected = compile_source(&sources[i]);
+    }
+
+    printf("=== Thread Test: %d threads x %d compilations, %d files ===\n", THREADS, ITERATIONS, nsources);
+
+    pthread_t threads[THREADS];
+    Worker workers[THREADS];
+    for (int i = 0; i < THREADS; i++) {
+        workers[i].id = i;
+        workers[i].mismatches = 0;
+        pthread_create(&threads[i], NULL, worker_main, &workers[i]);
+    }
+    int mismatches = 0;
+    for (int i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        mismatches += workers[i].mismatches;
+    }
+
+    if (mismatches > 0) {
+        printf("NG: %d compilations differed from the single-threaded result\n", mismatches);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "bench-util.h"
+#include "jit.h"
+#include "vm.h"
+#include "context.h"
+
+// ループの多いプログラムをバイトコードの解釈実行 (-i) と機械語 (-r) で実行し、
+// ループ 1 回あたりの時間 (ns) を比べる。どちらも gcc を使わずにプロセスの中で実行する
+
+// 比較・かつ・四則演算・条件分岐を含むループを生成する
+static void generate_input(FILE *fp, long iterations) {
+    fprintf(fp, "メイン｛\n");
+    fprintf(fp, "　　”合計”を「０」で宣言する。\n");
+    fprintf(fp, "　　”奇数”を「０」で宣言する。\n");
+    fprintf(fp, "　　”i”を「０」で宣言する。\n");
+    fprintf(fp, "　　ループ（”i”が「%ld」より小さいか　かつ　”合計”が「－１」以上か）｛\n", iterations);
+    fprintf(fp, "　　　　”x”を”i”で宣言する。\n");
+    fprintf(fp, "　　　　”x”に「３」をかける。\n");
+    fprintf(fp, "　　　　”x”を「２」でわる。\n");
+    fprintf(fp, "　　　　”合計”に”x”をたす。\n");
+    fprintf(fp, "　　　　もし（”奇数”が「０」と一緒か）｛\n");
+    fprintf(fp, "　　　　　　”奇数”に「１」を代入する。\n");
+    fprintf(fp, "　　　　｝\n");
+    fprintf(fp, "　　　　ではない｛\n");
+    fprintf(fp, "　　　　　　”奇数”に「０」を代入する。\n");
+    fprintf(fp, "　　　　　　”合計”から「１」をひく。\n");
+    fprintf(fp, "　　　　｝\n");
+    fprintf(fp, "　　　　”i”に「１」をたす。\n");
+    fprintf(fp, "　　｝\n");
+    fprintf(fp, "　　「合計は”合計”です」と出力する。\n");
+    fprintf(fp, "｝\n");
+}
+
+// 最適化なしで構文解析して、use_vm なら -i、そうでなければ -r と同じく実行する。
+// 標準出力は out_file に書く。かかった秒数を返し、失敗したら負の値
+static double run_program(const char *src, bool use_vm, const char *out_file) {
+    JpcContext *ctx = new_context();
+    DriverOptions opts = { 0, false, CODEGEN_DEFAULTS, BUILD_DEFAULTS, false };
+    double elapsed = -1;
+    const Ast *ast = driver_load(ctx, src, &opts, NULL);
+    if (ast == NULL) goto done;
+
+    fflush(stdout);
+    int saved = dup(1);
+    int fd = open(out_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (saved < 0 || fd < 0) goto done;
+    dup2(fd, 1);
+    close(fd);
+    double start = bench_now();
+    bool ok = use_vm ? vm_run(ctx, ast) : jit_run(ctx, ast);
+    double end = bench_now();
+    dup2(saved, 1);
+    close(saved);
+    if (ok) elapsed = end - start;
+done:
+    if (elapsed < 0) print_errors(ctx, stderr);
+    free_context(ctx);
+    return elapsed;
+}
+
+int main(int argc, char *argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 30000000;
+    int runs = 3;
+    const char *names[2] = { "-i (vm) ", "-r (jit)" };
+
+    char dir[] = "/tmp/jpc-vm-bench-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        fprintf(stderr, "Error: Cannot create temporary directory\n");
+        return 1;
+    }
+    char src[4096 + 16];
+    snprintf(src, sizeof(src), "%s/loop.jpc", dir);
+    if (!bench_write_source(src, generate_input, iterations)) {
+        fprintf(stderr, "Error: Cannot write %s\n", src);
+        return 1;
+    }
+
+    char out[2][4096 + 16];
+    double best[2] = {0, 0};
+    for (int i = 0; i < 2; i++) {
+        snprintf(out[i], sizeof(out[i]), "%s/%s.out", dir, i == 0 ? "vm" : "jit");
+        for (int r = 0; r < runs; r++) {
+            double elapsed = run_program(src, i == 0, out[i]);
+            if (elapsed < 0) {
+                fprintf(stderr, "Error: %s failed\n", names[i]);
+                return 1;
+            }
+            if (r == 0 || elapsed < best[i]) best[i] = elapsed;
+        }
+    }
+    bool same = bench_same_file(out[0], out[1]);
+
+    printf("=== VM Bench: %ld iterations (-O0) ===\n", iterations);
+    for (int i = 0; i < 2; i++) {
+        printf("%s: best of %d: %.3f ms (%.2f ns/iter)\n", names[i], runs, best[i] * 1e3, best[i] * 1e9 / iterations);
+    }
+    printf("output: %s\n", same ? "identical" : "DIFFERENT");
+
+    for (int i = 0; i < 2; i++) unlink(out[i]);
+    unlink(src);
+    rmdir(dir);
+    return same ? 0 : 1;
+}
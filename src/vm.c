@@ -0,0 +1,380 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "vm.h"
+#include "error.h"
+#include "context.h"
+
+// --- 命令 ---
+// r[a] などはレジスタ (変数または定数)。分岐先 c は命令の添字
+typedef enum {
+    OP_MOV,         // r[a] = r[b]
+    OP_ADD,         // r[a] += r[b]
+    OP_SUB,         // r[a] -= r[b]
+    OP_MUL,         // r[a] *= r[b]
+    OP_DIV,         // r[a] /= r[b]
+    OP_INPUT,       // scanf("%lf", &r[a])
+    OP_OUT_TEXT,    // 文字列 texts[a] を出力
+    OP_OUT_NUM,     // printf("%g\n", r[a])
+    OP_JMP,         // c へ
+    OP_JLT,         // r[a] < r[b] なら c へ
+    OP_JLE,         // r[a] <= r[b] なら c へ
+    OP_JNLT,        // !(r[a] < r[b]) なら c へ (NaN では飛ぶ)
+    OP_JNLE,        // !(r[a] <= r[b]) なら c へ
+    OP_JEQ,         // r[a] == r[b] なら c へ
+    OP_JNE,         // r[a] != r[b] なら c へ
+    OP_HALT
+} VmOp;
+
+typedef struct {
+    uint32_t op;
+    uint32_t a, b, c;
+} VmInsn;
+
+// 生成中の状態 (realloc で伸ばす配列は、エラーで抜けても vm_run が解放する)
+typedef struct {
+    JpcContext *ctx;
+    const Ast *ast;
+    VmInsn *code;
+    uint32_t len, cap;
+    uint32_t *labels;       // ラベル -> 命令の添字
+    uint32_t nlabels, labels_cap;
+    double *consts;         // 定数レジスタの初期値 (レジスタ nvars + i)
+    uint32_t nconsts, consts_cap;
+    uint32_t nvars;
+    uint32_t zero;          // 0.0 を置いた定数レジスタ (変数だけの条件に使う)
+    AstText *texts;
+    uint32_t ntexts, texts_cap;
+} VmCompiler;
+
+// --- プロトタイプ宣言 (内部関数) ---
+static void vm_stmt(VmCompiler *vc, uint32_t id);
+static void vm_block(VmCompiler *vc, uint32_t id);
+static void vm_branch(VmCompiler *vc, uint32_t id, bool jump_if, uint32_t label);
+
+// --- ヘルパー関数 ---
+
+static void *vm_grow(VmCompiler *vc, void *buf, uint32_t *cap, uint32_t need, size_t elem) {
+    if (need <= *cap) return buf;
+    uint32_t new_cap = *cap ? *cap : 64;
+    while (new_cap < need) new_cap *= 2;
+    void *grown = realloc(buf, elem * new_cap);
+    if (grown == NULL) error(vc->ctx, ERR_SYSTEM, "メモリを確保できません");
+    *cap = new_cap;
+    return grown;
+}
+
+static uint32_t emit(VmCompiler *vc, VmOp op, uint32_t a, uint32_t b, uint32_t c) {
+    vc->code = vm_grow(vc, vc->code, &vc->cap, vc->len + 1, sizeof(VmInsn));
+    vc->code[vc->len] = (VmInsn){ op, a, b, c };
+    return vc->len++;
+}
+
+static uint32_t new_label(VmCompiler *vc) {
+    vc->labels = vm_grow(vc, vc->labels, &vc->labels_cap, vc->nlabels + 1, sizeof(uint32_t));
+    vc->labels[vc->nlabels] = UINT32_MAX;
+    return vc->nlabels++;
+}
+
+static void place_label(VmCompiler *vc, uint32_t label) {
+    vc->labels[label] = vc->len;
+}
+
+static uint32_t add_const(VmCompiler *vc, double val) {
+    vc->consts = vm_grow(vc, vc->consts, &vc->consts_cap, vc->nconsts + 1, sizeof(double));
+    vc->consts[vc->nconsts] = val;
+    return vc->nvars + vc->nconsts++;
+}
+
+// 値 (変数か定数) のレジスタ
+static uint32_t vm_reg(VmCompiler *vc, uint32_t id) {
+    const ANode *node = &vc->ast->nodes[id];
+    switch (node->kind) {
+    case ND_VAR:
+        return node->a;
+    case ND_LITERAL:
+        return add_const(vc, ast_num(node));
+    default:
+        error(vc->ctx, ERR_CODEGEN, "Unknown Node Kind %d", node->kind);
+    }
+}
+
+// 出力する書式を、そのまま書く部分と変数に分けて texts に足す
+static uint32_t vm_text(VmCompiler *vc, uint32_t str_id) {
+    vc->texts = vm_grow(vc, vc->texts, &vc->texts_cap, vc->ntexts + 1, sizeof(AstText));
+    ast_split_text(vc->ctx, vc->ast, str_id, &vc->texts[vc->ntexts]);
+    return vc->ntexts++;
+}
+
+// --- 条件分岐 ---
+
+// 比較と分岐を 1 命令にする。> と >= は左右を入れ替えて < と <= にする
+static void vm_compare(VmCompiler *vc, const ANode *node, bool jump_if, uint32_t label) {
+    uint32_t lhs = vm_reg(vc, node->a), rhs = vm_reg(vc, node->b);
+    VmOp op;
+    switch (node->kind) {
+    case ND_EQ: op = jump_if ? OP_JEQ : OP_JNE; break;
+    case ND_NE: op = jump_if ? OP_JNE : OP_JEQ; break;
+    case ND_LT: op = jump_if ? OP_JLT : OP_JNLT; break;
+    case ND_LE: op = jump_if ? OP_JLE : OP_JNLE; break;
+    case ND_GT: op = jump_if ? OP_JLT : OP_JNLT; lhs = rhs; rhs = vm_reg(vc, node->a); break;
+    case ND_GE: op = jump_if ? OP_JLE : OP_JNLE; lhs = rhs; rhs = vm_reg(vc, node->a); break;
+    default:
+        error(vc->ctx, ERR_CODEGEN, "Unknown Node Kind %d", node->kind);
+    }
+    emit(vc, op, lhs, rhs, label);
+}
+
+// 条件 id が jump_if と等しければ label へ飛び、そうでなければ次の命令へ進む
+static void vm_branch(VmCompiler *vc, uint32_t id, bool jump_if, uint32_t label) {
+    const ANode *node = &vc->ast->nodes[id];
+    switch (node->kind) {
+    case ND_AND:
+    case ND_OR: {
+        // かつ で偽へ飛ぶとき・または で真へ飛ぶときは、どちらの項からも同じ先へ飛べばよい
+        bool short_circuit = node->kind == ND_AND ? !jump_if : jump_if;
+        if (short_circuit) {
+            vm_branch(vc, node->a, jump_if, label);
+            vm_branch(vc, node->b, jump_if, label);
+        } else {
+            uint32_t skip = new_label(vc);
+            vm_branch(vc, node->a, !jump_if, skip);
+            vm_branch(vc, node->b, jump_if, label);
+            place_label(vc, skip);
+        }
+        return;
+    }
+
+    case ND_EQ:
+    case ND_NE:
+    case ND_LT:
+    case ND_LE:
+    case ND_GT:
+    case ND_GE:
+        vm_compare(vc, node, jump_if, label);
+        return;
+
+    case ND_LITERAL:
+        // 最適化で畳み込まれた条件。C と同じく 0 以外 (NaN を含む) は真
+        if ((ast_num(node) != 0) == jump_if) emit(vc, OP_JMP, 0, 0, label);
+        return;
+
+    case ND_VAR:
+        emit(vc, jump_if ? OP_JNE : OP_JEQ, node->a, vc->zero, label);
+        return;
+
+    default:
+        error(vc->ctx, ERR_CODEGEN, "Unknown Node Kind %d", node->kind);
+    }
+}
+
+// --- 文 ---
+
+static void vm_if(VmCompiler *vc, uint32_t id, uint32_t end) {
+    const ANode *node = &vc->ast->nodes[id];
+    uint32_t next = new_label(vc);
+    vm_branch(vc, node->a, false, next);
+    vm_block(vc, node->b);
+    if (node->c) emit(vc, OP_JMP, 0, 0, end);
+    place_label(vc, next);
+    if (node->c) {
+        if (vc->ast->nodes[node->c].kind == ND_ELSEIF) {
+            vm_if(vc, node->c, end);
+        } else {
+            vm_block(vc, node->c);
+        }
+    }
+}
+
+static void vm_block(VmCompiler *vc, uint32_t id) {
+    for (; id; id = vc->ast->nodes[id].next) {
+        vm_stmt(vc, id);
+    }
+}
+
+static void vm_stmt(VmCompiler *vc, uint32_t id) {
+    const ANode *node = &vc->ast->nodes[id];
+
+    switch (node->kind) {
+    case ND_BLOCK:
+        vm_block(vc, node->a);
+        return;
+
+    case ND_IF: {
+        uint32_t end = new_label(vc);
+        vm_if(vc, id, end);
+        place_label(vc, end);
+        return;
+    }
+
+    case ND_LOOP: {
+        // 条件を末尾に置き、繰り返しごとの分岐を 1 回にする
+        uint32_t body = new_label(vc), cond = new_label(vc);
+        emit(vc, OP_JMP, 0, 0, cond);
+        place_label(vc, body);
+        vm_block(vc, node->b);
+        place_label(vc, cond);
+        vm_branch(vc, node->a, true, body);
+        return;
+    }
+
+    case ND_DECLARE:
+    case ND_ASSIGN:
+        emit(vc, OP_MOV, vc->ast->nodes[node->a].a, vm_reg(vc, node->b), 0);
+        return;
+
+    case ND_ADD:
+    case ND_SUB:
+    case ND_MUL:
+    case ND_DIV: {
+        VmOp op = node->kind == ND_ADD ? OP_ADD : node->kind == ND_SUB ? OP_SUB : node->kind == ND_MUL ? OP_MUL : OP_DIV;
+        emit(vc, op, vc->ast->nodes[node->a].a, vm_reg(vc, node->b), 0);
+        return;
+    }
+
+    case ND_INPUT:
+        emit(vc, OP_INPUT, vc->ast->nodes[node->a].a, 0, 0);
+        return;
+
+    case ND_OUTPUT:
+        if (vc->ast->nodes[node->a].kind == ND_STR_LIT) {
+            emit(vc, OP_OUT_TEXT, vm_text(vc, node->a), 0, 0);
+        } else {
+            emit(vc, OP_OUT_NUM, vm_reg(vc, node->a), 0, 0);
+        }
+        return;
+
+    default:
+        error(vc->ctx, ERR_CODEGEN, "Unknown Node Kind %d", node->kind);
+    }
+}
+
+static bool vm_compile(VmCompiler *vc) {
+    jmp_buf env;
+    jmp_buf *prev = vc->ctx->error_jmp;
+    vc->ctx->error_jmp = &env;
+    if (setjmp(env) != 0) {
+        vc->ctx->error_jmp = prev;
+        return false;
+    }
+    vc->nvars = ast_var_count(vc->ast);
+    vc->zero = add_const(vc, 0.0);
+    vm_block(vc, vc->ast->nodes[vc->ast->root].a);
+    emit(vc, OP_HALT, 0, 0, 0);
+
+    // 分岐先をラベルから命令の添字にする
+    for (uint32_t i = 0; i < vc->len; i++) {
+        if (vc->code[i].op >= OP_JMP && vc->code[i].op <= OP_JNE) vc->code[i].c = vc->labels[vc->code[i].c];
+    }
+    vc->ctx->error_jmp = prev;
+    return true;
+}
+
+// --- インタプリタ ---
+
+// 各命令の処理の最後で次の命令の処理へ直接飛ぶ (computed goto)
+static void vm_exec(const VmInsn *code, double *r, const AstText *texts) {
+    static const void *dispatch[] = {
+        [OP_MOV] = &&op_mov,
+        [OP_ADD] = &&op_add,
+        [OP_SUB] = &&op_sub,
+        [OP_MUL] = &&op_mul,
+        [OP_DIV] = &&op_div,
+        [OP_INPUT] = &&op_input,
+        [OP_OUT_TEXT] = &&op_out_text,
+        [OP_OUT_NUM] = &&op_out_num,
+        [OP_JMP] = &&op_jmp,
+        [OP_JLT] = &&op_jlt,
+        [OP_JLE] = &&op_jle,
+        [OP_JNLT] = &&op_jnlt,
+        [OP_JNLE] = &&op_jnle,
+        [OP_JEQ] = &&op_jeq,
+        [OP_JNE] = &&op_jne,
+        [OP_HALT] = &&op_halt,
+    };
+    const VmInsn *ip = code;
+
+#define DISPATCH() goto *dispatch[ip->op]
+#define NEXT() do { ip++; DISPATCH(); } while (0)
+#define BRANCH_IF(cond) do { ip = (cond) ? code + ip->c : ip + 1; DISPATCH(); } while (0)
+
+    DISPATCH();
+op_mov:
+    r[ip->a] = r[ip->b];
+    NEXT();
+op_add:
+    r[ip->a] += r[ip->b];
+    NEXT();
+op_sub:
+    r[ip->a] -= r[ip->b];
+    NEXT();
+op_mul:
+    r[ip->a] *= r[ip->b];
+    NEXT();
+op_div:
+    r[ip->a] /= r[ip->b];
+    NEXT();
+op_input:
+    // 読めなければ C の scanf と同じく変数はそのまま
+    if (scanf("%lf", &r[ip->a]) != 1) {}
+    NEXT();
+op_out_text: {
+    const AstText *t = &texts[ip->a];
+    for (uint32_t i = 0; i < t->count; i++) {
+        fwrite(t->pieces[i].text, 1, t->pieces[i].len, stdout);
+        if (t->pieces[i].var >= 0) printf("%f", r[t->pieces[i].var]);
+    }
+    NEXT();
+}
+op_out_num:
+    printf("%g\n", r[ip->a]);
+    NEXT();
+op_jmp:
+    ip = code + ip->c;
+    DISPATCH();
+op_jlt:
+    BRANCH_IF(r[ip->a] < r[ip->b]);
+op_jle:
+    BRANCH_IF(r[ip->a] <= r[ip->b]);
+op_jnlt:
+    BRANCH_IF(!(r[ip->a] < r[ip->b]));
+op_jnle:
+    BRANCH_IF(!(r[ip->a] <= r[ip->b]));
+op_jeq:
+    BRANCH_IF(r[ip->a] == r[ip->b]);
+op_jne:
+    BRANCH_IF(r[ip->a] != r[ip->b]);
+op_halt:
+    return;
+
+#undef DISPATCH
+#undef NEXT
+#undef BRANCH_IF
+}
+
+// --- エントリーポイント ---
+
+bool vm_run(JpcContext *ctx, const Ast *ast) {
+    VmCompiler vc = { .ctx = ctx, .ast = ast };
+    bool ok = vm_compile(&vc);
+    double *regs = NULL;
+    if (ok) {
+        regs = calloc(vc.nvars + vc.nconsts, sizeof(double));
+        if (regs == NULL) {
+            record_error(ctx, ERR_SYSTEM, "メモリを確保できません");
+            ok = false;
+        }
+    }
+    if (ok) {
+        memcpy(regs + vc.nvars, vc.consts, sizeof(double) * vc.nconsts);
+        vm_exec(vc.code, regs, vc.texts);
+        fflush(stdout);
+    }
+    free(regs);
+    free(vc.code);
+    free(vc.labels);
+    free(vc.consts);
+    free(vc.texts);
+    return ok;
+}
@@ -0,0 +1,17 @@
+// vm.h
+#ifndef VM_H
+#define VM_H
+
+#include <stdbool.h>
+#include "ast.h"
+
+// --- バイトコードのインタプリタ (jpc -i) ---
+// C のツールチェーンがなくても動くように、AST をレジスタ型のバイトコードにして解釈実行する。
+// 変数IDはそのままレジスタ番号になり、定数は変数の後ろのレジスタに置く。
+// 比較の条件は比較と分岐を 1 命令にし、かつ／または は短絡の分岐にする。
+// 表示は printf/scanf を直接呼ぶ C (--stdio) と同じになる
+
+// ast をバイトコードにして実行する。エラーの場合は ctx にエラーを記録して false を返す
+bool vm_run(JpcContext *ctx, const Ast *ast);
+
+#endif